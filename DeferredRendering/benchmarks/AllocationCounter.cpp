@@ -0,0 +1,74 @@
+#include "Utils/MicroBenchmark.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every form of the global operator new comes through here so MicroBenchmark sees each call. only the benchmark
+// executable links this file, the app keeps the default allocator (and the msvc debug heap)
+static std::atomic<uint64_t> s_allocationCount = 0;
+
+static void* Allocate(std::size_t size, std::size_t alignment) noexcept
+{
+	s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size = size ? size : 1;
+	if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		return std::malloc(size);
+
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif // _MSC_VER
+}
+
+static void Free(void* p, std::size_t alignment) noexcept
+{
+#ifdef _MSC_VER
+	if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+	{
+		_aligned_free(p);
+		return;
+	}
+#endif // _MSC_VER
+	(void)alignment;
+	std::free(p);
+}
+
+static void* AllocateOrThrow(std::size_t size, std::size_t alignment)
+{
+	if (void* p = Allocate(size, alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](std::size_t size) { return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, (std::size_t)alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, (std::size_t)alignment); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, (std::size_t)alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, (std::size_t)alignment); }
+
+void operator delete(void* p) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* p) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* p, std::size_t) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* p, std::size_t) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { Free(p, (std::size_t)alignment); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { Free(p, (std::size_t)alignment); }
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept { Free(p, (std::size_t)alignment); }
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept { Free(p, (std::size_t)alignment); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Free(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { Free(p, (std::size_t)alignment); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { Free(p, (std::size_t)alignment); }
+
+namespace DRUtils::MicroBenchmark
+{
+	uint64_t GetAllocationCount()
+	{
+		return s_allocationCount.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,18 @@
+#include "Utils/JobBenchmark.h"
+#include "Utils/MicroBenchmark.h"
+
+#include <GDX11/Core/Log.h>
+
+#include <cstring>
+
+// the app's cpu side benchmarks without a window or a device. [--micro] skips the job system's thread scaling
+int main(int argc, char** argv)
+{
+	GDX11::Log::Init();
+
+	DRUtils::MicroBenchmark::Log(DRUtils::MicroBenchmark::Run(nullptr, 5, DRUtils::MicroBenchmark::GetAllocationCount));
+	if (argc < 2 || std::strcmp(argv[1], "--micro") != 0)
+		DRUtils::JobBenchmark::Log(DRUtils::JobBenchmark::Run());
+
+	return 0;
+}
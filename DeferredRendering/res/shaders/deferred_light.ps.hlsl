@@ -1,3 +1,5 @@
+// keywords: DIRECTIONAL_LIGHTS POINT_LIGHTS SPOT_LIGHTS ATLAS_SHADOWS
+// a light type's loop is only compiled in when the frame has lights of it, ATLAS_SHADOWS when one of them has a shadowIndex
 
 struct DirectionalLight
 {
@@ -9,9 +11,6 @@ struct DirectionalLight
     float p2;
     float3 specular;
     float p3;
-    
-    // for shadow calculation
-    //float4x4 viewProjMatrix;
 };
 
 struct PointLight
@@ -23,14 +22,7 @@ struct PointLight
     float3 diffuse;
     float attQuadratic;
     float3 specular;
-    float p0;
-    
-    // for shadow calculation
-    //float farPlane;
-    //float nearPlane;
-    //float p1;
-    //float p2;
-    //float4x4 viewMatrix;
+    int shadowIndex; // first of its 6 atlas views, -1 without shadow
 };
 
 struct SpotLight
@@ -47,8 +39,33 @@ struct SpotLight
     float3 specular;
     float outerCutOffAngleCos;
     
-    // for shadow calculation
-    //float4x4 viewProjMatrix;
+    int shadowIndex; // atlas view, -1 without shadow
+    float3 p0;
+};
+
+struct AtlasView
+{
+    float4x4 viewProjection;
+    float4 atlasRect; // tile uv scale xy, offset zw
+};
+
+// same layout as g_buffer.ps, only shininess is read
+struct MaterialTexture
+{
+    float4 rect;
+    uint array;
+    uint slice;
+    float2 p0;
+};
+
+struct Material
+{
+    float4 diffuseCol;
+    float2 tiling;
+    float shininess;
+    float p0;
+    MaterialTexture diffuseMap;
+    MaterialTexture specularMap;
 };
 
 struct PhongInput
@@ -56,6 +73,7 @@ struct PhongInput
     float3 pixelToLight;
     float3 pixelToView;
     float3 normal;
+    float shadow; // ambient isn't shadowed
     
     struct
     {
@@ -81,33 +99,66 @@ cbuffer SystemCBuf : register(b0)
     SpotLight spotLights[s_lightMaxCount];
     
     float3 viewPosition;
-    float p0;
-    
     uint activeDirLights = 0;
     uint activePointLights = 0;
     uint activeSpotLights = 0;
-    float p1;
+}
+
+static const uint s_cascadeMaxCount = 4;
+
+// cascades of dirLights[0]
+cbuffer ShadowCBuf : register(b1)
+{
+    float4x4 cascadeViewProjections[s_cascadeMaxCount];
+    float4 cascadeSplits; // far view depth of each cascade, FLT_MAX past cascadeCount
+    float4 cascadeTexelSizes; // world units
+    float3 viewDirection;
+    uint cascadeCount;
+}
+
+static const uint s_atlasViewMaxCount = 64;
+
+// point and spot light shadows
+cbuffer AtlasShadowCBuf : register(b2)
+{
+    AtlasView atlasViews[s_atlasViewMaxCount];
+}
+
+static const uint s_materialMaxCount = 256;
+
+// the g-buffer's material table
+cbuffer MaterialCBuf : register(b3)
+{
+    Material materials[s_materialMaxCount];
 }
 
 Texture2D gPosition   : register(t0);
 Texture2D gNormal     : register(t1);
 Texture2D gDiffuse    : register(t2);
 Texture2D gSpecular   : register(t3);
-Texture2D gShininess  : register(t4);
-SamplerState gSampler : register(s0);
+Texture2D<uint> gMaterial : register(t4);
+Texture2DArray shadowMap : register(t5);
+Texture2D shadowAtlas    : register(t6);
+
+SamplerComparisonState shadowSampler : register(s0);
 
 float3 Phong(PhongInput input);
+float CalcCascadeShadow(float3 pixelPosition, float3 normal);
+float CalcPointShadow(uint firstView, float3 lightPosition, float3 pixelPosition, float3 normal);
+float CalcSpotShadow(uint view, float3 lightPosition, float3 pixelPosition, float3 normal);
 float CalcAttenuation(float distance, float attConstant, float attLinear, float attQuadratic);
 
 
 
-float4 main(float2 texCoord : TEXCOORD) : SV_Target
+// the g-buffer can be bigger than the viewport (pooled with headroom), load by pixel instead of sampling by uv
+float4 main(float2 texCoord : TEXCOORD, float4 position : SV_Position) : SV_Target
 {
-    float3 pixelPosition = gPosition.Sample(gSampler, texCoord).xyz;
-    float3 normal        = normalize(gNormal.Sample(gSampler, texCoord).xyz);
-    float3 diffuse      = gDiffuse.Sample(gSampler, texCoord).rgb; // deferred doesn't support alpha blending
-    float3 specular     = gSpecular.Sample(gSampler, texCoord).rgb; // deferred doesn't support alpha blending
-    float shininess      = gShininess.Sample(gSampler, texCoord).r;
+    int3 pixel = int3(position.xy, 0);
+    float3 pixelPosition = gPosition.Load(pixel).xyz;
+    float3 normal        = normalize(gNormal.Load(pixel).xyz);
+    float3 diffuse      = gDiffuse.Load(pixel).rgb; // deferred doesn't support alpha blending
+    float3 specular     = gSpecular.Load(pixel).rgb; // deferred doesn't support alpha blending
+    float shininess      = materials[gMaterial.Load(pixel)].shininess;
     
     
     
@@ -116,6 +167,7 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
     float3 spotLightPhong = float3(0.0f, 0.0f, 0.0f);
     
     float3 pixelToView = normalize(viewPosition - pixelPosition);
+#if DIRECTIONAL_LIGHTS
     for (int i = 0; i < activeDirLights; i++)
     {
         DirectionalLight light = dirLights[i];
@@ -124,6 +176,7 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         phongInput.pixelToLight = normalize(-light.direction);
         phongInput.pixelToView = pixelToView;
         phongInput.normal = normal;
+        phongInput.shadow = i == 0 ? CalcCascadeShadow(pixelPosition, normal) : 1.0f;
         phongInput.light.ambient = light.ambient;
         phongInput.light.diffuse = light.diffuse;
         phongInput.light.specular = light.specular;
@@ -133,7 +186,9 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         
         dirLightPhong += Phong(phongInput);
     }
+#endif
 
+#if POINT_LIGHTS
     for (int i = 0; i < activePointLights; i++)
     {
         PointLight light = pointLights[i];
@@ -142,6 +197,11 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         phongInput.pixelToLight = normalize(light.position - pixelPosition);
         phongInput.pixelToView = pixelToView;
         phongInput.normal = normal;
+#if ATLAS_SHADOWS
+        phongInput.shadow = light.shadowIndex >= 0 ? CalcPointShadow(light.shadowIndex, light.position, pixelPosition, normal) : 1.0f;
+#else
+        phongInput.shadow = 1.0f;
+#endif
         phongInput.light.ambient = light.ambient;
         phongInput.light.diffuse = light.diffuse;
         phongInput.light.specular = light.specular;
@@ -153,7 +213,9 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         
         pointLightPhong += Phong(phongInput) * attenuation;
     }
+#endif
     
+#if SPOT_LIGHTS
     for (int i = 0; i < activeSpotLights; i++)
     {
         SpotLight light = spotLights[i];
@@ -162,6 +224,11 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         phongInput.pixelToLight = normalize(light.position - pixelPosition);
         phongInput.pixelToView = pixelToView;
         phongInput.normal = normal;
+#if ATLAS_SHADOWS
+        phongInput.shadow = light.shadowIndex >= 0 ? CalcSpotShadow(light.shadowIndex, light.position, pixelPosition, normal) : 1.0f;
+#else
+        phongInput.shadow = 1.0f;
+#endif
         phongInput.light.ambient = light.ambient;
         phongInput.light.diffuse = light.diffuse;
         phongInput.light.specular = light.specular;
@@ -177,6 +244,7 @@ float4 main(float2 texCoord : TEXCOORD) : SV_Target
         
         spotLightPhong += Phong(phongInput) * attenuation * intensity;
     }
+#endif
     
     return float4(dirLightPhong + pointLightPhong + spotLightPhong, 1.0f);
 }
@@ -192,10 +260,83 @@ float3 Phong(PhongInput input)
     float specularFactor = pow(max(dot(input.normal, halfwayDir), 0.0f), input.mat.shininess);
     float3 specular = input.light.specular * input.mat.specular * specularFactor;
     
-    return ambient + diffuse + specular;
+    return ambient + (diffuse + specular) * input.shadow;
+}
+
+float CalcCascadeShadow(float3 pixelPosition, float3 normal)
+{
+    // splits are ascending, the cascade is the number of splits in front of the pixel
+    float depth = dot(pixelPosition - viewPosition, viewDirection);
+    uint cascade = (uint)dot(float4(depth >= cascadeSplits), 1.0f);
+    if (cascade >= cascadeCount)
+        return 1.0f;
+    
+    // normal offset by a texel and a half keeps the pcf kernel off the receiver's own surface
+    float texelSize = dot(cascadeTexelSizes, float4(cascade == uint4(0, 1, 2, 3)));
+    float3 offsetPosition = pixelPosition + normal * texelSize * 1.5f;
+    float4 shadowPosition = mul(float4(offsetPosition, 1.0f), cascadeViewProjections[cascade]);
+    float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+    // casters in front of the box are clamped onto its near plane, receivers can't be
+    float receiverDepth = saturate(shadowPosition.z);
+    
+    float width, height, elements;
+    shadowMap.GetDimensions(width, height, elements);
+    float2 texel = 1.0f / float2(width, height);
+    
+    // 3x3 pcf, each tap is a bilinear compare
+    float shadow = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; y++)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; x++)
+            shadow += shadowMap.SampleCmpLevelZero(shadowSampler, float3(uv + float2(x, y) * texel, cascade), receiverDepth);
+    }
+    
+    return shadow / 9.0f;
 }
 
 float CalcAttenuation(float distance, float attConstant, float attLinear, float attQuadratic)
 {
     return 1.0f / (attConstant + attLinear * distance + attQuadratic * (distance * distance));
-}
\ No newline at end of file
+}
+
+// one bilinear compare inside the view's tile
+float SampleAtlasShadow(uint view, float3 position)
+{
+    AtlasView atlasView = atlasViews[view];
+    float4 shadowPosition = mul(float4(position, 1.0f), atlasView.viewProjection);
+    shadowPosition.xyz /= shadowPosition.w;
+    
+    // half a texel in from the tile's edges so the filter doesn't read the neighbouring tiles
+    float width, height;
+    shadowAtlas.GetDimensions(width, height);
+    float halfTexel = 0.5f / (atlasView.atlasRect.x * width);
+    float2 uv = clamp(shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f, halfTexel, 1.0f - halfTexel);
+    return shadowAtlas.SampleCmpLevelZero(shadowSampler, uv * atlasView.atlasRect.xy + atlasView.atlasRect.zw, saturate(shadowPosition.z));
+}
+
+// a texel of a 90 degree view is 2 * distance / tile size wide, offset by a texel and a half
+float3 OffsetAtlasPosition(uint view, float3 lightPosition, float3 pixelPosition, float3 normal)
+{
+    float width, height;
+    shadowAtlas.GetDimensions(width, height);
+    float tileSize = atlasViews[view].atlasRect.x * width;
+    return pixelPosition + normal * (3.0f * length(pixelPosition - lightPosition) / tileSize);
+}
+
+float CalcPointShadow(uint firstView, float3 lightPosition, float3 pixelPosition, float3 normal)
+{
+    float3 position = OffsetAtlasPosition(firstView, lightPosition, pixelPosition, normal);
+    
+    // cube face of the major axis, +x, -x, +y, -y, +z, -z
+    float3 toPixel = position - lightPosition;
+    float3 a = abs(toPixel);
+    uint face = a.x >= a.y && a.x >= a.z ? (toPixel.x < 0.0f ? 1 : 0) : (a.y >= a.z ? (toPixel.y < 0.0f ? 3 : 2) : (toPixel.z < 0.0f ? 5 : 4));
+    return SampleAtlasShadow(firstView + face, position);
+}
+
+float CalcSpotShadow(uint view, float3 lightPosition, float3 pixelPosition, float3 normal)
+{
+    return SampleAtlasShadow(view, OffsetAtlasPosition(view, lightPosition, pixelPosition, normal));
+}
@@ -0,0 +1,24 @@
+
+struct VSInput
+{
+    float3 position : POSITION;
+};
+
+cbuffer SystemCBuf : register(b0)
+{
+    float4x4 viewProjection;
+};
+
+cbuffer UserCBuf : register(b1)
+{
+    float4x4 transform;
+    float4x4 normalMatrix;
+};
+
+
+float4 main(VSInput input) : SV_Position
+{
+    // same expression as g_buffer.vs, the g-buffer pass tests against this depth with EQUAL
+    precise float4 position = mul(float4(input.position, 1.0f), mul(transform, viewProjection));
+    return position;
+}
@@ -1,8 +1,8 @@
 
 Texture2D tex : register(t0);
-SamplerState samplerState : register(s0);
 
-float4 main(float2 texCoord : TEXCOORD) : SV_Target
+// 1:1 copy, tex can be bigger than the target so it's loaded by pixel
+float4 main(float2 texCoord : TEXCOORD, float4 position : SV_Position) : SV_Target
 {
-    return tex.Sample(samplerState, texCoord);
+    return tex.Load(int3(position.xy, 0));
 }
\ No newline at end of file
@@ -4,6 +4,7 @@ struct VSOutput
     float2 texCoord : TEXCOORD;
     float3 normal : NORMAL;
     float3 pixelPosition : PIXEL_POSITION;
+    nointerpolation uint materialIndex : MATERIAL_INDEX;
 };
 
 struct PSOutput
@@ -12,7 +13,16 @@ struct PSOutput
     float4 gNormal : SV_Target1;
     float4 gDiffuse : SV_Target2;
     float4 gSpecular : SV_Target3;
-    float gShininess : SV_Target4;
+    uint gMaterial : SV_Target4;
+};
+
+// slice of textureArrays[array], sampled inside rect
+struct MaterialTexture
+{
+    float4 rect; // uv scale xy, offset zw
+    uint array;
+    uint slice;
+    float2 p0;
 };
 
 struct Material
@@ -21,28 +31,53 @@ struct Material
     float2 tiling;
     float shininess;
     float p0;
+    MaterialTexture diffuseMap;
+    MaterialTexture specularMap;
 };
 
-cbuffer UserCBuf : register(b0)
+static const uint s_materialMaxCount = 256;
+
+// every material, indexed by the draw's material index
+cbuffer MaterialCBuf : register(b0)
 {
-    Material material;
+    Material materials[s_materialMaxCount];
 };
 
+static const uint s_textureArrayMaxCount = 4;
+
+// every material texture, bound once per pass
+Texture2DArray textureArrays[s_textureArrayMaxCount] : register(t0);
+SamplerState textureSampler : register(s0);
 
-Texture2D diffuseMap : register(t0);
-Texture2D specularMap : register(t1);
-SamplerState diffuseMapSampler : register(s0);
-SamplerState specularMapSampler : register(s1);
+float4 SampleMaterialTexture(MaterialTexture map, float2 uv);
 
 PSOutput main(VSOutput input)
 {
     PSOutput pso;
+    Material material = materials[input.materialIndex];
     pso.gPosition = float4(input.pixelPosition, 0.0f);
     pso.gNormal = float4(input.normal, 0.0f);
-    pso.gDiffuse = diffuseMap.Sample(diffuseMapSampler, input.texCoord * material.tiling) * material.diffuseCol;
-    pso.gSpecular = specularMap.Sample(specularMapSampler, input.texCoord * material.tiling);
-    pso.gShininess = material.shininess;
+    pso.gDiffuse = SampleMaterialTexture(material.diffuseMap, input.texCoord * material.tiling) * material.diffuseCol;
+    pso.gSpecular = SampleMaterialTexture(material.specularMap, input.texCoord * material.tiling);
+    pso.gMaterial = input.materialIndex;
     
     return pso;
 }
 
+// wraps inside the rect by hand, atlas rects can't use the sampler's wrap. the gradients come from the unwrapped uv
+// so the mip and anisotropy don't jump at the seam. array is the same for the whole draw, the branch is uniform
+float4 SampleMaterialTexture(MaterialTexture map, float2 uv)
+{
+    float2 ddxUV = ddx(uv) * map.rect.xy;
+    float2 ddyUV = ddy(uv) * map.rect.xy;
+    float3 location = float3(frac(uv) * map.rect.xy + map.rect.zw, map.slice);
+    
+    switch (map.array)
+    {
+        case 0: return textureArrays[0].SampleGrad(textureSampler, location, ddxUV, ddyUV);
+        case 1: return textureArrays[1].SampleGrad(textureSampler, location, ddxUV, ddyUV);
+        case 2: return textureArrays[2].SampleGrad(textureSampler, location, ddxUV, ddyUV);
+        default: return textureArrays[3].SampleGrad(textureSampler, location, ddxUV, ddyUV);
+    }
+}
+
@@ -12,6 +12,7 @@ struct VSOutput
     float2 texCoord : TEXCOORD;
     float3 normal : NORMAL;
     float3 pixelPosition : PIXEL_POSITION; 
+    nointerpolation uint materialIndex : MATERIAL_INDEX;
 };
 
 cbuffer SystemCBuf : register(b0)
@@ -23,16 +24,20 @@ cbuffer UserCBuf : register(b1)
 {
     float4x4 transform;
     float4x4 normalMatrix;
+    uint materialIndex;
 };
 
 
 VSOutput main(VSInput input)
 {
     VSOutput vso;
-    vso.position = mul(float4(input.position, 1.0f), mul(transform, viewProjection));
+    // precise, has to match depth_only.vs bit for bit for the pre-pass EQUAL test
+    precise float4 position = mul(float4(input.position, 1.0f), mul(transform, viewProjection));
+    vso.position = position;
     vso.texCoord = input.texCoord;
     vso.normal = mul(input.normal, (float3x3)normalMatrix);
     vso.pixelPosition = (float3)mul(float4(input.position, 1.0f), transform);
+    vso.materialIndex = materialIndex;
     return vso;
 }
 
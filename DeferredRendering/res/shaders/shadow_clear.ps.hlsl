@@ -0,0 +1,5 @@
+// clears the atlas tile under the viewport, depth views can only be cleared whole
+float main() : SV_Depth
+{
+    return 1.0f;
+}
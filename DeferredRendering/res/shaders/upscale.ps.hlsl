@@ -0,0 +1,26 @@
+cbuffer SystemCBuf : register(b0)
+{
+    float2 uvScale; // rendered size / allocated size, the pooled source can be bigger than what was rendered
+    float2 uvMax;   // center of the last rendered texel so bilinear doesn't pull in the unused part
+};
+
+Texture2D sceneColor : register(t0);
+Texture2D sceneDepth : register(t1);
+SamplerState linearSampler : register(s0);
+SamplerState pointSampler : register(s1);
+
+struct PSOutput
+{
+    float4 color : SV_Target;
+    float depth : SV_Depth; // the forward passes after this test against full resolution depth
+};
+
+PSOutput main(float2 texCoord : TEXCOORD)
+{
+    float2 uv = min(texCoord * uvScale, uvMax);
+
+    PSOutput pso;
+    pso.color = sceneColor.Sample(linearSampler, uv);
+    pso.depth = sceneDepth.Sample(pointSampler, uv).r; // never blend depth across edges
+    return pso;
+}
@@ -1,7 +1,11 @@
 #include "DeferredRendering.h"
 #include "Utils/BasicMesh.h"
-#include "Utils/CBufs.h"
+#include "Utils/ProfilerOverlay.h"
+#include "Utils/JobBenchmark.h"
+#include "Utils/MicroBenchmark.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <DirectXMath.h>
 #include <imgui.h>
 #include <backends/imgui_impl_dx11.h>
@@ -13,15 +17,42 @@ using namespace DRUtils;
 using namespace DirectX;
 using namespace Microsoft::WRL;
 
-DeferredRendering::DeferredRendering()
+// the adapter the device was created on, for the benchmark results
+static std::string GetAdapterName(ID3D11Device* device)
+{
+	ComPtr<IDXGIDevice> dxgiDevice;
+	ComPtr<IDXGIAdapter> adapter;
+	DXGI_ADAPTER_DESC desc = {};
+	if (FAILED(device->QueryInterface(IID_PPV_ARGS(&dxgiDevice))) || FAILED(dxgiDevice->GetAdapter(&adapter)) || FAILED(adapter->GetDesc(&desc)))
+		return "unknown";
+
+	std::string name;
+	for (const wchar_t* c = desc.Description; *c; c++)
+		name += *c < 128 ? (char)*c : '?';
+	return name;
+}
+
+DeferredRendering::DeferredRendering(const DeferredRenderingDesc& desc)
+	: m_desc(desc)
 {
 	WindowDesc winDesc = {};
 	winDesc.width = 1280;
 	winDesc.height = 720;
 	winDesc.name = "DeferredRendering";
 	winDesc.className = "DeferredRenderingClass";
-	m_window = std::make_unique<Window>(winDesc);
-	m_window->SetEventCallback(GDX11_BIND_EVENT_FN(DeferredRendering::OnEvent));
+	if (m_desc.headless)
+	{
+		std::vector<ScriptedInput> script;
+		if (!m_desc.inputScript.empty())
+			script = HeadlessWindow::ParseInputScript(GDX11::Utils::LoadText(m_desc.inputScript));
+		m_window = std::make_unique<HeadlessWindow>(winDesc, script);
+	}
+	else
+	{
+		m_window = std::make_unique<Win32Window>(winDesc);
+	}
+	// events wait in the queue until the frame dispatches them, see Run
+	m_window->SetEventQueue(&m_eventQueue);
 	
 	DXGI_SWAP_CHAIN_DESC scDesc = {};
 	scDesc.BufferDesc.Width = 0;
@@ -34,12 +65,44 @@ DeferredRendering::DeferredRendering()
 	scDesc.SampleDesc.Count = 1;
 	scDesc.SampleDesc.Quality = 0;
 	scDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	scDesc.BufferCount = 1;
-	scDesc.OutputWindow = m_window->GetNativeWindow();
+	scDesc.OutputWindow = (HWND)m_window->GetNativeHandle();
 	scDesc.Windowed = TRUE;
-	scDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
 	scDesc.Flags = 0;
-	m_context = std::make_unique<GDX11Context>(scDesc);
+
+	FramePacerDesc pacerDesc = {};
+	pacerDesc.bufferCount = 2;
+	pacerDesc.maxFrameLatency = 1;
+	pacerDesc.vsync = true;
+	pacerDesc.allowTearing = true;
+	FramePacer::ConfigureSwapChain(pacerDesc, scDesc);
+
+	if (m_desc.headless)
+	{
+		OffscreenSwapChainDesc offscreenDesc = {};
+		offscreenDesc.width = winDesc.width;
+		offscreenDesc.height = winDesc.height;
+		offscreenDesc.format = scDesc.BufferDesc.Format;
+		offscreenDesc.outputDirectory = m_desc.outputDirectory;
+		offscreenDesc.captureInterval = m_desc.outputDirectory.empty() ? 0 : 1;
+		m_context = std::make_unique<GDX11Context>(offscreenDesc, m_desc.warp ? D3D_DRIVER_TYPE_WARP : D3D_DRIVER_TYPE_HARDWARE);
+	}
+	else
+	{
+		m_context = std::make_unique<GDX11Context>(scDesc);
+	}
+	m_framePacer = FramePacer::Create(m_context.get(), pacerDesc);
+	m_gpuProfiler = GPUProfiler::Create(m_context.get());
+	m_renderTargetPool = RenderTargetPool::Create(m_context.get());
+	m_jobSystem = std::make_unique<JobSystem>();
+
+	// idle pooled targets are the memory that's free to give back, the pool drops them at the end of the frame
+	m_memoryBudgetCallback = MemoryTracker::AddBudgetCallback([this](MemoryCategory category, uint64_t bytes, uint64_t budget)
+	{
+		GDX11_LOG_WARN("{0} memory over budget: {1:.1f} / {2:.1f} MB", MemoryTracker::GetCategoryName(category),
+			bytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+		m_renderTargetPool->Trim();
+	});
+	MemoryTracker::SetBudget(MemoryCategory::Count, m_desc.memoryBudget * 1024 * 1024);
 
 	CameraDesc camDesc = {};
 	camDesc.position = { 0.0f, 12.0f, -7.0f };
@@ -55,6 +118,7 @@ DeferredRendering::DeferredRendering()
 	m_cameraController.SetDistance(10.0f);
 	m_cameraController.SetFocalPoint({ 0.0f, 0.0f, 0.0f });
 	m_cameraController.SetViewportSize((float)m_window->GetDesc().width, (float)m_window->GetDesc().height);
+	m_lodSelector.SetViewportSize((float)m_window->GetDesc().width, (float)m_window->GetDesc().height);
 
 	D3D11_VIEWPORT vp = {};
 	vp.TopLeftX = 0.0f;
@@ -65,36 +129,103 @@ DeferredRendering::DeferredRendering()
 	vp.MaxDepth = 1.0f;
 	m_context->GetDeviceContext()->RSSetViewports(1, &vp);
 
-	SetImGui();
+	if (!m_desc.headless)
+		SetImGui();
 	SetResources();
+	SetScene();
+	SetRenderGraph();
+}
+
+DeferredRendering::~DeferredRendering()
+{
+	MemoryTracker::RemoveBudgetCallback(m_memoryBudgetCallback);
 }
 
 void DeferredRendering::Run()
 {
+	if (m_desc.microBenchmark)
+	{
+		MicroBenchmark::Log(MicroBenchmark::Run(m_context.get()));
+		return;
+	}
+
+	if (m_desc.benchmark)
+	{
+		// as fast as it goes, waiting on vsync or the limiter would hide what the frame costs
+		m_framePacer->SetVSync(false);
+		m_framePacer->SetMaxFrameRate(0.0f);
+		RenderCounters::Sample();
+	}
+
+	const uint64_t runBegin = Profiler::Now();
+	uint64_t frameCount = 0;
 	while (!m_window->GetState().shouldClose)
 	{
+		if (m_desc.headless && m_desc.frameCount && frameCount == m_desc.frameCount)
+			break;
+		if (m_desc.benchmark && m_benchmarkFrame == m_desc.benchmarkDesc.warmupFrames + m_desc.benchmarkDesc.frameCount)
+			break;
+
+		// wait for the swap chain first so input is sampled as late as possible
+		m_framePacer->BeginFrame();
+		const uint64_t frameBegin = Profiler::Now();
+		m_window->ProcessEvents();
+		m_eventQueue.DispatchEvents(GDX11_BIND_EVENT_FN(DeferredRendering::OnEvent));
+
 		if (GDX11::Input::GetKey(m_window.get(), GDX11::Key::Escape))
 		{
 			m_window->Close();
 			continue;
 		}
 
-		OnUpdate();
+		Profiler::BeginFrame();
+		m_gpuProfiler->BeginFrame();
+
+		{
+			GDX11_PROFILE_SCOPE("Update");
+			OnUpdate();
+		}
+
 		OnRender();
 
-		ImGuiBegin();
-		OnImGuiRender();
-		ImGuiEnd();
+		if (!m_desc.headless)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "ImGui");
+			ImGuiBegin();
+			OnImGuiRender();
+			ImGuiEnd();
+		}
+
+		m_gpuProfiler->EndFrame();
+		m_renderTargetPool->EndFrame();
 
-		GDX11::Window::PollEvents();
-		HRESULT hr;
-		if (FAILED(hr = m_context->GetSwapChain()->Present(1, 0)))
 		{
-			if (hr == DXGI_ERROR_DEVICE_REMOVED)
-				throw GDX11_CONTEXT_DEVICE_REMOVED_EXCEPT(hr);
-			else
-				throw GDX11_CONTEXT_EXCEPT(hr);
+			GDX11_PROFILE_SCOPE("Present");
+			m_framePacer->Present();
 		}
+		GDX11_CONTEXT_VALIDATE(ValidationLevel::PerFrame, "Frame");
+
+		Profiler::EndFrame();
+		if (m_desc.benchmark)
+			RecordBenchmarkFrame(frameBegin);
+		frameCount++;
+	}
+
+	if (m_desc.benchmark)
+	{
+		SceneBenchmark::Log(m_benchmarkSamples);
+		SceneBenchmark::WriteJSON(m_desc.benchmarkOutput, m_desc.benchmarkDesc, GetAdapterName(m_context->GetDevice()), m_benchmarkSamples);
+	}
+
+	if (!m_desc.memoryReport.empty())
+		MemoryTracker::WriteJSON(m_desc.memoryReport);
+
+	if (m_desc.headless)
+	{
+		m_context->GetOffscreenSwapChain()->Flush();
+		const double seconds = (Profiler::Now() - runBegin) * 1e-9;
+		GDX11_LOG_INFO("Headless: {0} frames in {1:.2f} s, {2:.1f} fps, {3:.3f} ms per frame",
+			frameCount, seconds, frameCount / seconds, seconds * 1e3 / std::max<uint64_t>(frameCount, 1));
 	}
 }
 
@@ -103,8 +234,7 @@ void DeferredRendering::SetResources()
 	HRESULT hr;
 
 	{
-		ComPtr<ID3D11Texture2D> backBuffer;
-		GDX11_CONTEXT_THROW_INFO(m_context->GetSwapChain()->GetBuffer(0, __uuidof(ID3D11Texture2D), &backBuffer));
+		ComPtr<ID3D11Texture2D> backBuffer = m_context->GetBackBuffer();
 		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
 		rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
@@ -112,85 +242,43 @@ void DeferredRendering::SetResources()
 		m_resourceLib.Add("main", RenderTargetView::Create(m_context.get(), rtvDesc, Texture2D::Create(m_context.get(), backBuffer.Get())));
 	}
 
-	{
-		D3D11_TEXTURE2D_DESC texDesc = {};
-		texDesc.Width = m_window->GetDesc().width;
-		texDesc.Height = m_window->GetDesc().height;
-		texDesc.MipLevels = 1;
-		texDesc.ArraySize = 1;
-		texDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		texDesc.SampleDesc.Count = 1;
-		texDesc.SampleDesc.Quality = 0;
-		texDesc.Usage = D3D11_USAGE_DEFAULT;
-		texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-		texDesc.CPUAccessFlags = 0;
-		texDesc.MiscFlags = 0;
-
-		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-		dsvDesc.Format = texDesc.Format;
-		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-		dsvDesc.Texture2D.MipSlice = 0;
-		m_resourceLib.Add("main", DepthStencilView::Create(m_context.get(), dsvDesc, Texture2D::Create(m_context.get(), texDesc, (void*)nullptr)));
-	}
-
 	m_resourceLib.Add("default", RasterizerState::Create(m_context.get(), CD3D11_RASTERIZER_DESC(CD3D11_DEFAULT())));
 	m_resourceLib.Add("default", DepthStencilState::Create(m_context.get(), CD3D11_DEPTH_STENCIL_DESC(CD3D11_DEFAULT())));
 	m_resourceLib.Add("default", BlendState::Create(m_context.get(), CD3D11_BLEND_DESC(CD3D11_DEFAULT())));
 
-	
-	// G-Buffer
-	{
-		std::shared_ptr<RenderTargetViewArray> rtva = std::make_shared<RenderTargetViewArray>();
-		// 0 = pos
-		// 1 = normal 
-		// 2 = diffuse
-		// 3 = specular
-		// 4 = shininess
-		for (int i = 0; i < 5; i++)
-		{
-			D3D11_TEXTURE2D_DESC texDesc = {};
-			texDesc.Width = m_window->GetDesc().width;
-			texDesc.Height = m_window->GetDesc().height;
-			texDesc.MipLevels = 1;
-			texDesc.ArraySize = 1;
-
-			if (i < 2)
-				texDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-			else if (i < 4)
-				texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			else
-				texDesc.Format = DXGI_FORMAT_R32_FLOAT;
-
-			texDesc.SampleDesc.Count = 1;
-			texDesc.SampleDesc.Quality = 0;
-			texDesc.Usage = D3D11_USAGE_DEFAULT;
-			texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-			texDesc.CPUAccessFlags = 0;
-			texDesc.MiscFlags = 0;
-
-			D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-			rtvDesc.Format = texDesc.Format;
-			rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-			rtvDesc.Texture2D.MipSlice = 0;
-
-			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-			srvDesc.Format = texDesc.Format;
-			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			srvDesc.Texture2D.MostDetailedMip = 0;
-			srvDesc.Texture2D.MipLevels = 1;
-
-			auto texture = Texture2D::Create(m_context.get(), texDesc, (void*)nullptr);
-			rtva->push_back(RenderTargetView::Create(m_context.get(), rtvDesc, texture));
-			m_resourceLib.Add("g_bufferTextureView" + std::to_string(i), ShaderResourceView::Create(m_context.get(), srvDesc, texture));
-		}
+	{
+		D3D11_DEPTH_STENCIL_DESC dsDesc = CD3D11_DEPTH_STENCIL_DESC(CD3D11_DEFAULT());
+		dsDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		m_resourceLib.Add("depth_always", DepthStencilState::Create(m_context.get(), dsDesc));
+	}
+
+	// g-buffer after the depth pre-pass, only the nearest fragment passes
+	{
+		D3D11_DEPTH_STENCIL_DESC dsDesc = CD3D11_DEPTH_STENCIL_DESC(CD3D11_DEFAULT());
+		dsDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+		dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		m_resourceLib.Add("depth_equal", DepthStencilState::Create(m_context.get(), dsDesc));
+	}
 
-		m_resourceLib.Add("g_buffer", rtva);
+	// casters in front of a cascade are clamped onto its near plane instead of clipped, so the boxes only have to cover the receivers
+	{
+		D3D11_RASTERIZER_DESC rsDesc = CD3D11_RASTERIZER_DESC(CD3D11_DEFAULT());
+		rsDesc.DepthBias = 100;
+		rsDesc.SlopeScaledDepthBias = 1.5f;
+		rsDesc.DepthBiasClamp = 0.0f;
+		rsDesc.DepthClipEnable = FALSE;
+		m_resourceLib.Add("shadow", RasterizerState::Create(m_context.get(), rsDesc));
+
+		// perspective views need the near plane, casters behind the light would land in front of it
+		rsDesc.DepthClipEnable = TRUE;
+		m_resourceLib.Add("shadow_atlas", RasterizerState::Create(m_context.get(), rsDesc));
 	}
 
 	SetShaders();
 	SetBuffers();
 	SetLoadedTexture();
 	SetSamplers();
+	SetShadowMaps();
 }
 
 void DeferredRendering::SetShaders()
@@ -207,6 +295,11 @@ void DeferredRendering::SetShaders()
 		m_resourceLib.Add("g_buffer", InputLayout::Create(m_context.get(), m_resourceLib.Get<VertexShader>("g_buffer")));
 	}
 
+	{
+		m_resourceLib.Add("depth_only", VertexShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/depth_only.vs.hlsl")));
+		m_resourceLib.Add("depth_only", InputLayout::Create(m_context.get(), m_resourceLib.Get<VertexShader>("depth_only")));
+	}
+
 	{
 		m_resourceLib.Add("fullscreen", VertexShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/fullscreen.vs.hlsl")));
 		m_resourceLib.Add("fullscreen", PixelShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/fullscreen.ps.hlsl")));
@@ -214,15 +307,89 @@ void DeferredRendering::SetShaders()
 	}
 
 	{
-		m_resourceLib.Add("deferred_light", PixelShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/deferred_light.ps.hlsl")));
+		// one variant per light mix, the one with everything is compiled up front and the rest on first use
+		auto permutations = PixelShaderPermutations::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/deferred_light.ps.hlsl"));
+		permutations->Compile(permutations->GetAllMask());
+		m_resourceLib.Add("deferred_light", permutations);
+	}
+
+	{
+		m_resourceLib.Add("upscale", PixelShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/upscale.ps.hlsl")));
+	}
+
+	{
+		m_resourceLib.Add("shadow_clear", PixelShader::Create(m_context.get(), GDX11::Utils::LoadText("res/shaders/shadow_clear.ps.hlsl")));
 	}
 }
 
 void DeferredRendering::SetBuffers()
 {
+	auto cubeVert = DRUtils::BasicMesh::CreateCubeVertices(true, true);
+	auto cubeInd = DRUtils::BasicMesh::CreateCubeIndices();
+	auto planeVert = DRUtils::BasicMesh::CreatePlaneVertices(true, true);
+	auto planeInd = DRUtils::BasicMesh::CreatePlaneIndices();
+
+	// lod chains, all levels of a mesh live in its index buffer
 	{
-		auto cubeVert = DRUtils::BasicMesh::CreateCubeVertices(true, true);
-		auto cubeInd = DRUtils::BasicMesh::CreateCubeIndices();
+		MeshSimplifier::MeshDesc cubeMesh = {};
+		cubeMesh.vertices = cubeVert.data();
+		cubeMesh.vertexCount = (uint32_t)cubeVert.size() / 8;
+		cubeMesh.vertexStride = 8;
+		cubeMesh.attributeOffset = 3; // uv + normal
+		cubeMesh.attributeCount = 5;
+		cubeMesh.indices = cubeInd.data();
+		cubeMesh.indexCount = (uint32_t)cubeInd.size();
+
+		MeshSimplifier::MeshDesc planeMesh = cubeMesh;
+		planeMesh.vertices = planeVert.data();
+		planeMesh.vertexCount = (uint32_t)planeVert.size() / 8;
+		planeMesh.indices = planeInd.data();
+		planeMesh.indexCount = (uint32_t)planeInd.size();
+
+		auto chains = MeshSimplifier::GenerateLODChains({ cubeMesh, planeMesh }, MeshSimplifier::LODChainDesc(), m_jobSystem.get());
+		m_meshLODs["cube"] = std::move(chains[0]);
+		m_meshLODs["plane"] = std::move(chains[1]);
+
+		// meshlets per lod level, the level's indices are rewritten in meshlet order.
+		// levels own disjoint index ranges so they build in parallel
+		for (auto& [name, mesh] : { std::make_pair("cube", cubeMesh), std::make_pair("plane", planeMesh) })
+		{
+			auto& chain = m_meshLODs.at(name);
+			auto& meshlets = m_meshlets[name];
+			meshlets.resize(chain.levels.size());
+			m_jobSystem->ParallelFor((uint32_t)chain.levels.size(), [&, mesh = mesh](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					const auto& level = chain.levels[i];
+					MeshSimplifier::MeshDesc levelMesh = mesh;
+					levelMesh.indices = &chain.indices[level.indexOffset];
+					levelMesh.indexCount = level.indexCount;
+
+					meshlets[i] = Meshlets::Build(levelMesh);
+					std::copy(meshlets[i].indices.begin(), meshlets[i].indices.end(), chain.indices.begin() + level.indexOffset);
+				}
+			}, 1);
+
+			// lod 0, a simplified occluder could bulge out of the real surface and hide what's visible
+			OcclusionMesh& occlusionMesh = m_occlusionMeshes[name];
+			occlusionMesh.vertices.assign(mesh.vertices, mesh.vertices + (size_t)mesh.vertexCount * mesh.vertexStride);
+			occlusionMesh.indices.assign(chain.indices.begin() + chain.levels[0].indexOffset, chain.indices.begin() + chain.levels[0].indexOffset + chain.levels[0].indexCount);
+			XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+			XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+			for (uint32_t i = 0; i < mesh.vertexCount; i++)
+			{
+				XMVECTOR position = XMLoadFloat3((const XMFLOAT3*)&mesh.vertices[(size_t)i * mesh.vertexStride]);
+				boundsMin = XMVectorMin(boundsMin, position);
+				boundsMax = XMVectorMax(boundsMax, position);
+			}
+			XMStoreFloat3(&occlusionMesh.boundsMin, boundsMin);
+			XMStoreFloat3(&occlusionMesh.boundsMax, boundsMax);
+		}
+	}
+
+	{
+		const auto& cubeLODInd = m_meshLODs.at("cube").indices;
 
 		D3D11_BUFFER_DESC buffDesc = {};
 		buffDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
@@ -234,18 +401,17 @@ void DeferredRendering::SetBuffers()
 		m_resourceLib.Add("vb.cube", Buffer::Create(m_context.get(), buffDesc, cubeVert.data()));
 
 		buffDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		buffDesc.ByteWidth = (uint32_t)cubeInd.size() * sizeof(uint32_t);
+		buffDesc.ByteWidth = (uint32_t)cubeLODInd.size() * sizeof(uint32_t);
 		buffDesc.CPUAccessFlags = 0;
 		buffDesc.MiscFlags = 0;
 		buffDesc.StructureByteStride = sizeof(uint32_t);
 		buffDesc.Usage = D3D11_USAGE_DEFAULT;
-		m_resourceLib.Add("ib.cube", Buffer::Create(m_context.get(), buffDesc, cubeInd.data()));
+		m_resourceLib.Add("ib.cube", Buffer::Create(m_context.get(), buffDesc, cubeLODInd.data()));
 	}
 
 
 	{
-		auto planeVert = DRUtils::BasicMesh::CreatePlaneVertices(true, true);
-		auto planeInd = DRUtils::BasicMesh::CreatePlaneIndices();
+		const auto& planeLODInd = m_meshLODs.at("plane").indices;
 
 		D3D11_BUFFER_DESC buffDesc = {};
 		buffDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
@@ -257,14 +423,17 @@ void DeferredRendering::SetBuffers()
 		m_resourceLib.Add("vb.plane", Buffer::Create(m_context.get(), buffDesc, planeVert.data()));
 
 		buffDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		buffDesc.ByteWidth = (uint32_t)planeInd.size() * sizeof(uint32_t);
+		buffDesc.ByteWidth = (uint32_t)planeLODInd.size() * sizeof(uint32_t);
 		buffDesc.CPUAccessFlags = 0;
 		buffDesc.MiscFlags = 0;
 		buffDesc.StructureByteStride = sizeof(uint32_t);
 		buffDesc.Usage = D3D11_USAGE_DEFAULT;
-		m_resourceLib.Add("ib.plane", Buffer::Create(m_context.get(), buffDesc, planeInd.data()));
+		m_resourceLib.Add("ib.plane", Buffer::Create(m_context.get(), buffDesc, planeLODInd.data()));
 	}
 
+	for (const char* mesh : { "cube", "plane" })
+		m_meshBuffers[mesh] = { m_resourceLib.Get<Buffer>(std::string("vb.") + mesh), m_resourceLib.Get<Buffer>(std::string("ib.") + mesh) };
+
 
 	{
 		std::array<float, 8> screenVert = {
@@ -345,7 +514,7 @@ void DeferredRendering::SetBuffers()
 	{
 		D3D11_BUFFER_DESC buffDesc = {};
 		buffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		buffDesc.ByteWidth = 2 * sizeof(XMFLOAT4X4);
+		buffDesc.ByteWidth = sizeof(CBuf::VS::g_buffer::UserCBuf);
 		buffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		buffDesc.MiscFlags = 0;
 		buffDesc.StructureByteStride = 0;
@@ -356,36 +525,125 @@ void DeferredRendering::SetBuffers()
 	{
 		D3D11_BUFFER_DESC buffDesc = {};
 		buffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		buffDesc.ByteWidth = 2 * sizeof(XMFLOAT4);
+		buffDesc.ByteWidth = sizeof(CBuf::PS::g_buffer::MaterialCBuf);
 		buffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		buffDesc.MiscFlags = 0;
 		buffDesc.StructureByteStride = 0;
 		buffDesc.Usage = D3D11_USAGE_DYNAMIC;
-		m_resourceLib.Add("cbuf.g_buffer.ps.UserCBuf", Buffer::Create(m_context.get(), buffDesc, nullptr));
+		m_resourceLib.Add("cbuf.g_buffer.ps.MaterialCBuf", Buffer::Create(m_context.get(), buffDesc, nullptr));
 	}
 
+	// laid out from the variant with every keyword, the others declare the same cbuffers
+	{
+		using namespace CBuf::PS::deferred_lighting;
+		auto reflection = m_resourceLib.Get<PixelShaderPermutations>("deferred_light")->Get(UINT32_MAX)->GetReflection();
+		auto system = ParameterBlock::Create(m_context.get(), reflection, "SystemCBuf");
+		auto shadow = ParameterBlock::Create(m_context.get(), reflection, "ShadowCBuf");
+		auto atlasShadow = ParameterBlock::Create(m_context.get(), reflection, "AtlasShadowCBuf");
+
+		LightingParameters& ids = m_lightingParameters;
+		ids.dirLights = system->GetVariableID<SystemCBuf::DirectionalLight>("dirLights");
+		ids.pointLights = system->GetVariableID<SystemCBuf::PointLight>("pointLights");
+		ids.spotLights = system->GetVariableID<SystemCBuf::SpotLight>("spotLights");
+		ids.viewPosition = system->GetVariableID<XMFLOAT3>("viewPosition");
+		ids.activeDirLights = system->GetVariableID<uint32_t>("activeDirLights");
+		ids.activePointLights = system->GetVariableID<uint32_t>("activePointLights");
+		ids.activeSpotLights = system->GetVariableID<uint32_t>("activeSpotLights");
+		ids.cascadeViewProjections = shadow->GetVariableID<XMFLOAT4X4>("cascadeViewProjections");
+		ids.cascadeSplits = shadow->GetVariableID<XMFLOAT4>("cascadeSplits");
+		ids.cascadeTexelSizes = shadow->GetVariableID<XMFLOAT4>("cascadeTexelSizes");
+		ids.viewDirection = shadow->GetVariableID<XMFLOAT3>("viewDirection");
+		ids.cascadeCount = shadow->GetVariableID<uint32_t>("cascadeCount");
+		ids.atlasViews = atlasShadow->GetVariableID<AtlasShadowCBuf::AtlasView>("atlasViews");
+
+		m_resourceLib.Add("cbuf.deferred_light.ps.SystemCBuf", system);
+		m_resourceLib.Add("cbuf.deferred_light.ps.ShadowCBuf", shadow);
+		m_resourceLib.Add("cbuf.deferred_light.ps.AtlasShadowCBuf", atlasShadow);
+	}
+
+	// depth_only viewProjection of the cascade being drawn
 	{
 		D3D11_BUFFER_DESC buffDesc = {};
 		buffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		buffDesc.ByteWidth = sizeof(CBuf::PS::deferred_lighting::SystemCBuf);
+		buffDesc.ByteWidth = sizeof(XMFLOAT4X4);
 		buffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		buffDesc.MiscFlags = 0;
 		buffDesc.StructureByteStride = 0;
 		buffDesc.Usage = D3D11_USAGE_DYNAMIC;
-		m_resourceLib.Add("cbuf.deferred_light.ps.SystemCBuf", Buffer::Create(m_context.get(), buffDesc, nullptr));
+		m_resourceLib.Add("cbuf.shadow.vs.SystemCBuf", Buffer::Create(m_context.get(), buffDesc, nullptr));
+	}
+
+	{
+		D3D11_BUFFER_DESC buffDesc = {};
+		buffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		buffDesc.ByteWidth = sizeof(CBuf::PS::upscale::SystemCBuf);
+		buffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		buffDesc.MiscFlags = 0;
+		buffDesc.StructureByteStride = 0;
+		buffDesc.Usage = D3D11_USAGE_DYNAMIC;
+		m_resourceLib.Add("cbuf.upscale.ps.SystemCBuf", Buffer::Create(m_context.get(), buffDesc, nullptr));
 	}
 }
 
 void DeferredRendering::SetLoadedTexture()
 {
+	const std::pair<std::string, std::string> files[] = {
+		{ "basketball_court", "D:/Utilities/Textures/basketball_court_floor.jpg" },
+	};
+
+	// decoded in parallel, the packer takes them in file order
+	std::vector<GDX11::Utils::ImageData> images(std::size(files));
+	m_jobSystem->ParallelFor((uint32_t)images.size(), [&](uint32_t first, uint32_t last)
 	{
-		auto data = GDX11::Utils::LoadImageFile("D:/Utilities/Textures/basketball_court_floor.jpg", false, 4);
+		for (uint32_t i = first; i < last; i++)
+			images[i] = GDX11::Utils::LoadImageFile(files[i].second, false, 4);
+	}, 1);
+	for (size_t i = 0; i < images.size(); i++)
+		m_texturePacker.Add(files[i].first, images[i].width, images[i].height, DXGI_FORMAT_R8G8B8A8_UNORM);
+
+	const bool packed = m_texturePacker.Pack();
+	GDX11_ASSERT(packed, "Material textures need more texture arrays than g_buffer.ps has");
+
+	const uint32_t padding = m_texturePacker.GetDesc().atlasPadding;
+	const auto& arrays = m_texturePacker.GetArrays();
+	for (uint32_t i = 0; i < (uint32_t)arrays.size() && i < m_texturePacker.GetDesc().maxArrays; i++)
+	{
+		const TextureArrayLayout& layout = arrays[i];
+
+		// slices point at the loaded images, atlas pages are assembled here first
+		std::vector<std::vector<uint32_t>> pages(layout.atlas ? layout.sliceCount : 0);
+		for (auto& page : pages)
+			page.assign((size_t)layout.width * layout.height, 0);
+
+		std::vector<D3D11_SUBRESOURCE_DATA> srd(layout.sliceCount);
+		for (uint32_t texture = 0; texture < (uint32_t)images.size(); texture++)
+		{
+			const TexturePlacement& placement = m_texturePacker.GetPlacement(texture);
+			if (placement.array != i)
+				continue;
+
+			if (layout.atlas)
+			{
+				TexturePacker::BlitWrapped(pages[placement.slice].data(), layout.width, (const uint32_t*)images[texture].pixels,
+					placement.width, placement.height, placement.x, placement.y, padding);
+				continue;
+			}
+
+			srd[placement.slice].pSysMem = images[texture].pixels;
+			srd[placement.slice].SysMemPitch = layout.width * 4;
+		}
+		for (uint32_t slice = 0; slice < (uint32_t)pages.size(); slice++)
+		{
+			srd[slice].pSysMem = pages[slice].data();
+			srd[slice].SysMemPitch = layout.width * 4;
+		}
+
 		D3D11_TEXTURE2D_DESC texDesc = {};
-		texDesc.Width = data.width;
-		texDesc.Height = data.height;
-		texDesc.ArraySize = 1;
-		texDesc.MipLevels = 0; // generate mips
-		texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		texDesc.Width = layout.width;
+		texDesc.Height = layout.height;
+		texDesc.ArraySize = layout.sliceCount;
+		texDesc.MipLevels = layout.mipLevels; // generate mips
+		texDesc.Format = (DXGI_FORMAT)layout.format;
 		texDesc.SampleDesc.Count = 1;
 		texDesc.SampleDesc.Quality = 0;
 		texDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -395,14 +653,17 @@ void DeferredRendering::SetLoadedTexture()
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.Format = texDesc.Format;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MostDetailedMip = 0;
-		srvDesc.Texture2D.MipLevels = -1;
-
-		m_resourceLib.Add("basketball_court", ShaderResourceView::Create(m_context.get(), srvDesc, Texture2D::Create(m_context.get(), texDesc, data.pixels)));
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = -1;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = layout.sliceCount;
 
-		GDX11::Utils::FreeImageData(&data);
+		m_resourceLib.Add("texture_array." + std::to_string(i), ShaderResourceView::Create(m_context.get(), srvDesc, Texture2D::Create(m_context.get(), texDesc, srd.data())));
 	}
+
+	for (auto& image : images)
+		GDX11::Utils::FreeImageData(&image);
 }
 
 void DeferredRendering::SetSamplers()
@@ -438,6 +699,113 @@ void DeferredRendering::SetSamplers()
 		samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 		m_resourceLib.Add("point_clamp", SamplerState::Create(m_context.get(), samplerDesc));
 	}
+
+	{
+		D3D11_SAMPLER_DESC samplerDesc = CD3D11_SAMPLER_DESC(CD3D11_DEFAULT());
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+		for (int i = 0; i < 4; i++)
+			samplerDesc.BorderColor[i] = 0.0f;
+		samplerDesc.MinLOD = 0.0f;
+		samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+		m_resourceLib.Add("linear_clamp", SamplerState::Create(m_context.get(), samplerDesc));
+	}
+
+	// outside the cascade is lit
+	{
+		D3D11_SAMPLER_DESC samplerDesc = CD3D11_SAMPLER_DESC(CD3D11_DEFAULT());
+		samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.MaxAnisotropy = 1;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+		for (int i = 0; i < 4; i++)
+			samplerDesc.BorderColor[i] = 1.0f;
+		samplerDesc.MinLOD = 0.0f;
+		samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+		m_resourceLib.Add("shadow_compare", SamplerState::Create(m_context.get(), samplerDesc));
+	}
+}
+
+void DeferredRendering::SetShadowMaps()
+{
+	const ShadowCascadesDesc& desc = m_shadowCascades.GetDesc();
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = desc.resolution;
+	texDesc.Height = desc.resolution;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = desc.cascadeCount;
+	texDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags = 0;
+	texDesc.MiscFlags = 0;
+	auto shadowMap = Texture2D::Create(m_context.get(), texDesc, (void*)nullptr);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = desc.cascadeCount;
+	m_resourceLib.Add("shadow_map", ShaderResourceView::Create(m_context.get(), srvDesc, shadowMap));
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+	dsvDesc.Texture2DArray.MipSlice = 0;
+	dsvDesc.Texture2DArray.ArraySize = 1;
+	for (uint32_t i = 0; i < desc.cascadeCount; i++)
+	{
+		dsvDesc.Texture2DArray.FirstArraySlice = i;
+		m_resourceLib.Add("shadow_map." + std::to_string(i), DepthStencilView::Create(m_context.get(), dsvDesc, shadowMap));
+	}
+
+	// static casters of the cached cascades, copied into their shadow map slice every frame before the dynamic ones are drawn
+	if (desc.cachedCascadeStart < desc.cascadeCount)
+	{
+		texDesc.ArraySize = desc.cascadeCount - desc.cachedCascadeStart;
+		texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+		auto shadowCache = Texture2D::Create(m_context.get(), texDesc, (void*)nullptr);
+		for (uint32_t i = desc.cachedCascadeStart; i < desc.cascadeCount; i++)
+		{
+			dsvDesc.Texture2DArray.FirstArraySlice = i - desc.cachedCascadeStart;
+			m_resourceLib.Add("shadow_cache." + std::to_string(i), DepthStencilView::Create(m_context.get(), dsvDesc, shadowCache));
+		}
+	}
+
+	// point and spot lights, tiles keep their contents until the atlas schedules them again
+	{
+		texDesc.Width = m_shadowAtlas.GetDesc().size;
+		texDesc.Height = m_shadowAtlas.GetDesc().size;
+		texDesc.ArraySize = 1;
+		texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+		auto shadowAtlas = Texture2D::Create(m_context.get(), texDesc, (void*)nullptr);
+
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+		m_resourceLib.Add("shadow_atlas", ShaderResourceView::Create(m_context.get(), srvDesc, shadowAtlas));
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC atlasDSVDesc = {};
+		atlasDSVDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		atlasDSVDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		atlasDSVDesc.Texture2D.MipSlice = 0;
+		auto atlasDSV = DepthStencilView::Create(m_context.get(), atlasDSVDesc, shadowAtlas);
+		atlasDSV->Clear(D3D11_CLEAR_DEPTH, 1.0f, 0);
+		m_resourceLib.Add("shadow_atlas", atlasDSV);
+	}
 }
 
 void DeferredRendering::SetImGui()
@@ -468,7 +836,7 @@ void DeferredRendering::SetImGui()
 	}
 
 	// Setup Platform/Renderer bindings
-	ImGui_ImplWin32_Init(m_window->GetNativeWindow());
+	ImGui_ImplWin32_Init((HWND)m_window->GetNativeHandle());
 	ImGui_ImplDX11_Init(m_context->GetDevice(), m_context->GetDeviceContext());
 }
 
@@ -485,385 +853,1179 @@ void DeferredRendering::OnEvent(GDX11::Event& event)
 
 void DeferredRendering::OnUpdate()
 {
-	m_cameraController.OnUpdate(m_window.get());
+	if (m_desc.benchmark)
+		UpdateBenchmark();
+	else
+		m_cameraController.OnUpdate(m_window.get());
+	m_lodSelector.Update(m_camera);
+	m_meshletCuller.Update(m_camera);
+
+	// the benchmark steps by a fixed time so every run renders the same frames
+	const float deltaTime = m_desc.benchmark ? m_desc.benchmarkDesc.timeStep : m_framePacer->GetFrameTime() * 1e-3f;
+	for (auto& object : m_sceneObjects)
+	{
+		if (object.dynamic)
+			object.rotation.y = std::fmod(object.rotation.y + 45.0f * deltaTime, 360.0f);
+	}
+
+	m_shadowCascades.Update(m_camera, m_dirLight.direction);
+	BuildDrawList();
+
+	m_lightCuller.Update(m_camera);
+	m_lightCuller.Cull(m_pointLights.data(), (uint32_t)m_pointLights.size(), m_spotLights.data(), (uint32_t)m_spotLights.size());
+	UpdateShadowAtlas();
+	CullShadowCasters();
 }
 
 void DeferredRendering::OnRender()
 {
-	if (m_resize)
+	// while the size keeps changing the flip model swap chain stretches the old buffers, resizing once it settles.
+	// a minimized window reports 0x0, wait for it to come back
+	const uint32_t width = m_window->GetDesc().width;
+	const uint32_t height = m_window->GetDesc().height;
+	if (m_resize && m_resizeClock.Now() - m_resizeTime >= s_resizeDelay && width > 0 && height > 0)
 	{
-		ResizeResources(m_window->GetDesc().width, m_window->GetDesc().height);
+		ResizeResources(width, height);
 		m_resize = false;
 	}
 
+	if (m_dynamicResolutionEnabled)
+	{
+		// gpu times arrive a few frames late and not every frame, the same one fed twice would be counted twice.
+		// without gpu timings the id stays 0 and the cpu frame time is fed every frame
+		const uint64_t gpuFrameID = m_gpuProfiler->GetFrameID();
+		const float frameTime = gpuFrameID == 0 || gpuFrameID != m_dynamicResolutionGPUFrameID ? GetGPUFrameTime() : 0.0f;
+		m_dynamicResolutionGPUFrameID = gpuFrameID;
+		m_renderGraph->SetRenderScale(m_dynamicResolution.Update(frameTime));
+	}
+	else
+		m_renderGraph->SetRenderScale(1.0f);
 
+	BindDefaultState();
+	m_renderGraph->Execute();
+}
 
+float DeferredRendering::GetGPUFrameTime() const
+{
+	// the newest frame the gpu finished, a few behind the cpu. only timed with GDX11_PROFILE
+	const float gpuTime = m_gpuProfiler->GetFrameTime();
 
+	// with vsync the cpu frame time only shows a missed budget, but that's enough to scale down
+	return gpuTime > 0.0f ? gpuTime : m_framePacer->GetFrameTime();
+}
 
-
-	// todo: temp
-	static CBuf::PS::deferred_lighting::SystemCBuf::DirectionalLight dirLight;
-	static CBuf::PS::deferred_lighting::SystemCBuf::PointLight		 pointLights[4];
-	static CBuf::PS::deferred_lighting::SystemCBuf::SpotLight		 spotLight;
-
-	XMMATRIX quatMatXM = XMMatrixRotationQuaternion(XMQuaternionRotationRollPitchYaw(XMConvertToRadians(50.0f), XMConvertToRadians(-30.0f), 0.0f));
-	XMStoreFloat3(&dirLight.direction, XMVector3Transform(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), quatMatXM));
-
-	pointLights[0].position = {  0.0f,  5.0f, -5.0f };
-	pointLights[0].ambient =  {  0.2f,  0.0f,  0.0f };
-	pointLights[0].diffuse =  {  1.0f,  0.0f,  0.0f };
-	pointLights[0].specular = {  1.0f,  0.0f,  0.0f };
-
-	pointLights[1].position = {  5.0f,  5.0f,  0.0f };
-	pointLights[1].ambient =  {  0.0f,  0.2f,  0.0f };
-	pointLights[1].diffuse =  {  0.0f,  1.0f,  0.0f };
-	pointLights[1].specular = {  0.0f,  1.0f,  0.0f };
-
-	pointLights[2].position = {  0.0f,  5.0f,  5.0f };
-	pointLights[2].ambient =  {  0.0f,  0.0f,  0.2f };
-	pointLights[2].diffuse =  {  0.0f,  0.0f,  1.0f };
-	pointLights[2].specular = {  0.0f,  0.0f,  1.0f };
-
-	pointLights[3].position = { -5.0f,  5.0f,  0.0f };
-	pointLights[3].ambient =  {  0.2f,  0.2f,  0.2f };
-	pointLights[3].diffuse =  {  1.0f,  1.0f,  1.0f };
-	pointLights[3].specular = {  1.0f,  1.0f,  1.0f };
+void DeferredRendering::OnImGuiRender()
+{
+	const MeshletCullStats& stats = m_meshletCuller.GetStats();
+	ImGui::Begin("Stats");
+	ImGui::Text("Meshlets: %u / %u visible", stats.visibleMeshletCount, stats.meshletCount);
+	ImGui::Text("Frustum culled: %u, backface culled: %u", stats.frustumCulledCount, stats.backfaceCulledCount);
+	ImGui::Text("Triangles: %u / %u (%.1f%% culled)", stats.visibleTriangleCount, stats.triangleCount, stats.GetCulledTriangleRatio() * 100.0f);
+
+	ImGui::Separator();
+	const OcclusionCullStats& occlusionStats = m_occlusionCuller.GetStats();
+	ImGui::Checkbox("Occlusion culling", &m_occlusionCulling);
+	ImGui::Text("Occluded: %u / %u objects (%.1f%%)", occlusionStats.occludedCount, occlusionStats.testedCount, occlusionStats.GetOccludedRatio() * 100.0f);
+	ImGui::Text("Occluders: %u, %u / %u triangles rasterised in %.3f ms%s", occlusionStats.occluderCount, occlusionStats.rasterizedTriangleCount,
+		occlusionStats.occluderTriangleCount, occlusionStats.rasterTime, OcclusionCuller::HasAVX2() ? " (avx2)" : "");
+
+	ImGui::Separator();
+	const EventQueueStats& eventStats = m_eventQueue.GetStats();
+	ImGui::Text("Events: %u dispatched, %u coalesced, %llu dropped", eventStats.dispatchedCount, eventStats.coalescedCount, (unsigned long long)eventStats.droppedCount);
+	ImGui::Text("Lighting variant: 0x%x, %u compiled", m_lightingVariant, m_resourceLib.Get<PixelShaderPermutations>("deferred_light")->GetVariantCount());
+	ImGui::Text("Materials: %u, textures: %u in %u arrays, atlas %.1f%% used", m_materials.GetCount(), m_texturePacker.GetTextureCount(),
+		(uint32_t)m_texturePacker.GetArrays().size(), m_texturePacker.GetAtlasOccupancy() * 100.0f);
+
+	ImGui::Separator();
+	const char* depthPrePassModes[] = { "Off", "On", "Auto" };
+	int depthPrePassMode = (int)m_depthPrePassMode;
+	if (ImGui::Combo("Depth pre-pass", &depthPrePassMode, depthPrePassModes, IM_ARRAYSIZE(depthPrePassModes)))
+		m_depthPrePassMode = (DepthPrePassMode)depthPrePassMode;
+	ImGui::Text("Estimated overdraw: %.2f, pre-pass %s", m_estimatedOverdraw, m_depthPrePass ? "on" : "off");
+
+	ImGui::Separator();
+	const LightCullStats& lightStats = m_lightCuller.GetStats();
+	float luminanceThreshold = m_lightCuller.GetDesc().luminanceThreshold;
+	if (ImGui::SliderFloat("Light cutoff luminance", &luminanceThreshold, 1.0f / 1024.0f, 0.25f, "%.4f", ImGuiSliderFlags_Logarithmic))
+		m_lightCuller.SetLuminanceThreshold(luminanceThreshold);
+	ImGui::Text("Lights: %u / %u visible, %u off screen, %u over budget", lightStats.visibleCount, lightStats.lightCount, lightStats.frustumCulledCount, lightStats.budgetCulledCount);
+
+	ImGui::Separator();
+	ImGui::Text("Shadow caster draws: %u in %u cascades", m_shadowCasterDrawCount, m_shadowCascades.GetCascadeCount());
+	ImGui::Text("Cached cascade re-renders: %llu", (unsigned long long)m_shadowCascades.GetStaticRenderCount());
+	if (ImGui::Button("Invalidate cached shadows"))
+		m_shadowCascades.InvalidateStatic();
+	const ShadowAtlasStats& atlasStats = m_shadowAtlas.GetStats();
+	int viewBudget = (int)m_shadowAtlas.GetDesc().viewBudget;
+	if (ImGui::SliderInt("Atlas views per frame", &viewBudget, 1, 32))
+		m_shadowAtlas.SetViewBudget((uint32_t)viewBudget);
+	ImGui::Text("Atlas: %u / %u lights shadowed, %u failed to fit, %.1f%% used", atlasStats.shadowedLightCount, atlasStats.lightCount, atlasStats.allocationFailures,
+		100.0 * atlasStats.allocatedTexels / ((double)m_shadowAtlas.GetDesc().size * m_shadowAtlas.GetDesc().size));
+	ImGui::Text("Atlas views: %u rendered / %u dirty, longest wait %u frames", atlasStats.renderedViewCount, atlasStats.dirtyViewCount, atlasStats.maxWait);
+
+	ImGui::Separator();
+	FramePacerDesc pacerDesc = m_framePacer->GetDesc();
+	if (ImGui::Checkbox("VSync", &pacerDesc.vsync))
+		m_framePacer->SetVSync(pacerDesc.vsync);
+	if (ImGui::SliderFloat("Max FPS", &pacerDesc.maxFrameRate, 0.0f, 240.0f, pacerDesc.maxFrameRate > 0.0f ? "%.0f" : "unlimited"))
+		m_framePacer->SetMaxFrameRate(pacerDesc.maxFrameRate);
+	int maxFrameLatency = (int)pacerDesc.maxFrameLatency;
+	if (ImGui::SliderInt("Max frame latency", &maxFrameLatency, 1, 3))
+		m_framePacer->SetMaxFrameLatency((uint32_t)maxFrameLatency);
+
+	ImGui::Separator();
+	for (uint32_t i = 0; i <= (uint32_t)MemoryCategory::Count; i++)
+	{
+		const MemoryStats memoryStats = MemoryTracker::GetStats((MemoryCategory)i);
+		const bool overBudget = memoryStats.budget && memoryStats.bytes > memoryStats.budget;
+		ImGui::TextColored(overBudget ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text), "%s: %.1f MB, peak %.1f MB, %u resources",
+			MemoryTracker::GetCategoryName((MemoryCategory)i), memoryStats.bytes / (1024.0 * 1024.0), memoryStats.peakBytes / (1024.0 * 1024.0), memoryStats.resourceCount);
+	}
+	int memoryBudget = (int)(MemoryTracker::GetStats(MemoryCategory::Count).budget / (1024 * 1024));
+	if (ImGui::SliderInt("Memory budget (MB)", &memoryBudget, 0, 4096, memoryBudget ? "%d" : "none"))
+		MemoryTracker::SetBudget(MemoryCategory::Count, (uint64_t)memoryBudget * 1024 * 1024);
+	if (ImGui::Button("Reset memory peaks"))
+		MemoryTracker::ResetPeaks();
+	ImGui::SameLine();
+	if (ImGui::Button("Write memory report"))
+		MemoryTracker::WriteJSON(m_desc.memoryReport.empty() ? "memory.json" : m_desc.memoryReport);
+
+#ifdef GDX11_DEBUG
+	ImGui::Separator();
+	const char* validationLevels[] = { "Off", "Per frame", "Per pass", "Per call" };
+	int validationLevel = (int)GDX11Context::GetInfoManager().GetLevel();
+	if (ImGui::Combo("Validation", &validationLevel, validationLevels, IM_ARRAYSIZE(validationLevels)))
+		GDX11Context::GetInfoManager().SetLevel((ValidationLevel)validationLevel);
+#endif // GDX11_DEBUG
+
+	ImGui::Separator();
+	ImGui::Checkbox("Dynamic resolution", &m_dynamicResolutionEnabled);
+	DynamicResolutionDesc resolutionDesc = m_dynamicResolution.GetDesc();
+	bool resolutionChanged = ImGui::SliderFloat("Frame budget (ms)", &resolutionDesc.targetFrameTime, 4.0f, 50.0f, "%.1f");
+	resolutionChanged |= ImGui::SliderFloat("Min scale", &resolutionDesc.minScale, 0.25f, resolutionDesc.maxScale, "%.2f");
+	resolutionChanged |= ImGui::SliderFloat("Max scale", &resolutionDesc.maxScale, resolutionDesc.minScale, 1.0f, "%.2f");
+	if (resolutionChanged)
+		m_dynamicResolution.Set(resolutionDesc);
+	ImGui::Text("Scale: %.2f (%ux%u), gpu %.2f ms", m_renderGraph->GetRenderScale(),
+		(uint32_t)(m_window->GetDesc().width * m_renderGraph->GetRenderScale() + 0.5f), (uint32_t)(m_window->GetDesc().height * m_renderGraph->GetRenderScale() + 0.5f),
+		m_dynamicResolution.GetSmoothedFrameTime());
+
+	ImGui::Separator();
+	int recordingThreads = (int)m_recordingThreads;
+	if (ImGui::SliderInt("Recording threads", &recordingThreads, 1, (int)m_jobSystem->GetThreadCount()))
+		m_recordingThreads = (uint32_t)recordingThreads;
+
+	ImGui::Separator();
+	uint64_t executed = 0, stolen = 0, failedSteals = 0;
+	for (const auto& jobStats : m_jobSystem->GetStats())
+	{
+		executed += jobStats.executed;
+		stolen += jobStats.stolen;
+		failedSteals += jobStats.failedSteals;
+	}
+	ImGui::Text("Jobs: %llu, stolen: %llu, failed steals: %llu", (unsigned long long)executed, (unsigned long long)stolen, (unsigned long long)failedSteals);
+	if (ImGui::Button("Job scaling benchmark"))
+		JobBenchmark::Log(JobBenchmark::Run());
+	ImGui::SameLine();
+	if (ImGui::Button("Micro benchmarks"))
+		MicroBenchmark::Log(MicroBenchmark::Run(m_context.get()));
+
+	ImGui::Separator();
+	const RenderGraphStats& graphStats = m_renderGraph->GetStats();
+	ImGui::Text("Render graph passes: %u (%u culled)", graphStats.passCount, graphStats.culledPassCount);
+	ImGui::Text("Textures: %u physical / %u transient", graphStats.physicalTextureCount, graphStats.transientTextureCount);
+	ImGui::Text("Memory: %.1f MB / %.1f MB without aliasing", graphStats.physicalBytes / (1024.0 * 1024.0), graphStats.transientBytes / (1024.0 * 1024.0));
+	const RenderTargetPoolStats poolStats = m_renderTargetPool->GetStats();
+	ImGui::Text("Pool: %u targets (%u free, %u retired), %.1f MB", poolStats.targetCount, poolStats.freeCount, poolStats.retiredCount, poolStats.allocatedBytes / (1024.0 * 1024.0));
+	ImGui::Text("Pool allocations: %llu, destroyed: %llu", (unsigned long long)poolStats.allocationCount, (unsigned long long)poolStats.destroyCount);
+	ImGui::End();
+
+	ProfilerOverlay::Render();
+}
 
 
-	spotLight.direction = { 0.0f, 1.0f, 0.0f };
-	spotLight.position =  { 0.0f,  7.0f, 0.0f };
 
+void DeferredRendering::ImGuiBegin()
+{
+	ImGui_ImplDX11_NewFrame();
+	ImGui_ImplWin32_NewFrame();
+	ImGui::NewFrame();
+}
 
+void DeferredRendering::ImGuiEnd()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(static_cast<float>(m_window->GetDesc().width), static_cast<float>((m_window->GetDesc().height)));
 
+	// Rendering
+	ImGui::Render();
+	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
+	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+	{
+		ImGui::UpdatePlatformWindows();
+		ImGui::RenderPlatformWindowsDefault();
+	}
+}
 
+void DeferredRendering::SetScene()
+{
+	XMMATRIX quatMatXM = XMMatrixRotationQuaternion(XMQuaternionRotationRollPitchYaw(XMConvertToRadians(50.0f), XMConvertToRadians(-30.0f), 0.0f));
+	XMStoreFloat3(&m_dirLight.direction, XMVector3Transform(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), quatMatXM));
 
+	if (m_desc.benchmark)
+	{
+		Material base;
+		base.diffuseMap = "basketball_court";
+		base.specularMap = "basketball_court";
+		m_benchmarkScene = SceneBenchmark::Generate(m_desc.benchmarkDesc, base);
+
+		// generated material indices are local to the benchmark scene
+		std::vector<uint32_t> materials;
+		for (const auto& material : m_benchmarkScene.materials)
+			materials.push_back(m_materials.Add(material));
+		m_sceneObjects = m_benchmarkScene.objects;
+		for (auto& object : m_sceneObjects)
+			object.material = materials[object.material];
+		m_pointLights = m_benchmarkScene.pointLights;
+		m_spotLights = m_benchmarkScene.spotLights;
+
+		GDX11_ASSERT(m_materials.GetCount() <= CBuf::PS::g_buffer::s_materialMaxCount, "Material table is full");
+		return;
+	}
 
+	Material floor;
+	floor.tiling = { 10.0f, 10.0f };
+	floor.shininess = 120.0f;
+	floor.diffuseMap = "basketball_court";
+	floor.specularMap = "basketball_court";
+
+	Material crate;
+	crate.diffuseMap = "basketball_court";
+	crate.specularMap = "basketball_court";
+
+	SceneObject plane;
+	plane.mesh = "plane";
+	plane.position = { 0.0f, -0.5f, 0.0f };
+	plane.scale = 25.0f;
+	plane.material = m_materials.Add(floor);
+	m_sceneObjects.push_back(plane);
+
+	SceneObject cube;
+	cube.mesh = "cube";
+	cube.material = m_materials.Add(crate);
+
+	cube.occluder = true;
+	cube.position = { 0.0f, 1.5f, 0.0f };
+	m_sceneObjects.push_back(cube);
+
+	cube.position = { 2.0f, 0.0f, -1.0f };
+	m_sceneObjects.push_back(cube);
+
+	cube.occluder = false;
+	cube.position = { -1.0f, 0.0f, -2.0f };
+	cube.rotation = { 60.0f, 60.0f, 60.0f };
+	cube.scale = 0.5f;
+	m_sceneObjects.push_back(cube);
+
+	// spins in OnUpdate
+	cube.dynamic = true;
+	cube.position = { 1.5f, 4.0f, -2.0f };
+	cube.rotation = { 0.0f, 0.0f, 0.0f };
+	cube.scale = 0.25f;
+	m_sceneObjects.push_back(cube);
+
+	m_pointLights.resize(4);
+	m_pointLights[0].position = {  0.0f,  5.0f, -5.0f };
+	m_pointLights[0].ambient =  {  0.2f,  0.0f,  0.0f };
+	m_pointLights[0].diffuse =  {  1.0f,  0.0f,  0.0f };
+	m_pointLights[0].specular = {  1.0f,  0.0f,  0.0f };
+
+	m_pointLights[1].position = {  5.0f,  5.0f,  0.0f };
+	m_pointLights[1].ambient =  {  0.0f,  0.2f,  0.0f };
+	m_pointLights[1].diffuse =  {  0.0f,  1.0f,  0.0f };
+	m_pointLights[1].specular = {  0.0f,  1.0f,  0.0f };
+
+	m_pointLights[2].position = {  0.0f,  5.0f,  5.0f };
+	m_pointLights[2].ambient =  {  0.0f,  0.0f,  0.2f };
+	m_pointLights[2].diffuse =  {  0.0f,  0.0f,  1.0f };
+	m_pointLights[2].specular = {  0.0f,  0.0f,  1.0f };
+
+	m_pointLights[3].position = { -5.0f,  5.0f,  0.0f };
+	m_pointLights[3].ambient =  {  0.2f,  0.2f,  0.2f };
+	m_pointLights[3].diffuse =  {  1.0f,  1.0f,  1.0f };
+	m_pointLights[3].specular = {  1.0f,  1.0f,  1.0f };
+
+	m_spotLights.resize(1);
+	m_spotLights[0].direction = { 0.0f, -1.0f, 0.0f };
+	m_spotLights[0].position =  { 0.0f,  7.0f, 0.0f };
+
+	GDX11_ASSERT(m_materials.GetCount() <= CBuf::PS::g_buffer::s_materialMaxCount, "Material table is full");
+}
 
-	m_resourceLib.Get<RasterizerState>("default")->Bind();
-	m_resourceLib.Get<BlendState>("default")->Bind(nullptr, 0xffffffff);
-	m_resourceLib.Get<DepthStencilState>("default")->Bind(0xff);
+void DeferredRendering::UpdateBenchmark()
+{
+	const float time = m_benchmarkFrame * m_desc.benchmarkDesc.timeStep;
+	SceneBenchmark::Animate(m_benchmarkScene, time);
+	m_pointLights = m_benchmarkScene.pointLights;
+	m_spotLights = m_benchmarkScene.spotLights;
+	SceneBenchmark::UpdateCamera(m_benchmarkScene, m_desc.benchmarkDesc, time, m_camera);
+}
 
-	// G-Buffer Pass
+void DeferredRendering::RecordBenchmarkFrame(uint64_t frameBegin)
+{
+	const float cpuTime = (float)(Profiler::Now() - frameBegin) * 1e-6f;
+	const RenderCounterStats counters = RenderCounters::Sample();
+	if (m_benchmarkFrame++ < m_desc.benchmarkDesc.warmupFrames)
+		return;
+
+	// a few frames behind the cpu, GPUProfiler reads its queries late. a frame where none finished gets no gpu time
+	// rather than the last one again
+	float gpuTime = 0.0f;
+	if (m_gpuProfiler->GetFrameID() != m_benchmarkGPUFrameID)
 	{
-		auto gBufferRTV = m_resourceLib.Get<RenderTargetViewArray>("g_buffer");
-		RenderTargetView::Bind(*gBufferRTV, m_resourceLib.Get<DepthStencilView>("main").get());
-		for (const auto& v : *gBufferRTV)
-			v->Clear(0.0f, 0.0f, 0.0f, 0.0f);
-		m_resourceLib.Get<DepthStencilView>("main")->Clear(D3D11_CLEAR_DEPTH, 1.0f, 0xff);
-
+		m_benchmarkGPUFrameID = m_gpuProfiler->GetFrameID();
+		gpuTime = m_gpuProfiler->GetFrameTime();
+	}
 
-		auto vs = m_resourceLib.Get<VertexShader>("g_buffer");
-		auto ps = m_resourceLib.Get<PixelShader>("g_buffer");
-		vs->Bind();
-		ps->Bind();
-		m_resourceLib.Get<InputLayout>("g_buffer")->Bind();
+	SceneBenchmark::FrameSample sample;
+	sample.cpuTime = cpuTime;
+	sample.gpuTime = gpuTime;
+	sample.drawCount = counters.drawCount;
+	sample.indexCount = counters.indexCount;
+	sample.stateChangeCount = counters.stateChangeCount;
+	sample.skippedStateChangeCount = counters.skippedStateChangeCount;
+	sample.uploadedBytes = counters.uploadedBytes;
+	sample.visibleObjectCount = (uint32_t)m_drawList.size();
+	sample.visibleLightCount = m_lightCuller.GetStats().visibleCount;
+	const MeshletCullStats& meshletStats = m_meshletCuller.GetStats();
+	sample.meshletCount = meshletStats.meshletCount;
+	sample.visibleMeshletCount = meshletStats.visibleMeshletCount;
+	sample.frustumCulledMeshletCount = meshletStats.frustumCulledCount;
+	sample.backfaceCulledMeshletCount = meshletStats.backfaceCulledCount;
+	sample.triangleCount = meshletStats.triangleCount;
+	sample.visibleTriangleCount = meshletStats.visibleTriangleCount;
+	const OcclusionCullStats& occlusionStats = m_occlusionCuller.GetStats();
+	sample.occlusionTestedCount = occlusionStats.testedCount;
+	sample.occludedCount = occlusionStats.occludedCount;
+	sample.occlusionRasterTime = occlusionStats.rasterTime;
+	m_benchmarkSamples.push_back(sample);
+}
 
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.SystemCBuf")->VSBindAsCBuf(vs->GetResBinding("SystemCBuf"));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->VSBindAsCBuf(vs->GetResBinding("UserCBuf"));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->PSBindAsCBuf(ps->GetResBinding("UserCBuf"));
-		
+void DeferredRendering::SetRenderGraph()
+{
+	m_renderGraph = RenderGraph::Create(m_context.get(), m_renderTargetPool);
+	m_renderGraph->ImportRenderTarget("back_buffer", m_resourceLib.Get<RenderTargetView>("main"));
+	m_renderGraph->SetBackBufferSize(m_window->GetDesc().width, m_window->GetDesc().height);
 
-		XMFLOAT4X4 viewProj;
-		XMStoreFloat4x4(&viewProj, XMMatrixTranspose(m_camera.GetViewMatrix() * m_camera.GetProjectionMatrix()));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.SystemCBuf")->SetData(&viewProj);
+	// the cascades live outside the graph, the cached ones keep their static casters across frames
+	m_renderGraph->AddPass("Shadows",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.SetSideEffect();
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Shadows");
+
+			m_shadowCasterDrawCount = 0;
+
+			auto vs = m_resourceLib.Get<VertexShader>("depth_only");
+			vs->Bind();
+			m_context->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+			m_resourceLib.Get<InputLayout>("depth_only")->Bind();
+			m_resourceLib.Get<RasterizerState>("shadow")->Bind();
+			auto vsSysCBuf = m_resourceLib.Get<Buffer>("cbuf.shadow.vs.SystemCBuf");
+			vsSysCBuf->VSBindAsCBuf(vs->GetResBinding("SystemCBuf"));
+			m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->VSBindAsCBuf(vs->GetResBinding("UserCBuf"));
+
+			D3D11_VIEWPORT vp = {};
+			vp.Width = (float)m_shadowCascades.GetDesc().resolution;
+			vp.Height = (float)m_shadowCascades.GetDesc().resolution;
+			vp.MinDepth = 0.0f;
+			vp.MaxDepth = 1.0f;
+			m_context->GetDeviceContext()->RSSetViewports(1, &vp);
+
+			const uint32_t cachedCascadeStart = m_shadowCascades.GetDesc().cachedCascadeStart;
+			for (uint32_t i = 0; i < m_shadowCascades.GetCascadeCount(); i++)
+			{
+				const ShadowCascade& cascade = m_shadowCascades.GetCascade(i);
+				XMFLOAT4X4 viewProjection;
+				XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&cascade.viewProjection)));
+				vsSysCBuf->SetData(&viewProjection);
+
+				auto dsv = m_resourceLib.Get<DepthStencilView>("shadow_map." + std::to_string(i));
+				if (!cascade.cached)
+				{
+					dsv->Clear(D3D11_CLEAR_DEPTH, 1.0f, 0);
+					dsv->Bind();
+					DrawShadowCasters(true, true, i);
+					continue;
+				}
+
+				auto cache = m_resourceLib.Get<DepthStencilView>("shadow_cache." + std::to_string(i));
+				if (cascade.staticDirty)
+				{
+					cache->Clear(D3D11_CLEAR_DEPTH, 1.0f, 0);
+					cache->Bind();
+					DrawShadowCasters(true, false, i);
+				}
+
+				m_context->GetDeviceContext()->CopySubresourceRegion(
+					dsv->GetTexture2D()->GetNative(), D3D11CalcSubresource(0, i, 1), 0, 0, 0,
+					cache->GetTexture2D()->GetNative(), D3D11CalcSubresource(0, i - cachedCascadeStart, 1), nullptr);
+				dsv->Bind();
+				DrawShadowCasters(false, true, i);
+			}
+
+			BindDefaultState();
+		});
+
+	m_renderGraph->AddPass("Shadow Atlas",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.SetSideEffect();
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Shadow Atlas");
+
+			auto vs = m_resourceLib.Get<VertexShader>("depth_only");
+			auto vsSysCBuf = m_resourceLib.Get<Buffer>("cbuf.shadow.vs.SystemCBuf");
+			vsSysCBuf->VSBindAsCBuf(vs->GetResBinding("SystemCBuf"));
+			m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->VSBindAsCBuf(vs->GetResBinding("UserCBuf"));
+			m_resourceLib.Get<RasterizerState>("shadow_atlas")->Bind();
+			m_resourceLib.Get<DepthStencilView>("shadow_atlas")->Bind();
+
+			const auto& renderViews = m_shadowAtlas.GetRenderViews();
+			for (uint32_t i = 0; i < (uint32_t)renderViews.size(); i++)
+			{
+				const ShadowAtlasView& view = m_shadowAtlas.GetViews()[renderViews[i]];
+				D3D11_VIEWPORT vp = {};
+				vp.TopLeftX = (float)view.x;
+				vp.TopLeftY = (float)view.y;
+				vp.Width = (float)view.size;
+				vp.Height = (float)view.size;
+				vp.MinDepth = 0.0f;
+				vp.MaxDepth = 1.0f;
+				m_context->GetDeviceContext()->RSSetViewports(1, &vp);
+
+				// only the tile, the others keep their shadows
+				m_resourceLib.Get<VertexShader>("fullscreen")->Bind();
+				m_resourceLib.Get<PixelShader>("shadow_clear")->Bind();
+				m_resourceLib.Get<InputLayout>("fullscreen")->Bind();
+				m_resourceLib.Get<DepthStencilState>("depth_always")->Bind(0xff);
+				DrawFullscreen();
+				m_resourceLib.Get<DepthStencilState>("default")->Bind(0xff);
+
+				vs->Bind();
+				m_context->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+				m_resourceLib.Get<InputLayout>("depth_only")->Bind();
+				XMFLOAT4X4 viewProjection;
+				XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&view.viewProjection)));
+				vsSysCBuf->SetData(&viewProjection);
+				DrawShadowCasters(true, true, m_shadowCascades.GetCascadeCount() + i);
+			}
+
+			BindDefaultState();
+		});
+
+	// always in the graph so it owns the depth clear, draws nothing while m_depthPrePass is off
+	m_renderGraph->AddPass("Depth Pre-Pass",
+		[](RenderGraphBuilder& builder)
+		{
+			// g-buffer and lighting run at the dynamic resolution scale
+			builder.CreateScaled("depth", DXGI_FORMAT_D32_FLOAT);
+			builder.WriteDepth("depth");
+			builder.ClearDepth("depth", 1.0f, 0xff);
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Depth Pre-Pass");
 
-		DrawScene();
-	}
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, XMMatrixTranspose(m_camera.GetViewMatrix() * m_camera.GetProjectionMatrix()));
+			m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.SystemCBuf")->SetData(&viewProj);
 
-	// render to quad
-	{
-		m_resourceLib.Get<RenderTargetView>("main")->Bind(nullptr);
-		m_resourceLib.Get<RenderTargetView>("main")->Clear(0.1f, 0.1f, 0.1f, 1.0f);
+			if (!m_depthPrePass)
+				return;
 
+			auto vs = m_resourceLib.Get<VertexShader>("depth_only");
+			m_gBufferBindings.vsSystemCBuf = vs->GetResBinding("SystemCBuf");
+			m_gBufferBindings.vsUserCBuf = vs->GetResBinding("UserCBuf");
+			RecordGBufferPass(resources, true);
+		});
 
-		auto vs = m_resourceLib.Get<VertexShader>("fullscreen");
-		auto ps = m_resourceLib.Get<PixelShader>("deferred_light");
-		vs->Bind();
-		ps->Bind();
-		m_resourceLib.Get<InputLayout>("fullscreen")->Bind();
+	m_renderGraph->AddPass("G-Buffer",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.CreateScaled("g_position", DXGI_FORMAT_R32G32B32A32_FLOAT);
+			builder.CreateScaled("g_normal", DXGI_FORMAT_R32G32B32A32_FLOAT);
+			builder.CreateScaled("g_diffuse", DXGI_FORMAT_R8G8B8A8_UNORM);
+			builder.CreateScaled("g_specular", DXGI_FORMAT_R8G8B8A8_UNORM);
+			// index into the material table, lighting reads the shininess from there
+			builder.CreateScaled("g_material", DXGI_FORMAT_R16_UINT);
+
+			for (const char* name : { "g_position", "g_normal", "g_diffuse", "g_specular", "g_material" })
+			{
+				builder.Write(name);
+				builder.Clear(name, 0.0f, 0.0f, 0.0f, 0.0f);
+			}
+			// only tested with the pre-pass on
+			builder.WriteDepth("depth");
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "G-Buffer");
+
+			// resolved here, GetResBinding isn't safe to call from several recording threads
+			auto vs = m_resourceLib.Get<VertexShader>("g_buffer");
+			auto ps = m_resourceLib.Get<PixelShader>("g_buffer");
+			m_gBufferBindings.vsSystemCBuf = vs->GetResBinding("SystemCBuf");
+			m_gBufferBindings.vsUserCBuf = vs->GetResBinding("UserCBuf");
+			m_gBufferBindings.psMaterialCBuf = ps->GetResBinding("MaterialCBuf");
+			m_gBufferBindings.textureArrays = ps->GetResBinding("textureArrays");
+			m_gBufferBindings.textureSampler = ps->GetResBinding("textureSampler");
+
+			if (m_materials.IsDirty())
+			{
+				CBuf::PS::g_buffer::MaterialCBuf psMaterialCBufData;
+				m_materials.Fill(psMaterialCBufData, m_texturePacker);
+				m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.MaterialCBuf")->SetData(&psMaterialCBufData);
+			}
+
+			m_meshletCuller.ResetStats();
+			RecordGBufferPass(resources, false);
+		});
+
+	m_renderGraph->AddPass("Lighting",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.CreateScaled("scene_lit", DXGI_FORMAT_R8G8B8A8_UNORM);
+			for (const char* name : { "g_position", "g_normal", "g_diffuse", "g_specular", "g_material" })
+				builder.Read(name);
+			builder.Write("scene_lit");
+			builder.Clear("scene_lit", 0.1f, 0.1f, 0.1f, 1.0f);
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Lighting");
+
+			using namespace CBuf::PS::deferred_lighting;
+			const LightingParameters& ids = m_lightingParameters;
+			auto system = m_resourceLib.Get<ParameterBlock>("cbuf.deferred_light.ps.SystemCBuf");
+			auto shadow = m_resourceLib.Get<ParameterBlock>("cbuf.deferred_light.ps.ShadowCBuf");
+			auto atlasShadow = m_resourceLib.Get<ParameterBlock>("cbuf.deferred_light.ps.AtlasShadowCBuf");
+
+			// Light, the blocks keep last frame's values and only upload what changed
+			system->Set(ids.dirLights, m_dirLight, 0);
+
+			// views past the cbuf's array go without shadow
+			const auto& atlasViews = m_shadowAtlas.GetViews();
+			for (uint32_t i = 0; i < (uint32_t)atlasViews.size() && i < s_atlasViewMaxCount; i++)
+			{
+				AtlasShadowCBuf::AtlasView atlasView;
+				XMStoreFloat4x4(&atlasView.viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&atlasViews[i].viewProjection)));
+				atlasView.atlasRect = atlasViews[i].atlasRect;
+				atlasShadow->Set(ids.atlasViews, atlasView, i);
+			}
+			bool atlasShadows = false;
+			auto shadowIndex = [&](uint32_t light, uint32_t viewCount)
+			{
+				const int32_t first = m_shadowAtlas.GetFirstView(light);
+				const bool shadowed = first >= 0 && first + viewCount <= s_atlasViewMaxCount;
+				atlasShadows |= shadowed;
+				return shadowed ? first : -1;
+			};
+
+			// only what the light culler kept, most contributing first. shadow lights are in the same order
+			const auto& pointLights = m_lightCuller.GetPointLights();
+			const auto& spotLights = m_lightCuller.GetSpotLights();
+			for (uint32_t i = 0; i < (uint32_t)pointLights.size(); i++)
+			{
+				SystemCBuf::PointLight light = m_pointLights[pointLights[i].index];
+				light.shadowIndex = shadowIndex(i, 6);
+				system->Set(ids.pointLights, light, i);
+			}
+			for (uint32_t i = 0; i < (uint32_t)spotLights.size(); i++)
+			{
+				SystemCBuf::SpotLight light = m_spotLights[spotLights[i].index];
+				light.shadowIndex = shadowIndex((uint32_t)pointLights.size() + i, 1);
+				system->Set(ids.spotLights, light, i);
+			}
+			const uint32_t activeDirLights = 1;
+			const uint32_t activePointLights = (uint32_t)pointLights.size();
+			const uint32_t activeSpotLights = (uint32_t)spotLights.size();
+			system->Set(ids.activeDirLights, activeDirLights);
+			system->Set(ids.activePointLights, activePointLights);
+			system->Set(ids.activeSpotLights, activeSpotLights);
+			system->Set(ids.viewPosition, m_camera.GetDesc().position);
+
+			XMFLOAT4 cascadeSplits = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+			XMFLOAT4 cascadeTexelSizes = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 0; i < m_shadowCascades.GetCascadeCount(); i++)
+			{
+				const ShadowCascade& cascade = m_shadowCascades.GetCascade(i);
+				XMFLOAT4X4 viewProjection;
+				XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&cascade.viewProjection)));
+				shadow->Set(ids.cascadeViewProjections, viewProjection, i);
+				(&cascadeSplits.x)[i] = cascade.splitFar;
+				(&cascadeTexelSizes.x)[i] = cascade.texelSize;
+			}
+			XMFLOAT3 viewDirection;
+			XMStoreFloat3(&viewDirection, m_camera.GetForwardDirection());
+			shadow->Set(ids.cascadeSplits, cascadeSplits);
+			shadow->Set(ids.cascadeTexelSizes, cascadeTexelSizes);
+			shadow->Set(ids.viewDirection, viewDirection);
+			shadow->Set(ids.cascadeCount, m_shadowCascades.GetCascadeCount());
+
+			// the variant for this frame's light mix, light types without lights have no loop in it
+			auto permutations = m_resourceLib.Get<PixelShaderPermutations>("deferred_light");
+			m_lightingVariant = 0;
+			if (activeDirLights)
+				m_lightingVariant |= permutations->GetMask("DIRECTIONAL_LIGHTS");
+			if (activePointLights)
+				m_lightingVariant |= permutations->GetMask("POINT_LIGHTS");
+			if (activeSpotLights)
+				m_lightingVariant |= permutations->GetMask("SPOT_LIGHTS");
+			if (atlasShadows)
+				m_lightingVariant |= permutations->GetMask("ATLAS_SHADOWS");
+
+			auto vs = m_resourceLib.Get<VertexShader>("fullscreen");
+			auto ps = permutations->Get(m_lightingVariant);
+			vs->Bind();
+			ps->Bind();
+			m_resourceLib.Get<InputLayout>("fullscreen")->Bind();
+
+			// a variant can compile out what its light mix doesn't read
+			auto bindSRV = [&ps](const std::shared_ptr<ShaderResourceView>& srv, const std::string& name)
+			{
+				if (ps->HasResBinding(name))
+					srv->PSBind(ps->GetResBinding(name));
+			};
+			auto bindCBuf = [&ps](const std::shared_ptr<Buffer>& cbuf, const std::string& name)
+			{
+				if (ps->HasResBinding(name))
+					cbuf->PSBindAsCBuf(ps->GetResBinding(name));
+			};
+			// flushed whether or not the variant reads them, the cpu copy is ahead until then
+			auto bindParameterBlock = [&ps](const std::shared_ptr<ParameterBlock>& block)
+			{
+				block->Flush();
+				if (ps->HasResBinding(block->GetName()))
+					block->PSBind(ps->GetResBinding(block->GetName()));
+			};
+
+			bindSRV(resources.GetSRV("g_position"), "gPosition");
+			bindSRV(resources.GetSRV("g_normal"), "gNormal");
+			bindSRV(resources.GetSRV("g_diffuse"), "gDiffuse");
+			bindSRV(resources.GetSRV("g_specular"), "gSpecular");
+			bindSRV(resources.GetSRV("g_material"), "gMaterial");
+			bindSRV(m_resourceLib.Get<ShaderResourceView>("shadow_map"), "shadowMap");
+			bindSRV(m_resourceLib.Get<ShaderResourceView>("shadow_atlas"), "shadowAtlas");
+			if (ps->HasResBinding("shadowSampler"))
+				m_resourceLib.Get<SamplerState>("shadow_compare")->PSBind(ps->GetResBinding("shadowSampler"));
+			bindCBuf(m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.MaterialCBuf"), "MaterialCBuf");
+			bindParameterBlock(system);
+			bindParameterBlock(shadow);
+			bindParameterBlock(atlasShadow);
+
+			DrawFullscreen();
+
+			// the shadow passes bind them as depth next frame
+			ID3D11ShaderResourceView* nullSRV = nullptr;
+			for (const char* name : { "shadowMap", "shadowAtlas" })
+			{
+				if (ps->HasResBinding(name))
+					m_context->GetDeviceContext()->PSSetShaderResources(ps->GetResBinding(name), 1, &nullSRV);
+			}
+		});
+
+	// to full resolution, depth too so the forward passes can test against it.
+	// not the back buffer directly, d3d11 wants a depth buffer to match the render target size
+	// and pooled targets can be bigger than the back buffer
+	m_renderGraph->AddPass("Upscale",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.Create("scene_color", { 0, 0, DXGI_FORMAT_R8G8B8A8_UNORM });
+			builder.Create("depth_full", { 0, 0, DXGI_FORMAT_D32_FLOAT });
+			builder.Read("scene_lit");
+			builder.Read("depth");
+			builder.Write("scene_color");
+			builder.WriteDepth("depth_full");
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Upscale");
+
+			auto vs = m_resourceLib.Get<VertexShader>("fullscreen");
+			auto ps = m_resourceLib.Get<PixelShader>("upscale");
+			vs->Bind();
+			ps->Bind();
+			m_resourceLib.Get<InputLayout>("fullscreen")->Bind();
+
+			resources.GetSRV("scene_lit")->PSBind(ps->GetResBinding("sceneColor"));
+			resources.GetSRV("depth")->PSBind(ps->GetResBinding("sceneDepth"));
+			m_resourceLib.Get<SamplerState>("linear_clamp")->PSBind(ps->GetResBinding("linearSampler"));
+			m_resourceLib.Get<SamplerState>("point_clamp")->PSBind(ps->GetResBinding("pointSampler"));
+
+			const RenderTarget* source = resources.GetTarget("scene_lit");
+			CBuf::PS::upscale::SystemCBuf psSysCBufData;
+			psSysCBufData.uvScale = { (float)source->desc.width / (float)source->allocatedWidth, (float)source->desc.height / (float)source->allocatedHeight };
+			psSysCBufData.uvMax = { ((float)source->desc.width - 0.5f) / (float)source->allocatedWidth, ((float)source->desc.height - 0.5f) / (float)source->allocatedHeight };
+			auto psSysCBuf = m_resourceLib.Get<Buffer>("cbuf.upscale.ps.SystemCBuf");
+			psSysCBuf->PSBindAsCBuf(ps->GetResBinding("SystemCBuf"));
+			psSysCBuf->SetData(&psSysCBufData);
+
+			// every pixel is written, no clear needed
+			m_resourceLib.Get<DepthStencilState>("depth_always")->Bind(0xff);
+			DrawFullscreen();
+			m_resourceLib.Get<DepthStencilState>("default")->Bind(0xff);
+		});
 
-		m_resourceLib.Get<ShaderResourceView>("g_bufferTextureView0")->PSBind(ps->GetResBinding("gPosition"));
-		m_resourceLib.Get<ShaderResourceView>("g_bufferTextureView1")->PSBind(ps->GetResBinding("gNormal"));
-		m_resourceLib.Get<ShaderResourceView>("g_bufferTextureView2")->PSBind(ps->GetResBinding("gDiffuse"));
-		m_resourceLib.Get<ShaderResourceView>("g_bufferTextureView3")->PSBind(ps->GetResBinding("gSpecular"));
-		m_resourceLib.Get<ShaderResourceView>("g_bufferTextureView4")->PSBind(ps->GetResBinding("gShininess"));
-		m_resourceLib.Get<SamplerState>("point_clamp")->PSBind(ps->GetResBinding("gSampler"));
+	// forward render light source
+	m_renderGraph->AddPass("Light Sources",
+		[](RenderGraphBuilder& builder)
+		{
+			// depth tested against the g-buffer pass, not cleared
+			builder.Write("scene_color");
+			builder.ReadDepth("depth_full");
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Light Sources");
+
+			auto vs = m_resourceLib.Get<VertexShader>("basic");
+			auto ps = m_resourceLib.Get<PixelShader>("basic");
+			vs->Bind();
+			ps->Bind();
+			m_resourceLib.Get<InputLayout>("basic")->Bind();
+
+			m_resourceLib.Get<Buffer>("cbuf.basic.vs.SystemCBuf")->VSBindAsCBuf(vs->GetResBinding("SystemCBuf"));
+			m_resourceLib.Get<Buffer>("cbuf.basic.vs.UserCBuf")->VSBindAsCBuf(vs->GetResBinding("UserCBuf"));
+			m_resourceLib.Get<Buffer>("cbuf.basic.ps.UserCBuf")->PSBindAsCBuf(ps->GetResBinding("UserCBuf"));
+
+			XMFLOAT4X4 viewProjection;
+			XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(m_camera.GetViewMatrix() * m_camera.GetProjectionMatrix()));
+			m_resourceLib.Get<Buffer>("cbuf.basic.vs.SystemCBuf")->SetData(&viewProjection);
+
+			auto drawLight = [&](const XMFLOAT3& position, const XMFLOAT3& diffuse)
+			{
+				XMMATRIX transformXM =
+					XMMatrixScaling(0.25f, 0.25f, 0.25f) *
+					XMMatrixTranslation(position.x, position.y, position.z);
+				XMFLOAT4X4 transform;
+				XMFLOAT4 color = { diffuse.x, diffuse.y, diffuse.z, 1.0f };
+				XMStoreFloat4x4(&transform, XMMatrixTranspose(transformXM));
+				m_resourceLib.Get<Buffer>("cbuf.basic.vs.UserCBuf")->SetData(&transform);
+				m_resourceLib.Get<Buffer>("cbuf.basic.ps.UserCBuf")->SetData(&color);
+
+				DrawCube();
+			};
+
+			// point lights
+			for (const auto& light : m_pointLights)
+				drawLight(light.position, light.diffuse);
+
+			// spot lights
+			for (const auto& light : m_spotLights)
+				drawLight(light.position, light.diffuse);
+		});
+
+	m_renderGraph->AddPass("Present",
+		[](RenderGraphBuilder& builder)
+		{
+			builder.Read("scene_color");
+			builder.Write("back_buffer");
+		},
+		[this](const RenderGraphPassResources& resources)
+		{
+			GDX11_PROFILE_GPU_SCOPE(m_gpuProfiler.get(), "Present");
 
+			auto vs = m_resourceLib.Get<VertexShader>("fullscreen");
+			auto ps = m_resourceLib.Get<PixelShader>("fullscreen");
+			vs->Bind();
+			ps->Bind();
+			m_resourceLib.Get<InputLayout>("fullscreen")->Bind();
+			resources.GetSRV("scene_color")->PSBind(ps->GetResBinding("tex"));
 
+			DrawFullscreen();
+		});
+}
 
-		// Light
-		XMMATRIX quatMatXM = XMMatrixRotationQuaternion(XMQuaternionRotationRollPitchYaw(XMConvertToRadians(50.0f), XMConvertToRadians(-30.0f), 0.0f));
-		CBuf::PS::deferred_lighting::SystemCBuf psSysCBufData;
-		psSysCBufData.dirLights[0] = dirLight;
-		std::memcpy(psSysCBufData.pointLights, pointLights, 4 * sizeof(CBuf::PS::deferred_lighting::SystemCBuf::PointLight));
-		psSysCBufData.spotLights[0] = spotLight;
-		psSysCBufData.activeDirLights = 0;
-		psSysCBufData.activePointLights = 4;
-		psSysCBufData.activeSpotLights = 1;
-		psSysCBufData.viewPosition = m_camera.GetDesc().position;
-		auto psSysCBuf = m_resourceLib.Get<Buffer>("cbuf.deferred_light.ps.SystemCBuf");
-		psSysCBuf->PSBindAsCBuf(ps->GetResBinding("SystemCBuf"));
-		psSysCBuf->SetData(&psSysCBufData);
+void DeferredRendering::BindDefaultState()
+{
+	D3D11_VIEWPORT vp = {};
+	vp.TopLeftX = 0.0f;
+	vp.TopLeftY = 0.0f;
+	vp.Width = (float)m_window->GetDesc().width;
+	vp.Height = (float)m_window->GetDesc().height;
+	vp.MinDepth = 0.0f;
+	vp.MaxDepth = 1.0f;
+	m_context->GetDeviceContext()->RSSetViewports(1, &vp);
 
+	m_resourceLib.Get<RasterizerState>("default")->Bind();
+	m_resourceLib.Get<BlendState>("default")->Bind(nullptr, 0xffffffff);
+	m_resourceLib.Get<DepthStencilState>("default")->Bind(0xff);
+}
 
+void DeferredRendering::BindGBufferPass(const RenderGraphPassResources& resources, bool depthOnly)
+{
+	resources.BindTargets();
 
-		m_resourceLib.Get<Buffer>("vb.screen")->BindAsVB();
-		auto ib = m_resourceLib.Get<Buffer>("ib.screen");
-		ib->BindAsIB(DXGI_FORMAT_R32_UINT);
-		m_context->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		GDX11_CONTEXT_THROW_INFO_ONLY(m_context->GetDeviceContext()->DrawIndexed(ib->GetDesc().ByteWidth / sizeof(uint32_t), 0, 0));
+	if (depthOnly)
+	{
+		m_resourceLib.Get<VertexShader>("depth_only")->Bind();
+		m_context->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+		m_resourceLib.Get<InputLayout>("depth_only")->Bind();
 	}
-
-	// forward render light source
+	else
 	{
-		// dont clear dsv we need to get the depth of previous pass
-		m_resourceLib.Get<RenderTargetView>("main")->Bind(m_resourceLib.Get<DepthStencilView>("main").get());
-
-		auto vs = m_resourceLib.Get<VertexShader>("basic");
-		auto ps = m_resourceLib.Get<PixelShader>("basic");
-		vs->Bind();
-		ps->Bind();
-		m_resourceLib.Get<InputLayout>("basic")->Bind();
-
-		m_resourceLib.Get<Buffer>("cbuf.basic.vs.SystemCBuf")->VSBindAsCBuf(vs->GetResBinding("SystemCBuf"));
-		m_resourceLib.Get<Buffer>("cbuf.basic.vs.UserCBuf")->VSBindAsCBuf(vs->GetResBinding("UserCBuf"));
-		m_resourceLib.Get<Buffer>("cbuf.basic.ps.UserCBuf")->PSBindAsCBuf(ps->GetResBinding("UserCBuf"));
+		m_resourceLib.Get<VertexShader>("g_buffer")->Bind();
+		m_resourceLib.Get<PixelShader>("g_buffer")->Bind();
+		m_resourceLib.Get<InputLayout>("g_buffer")->Bind();
+		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.MaterialCBuf")->PSBindAsCBuf(m_gBufferBindings.psMaterialCBuf);
+		// every material texture, draws only change the material index
+		for (uint32_t i = 0; i < (uint32_t)m_texturePacker.GetArrays().size() && i < m_texturePacker.GetDesc().maxArrays; i++)
+			m_resourceLib.Get<ShaderResourceView>("texture_array." + std::to_string(i))->PSBind(m_gBufferBindings.textureArrays + i);
+		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(m_gBufferBindings.textureSampler);
+		if (m_depthPrePass)
+			m_resourceLib.Get<DepthStencilState>("depth_equal")->Bind(0xff);
+	}
 
-		XMFLOAT4X4 viewProjection;
-		XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(m_camera.GetViewMatrix()* m_camera.GetProjectionMatrix()));
-		m_resourceLib.Get<Buffer>("cbuf.basic.vs.SystemCBuf")->SetData(&viewProjection);
+	m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.SystemCBuf")->VSBindAsCBuf(m_gBufferBindings.vsSystemCBuf);
+	m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->VSBindAsCBuf(m_gBufferBindings.vsUserCBuf);
+	m_context->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
 
+void DeferredRendering::BuildDrawList()
+{
+	GDX11_PROFILE_SCOPE("Occlusion Culling");
 
-		// point lights
-		for (int i = 0; i < 4; i++)
+	m_drawList.clear();
+	m_occlusionCuller.Begin(m_camera);
+	if (m_occlusionCulling)
+	{
+		for (const auto& object : m_sceneObjects)
 		{
-			XMMATRIX transformXM =
-				XMMatrixScaling(0.25f, 0.25f, 0.25f) *
-				XMMatrixTranslation(pointLights[i].position.x, pointLights[i].position.y, pointLights[i].position.z);
-			XMFLOAT4X4 transform;
-			XMFLOAT4 color = { pointLights[i].diffuse.x, pointLights[i].diffuse.y, pointLights[i].diffuse.z, 1.0f };
-			XMStoreFloat4x4(&transform, XMMatrixTranspose(transformXM));
-			m_resourceLib.Get<Buffer>("cbuf.basic.vs.UserCBuf")->SetData(&transform);
-			m_resourceLib.Get<Buffer>("cbuf.basic.ps.UserCBuf")->SetData(&color);
-
-			DrawCube();
+			if (!object.occluder)
+				continue;
+
+			const OcclusionMesh& mesh = m_occlusionMeshes.at(object.mesh);
+			m_occlusionCuller.AddOccluder(mesh.vertices.data(), (uint32_t)mesh.vertices.size() / 8, 8, mesh.indices.data(), (uint32_t)mesh.indices.size(), object.GetTransform());
 		}
+		m_occlusionCuller.Rasterize(m_jobSystem.get());
+	}
+
+	// occluders are tested too, one can hide behind another
+	m_estimatedOverdraw = 0.0f;
+	for (uint32_t i = 0; i < (uint32_t)m_sceneObjects.size(); i++)
+	{
+		SceneObject& object = m_sceneObjects[i];
+		const OcclusionMesh& mesh = m_occlusionMeshes.at(object.mesh);
+		const XMMATRIX transformXM = object.GetTransform();
+		if (m_occlusionCulling && !m_occlusionCuller.IsVisible(mesh.boundsMin, mesh.boundsMax, transformXM))
+			continue;
+
+		object.lod = m_lodSelector.Select(m_meshLODs.at(object.mesh), object.position, object.scale, object.lod);
+		m_estimatedOverdraw += m_occlusionCuller.GetScreenCoverage(mesh.boundsMin, mesh.boundsMax, transformXM);
+		m_drawList.push_back(i);
+	}
 
-		// spot light
-		XMMATRIX transformXM =
-			XMMatrixScaling(0.25f, 0.25f, 0.25f) *
-			XMMatrixTranslation(spotLight.position.x, spotLight.position.y, spotLight.position.z);
-		XMFLOAT4X4 transform;
-		XMFLOAT4 color = { spotLight.diffuse.x, spotLight.diffuse.y, spotLight.diffuse.z, 1.0f };
-		XMStoreFloat4x4(&transform, XMMatrixTranspose(transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.basic.vs.UserCBuf")->SetData(&transform);
-		m_resourceLib.Get<Buffer>("cbuf.basic.ps.UserCBuf")->SetData(&color);
+	// same material draws next to each other, they read the same material table entry and textures
+	std::stable_sort(m_drawList.begin(), m_drawList.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_sceneObjects[a].material < m_sceneObjects[b].material;
+	});
 
-		DrawCube();
+	switch (m_depthPrePassMode)
+	{
+	case DepthPrePassMode::Off:
+		m_depthPrePass = false;
+		break;
+	case DepthPrePassMode::On:
+		m_depthPrePass = true;
+		break;
+	case DepthPrePassMode::Auto:
+		if (!m_depthPrePass && m_estimatedOverdraw > s_depthPrePassEnableOverdraw)
+			m_depthPrePass = true;
+		else if (m_depthPrePass && m_estimatedOverdraw < s_depthPrePassDisableOverdraw)
+			m_depthPrePass = false;
+		break;
 	}
 }
 
-void DeferredRendering::OnImGuiRender()
+void DeferredRendering::UpdateShadowAtlas()
 {
+	GDX11_PROFILE_FUNCTION();
 
-}
+	// dynamic casters move every frame, where they were still has their shadow
+	m_movedCasters = m_dynamicCasterBounds;
+	m_dynamicCasterBounds.clear();
+	for (const auto& object : m_sceneObjects)
+	{
+		if (!object.dynamic)
+			continue;
 
+		const auto& chain = m_meshLODs.at(object.mesh);
+		XMFLOAT4 bounds;
+		XMStoreFloat4(&bounds, XMVector3TransformCoord(XMLoadFloat3(&chain.center), object.GetTransform()));
+		bounds.w = chain.radius * object.scale;
+		m_dynamicCasterBounds.push_back(bounds);
+	}
+	m_movedCasters.insert(m_movedCasters.end(), m_dynamicCasterBounds.begin(), m_dynamicCasterBounds.end());
 
+	// far plane at the influence radius, importance is the screen coverage
+	m_shadowLights.clear();
+	for (const auto& visible : m_lightCuller.GetPointLights())
+	{
+		ShadowLight shadowLight;
+		shadowLight.id = 2 * visible.index;
+		shadowLight.type = ShadowLightType::Point;
+		shadowLight.position = m_pointLights[visible.index].position;
+		shadowLight.range = visible.radius;
+		shadowLight.importance = visible.coverage;
+		m_shadowLights.push_back(shadowLight);
+	}
 
-void DeferredRendering::ImGuiBegin()
-{
-	ImGui_ImplDX11_NewFrame();
-	ImGui_ImplWin32_NewFrame();
-	ImGui::NewFrame();
+	for (const auto& visible : m_lightCuller.GetSpotLights())
+	{
+		ShadowLight shadowLight;
+		shadowLight.id = 2 * visible.index + 1;
+		shadowLight.type = ShadowLightType::Spot;
+		shadowLight.position = m_spotLights[visible.index].position;
+		shadowLight.direction = m_spotLights[visible.index].direction;
+		shadowLight.range = visible.radius;
+		shadowLight.outerCutOffAngleCos = m_spotLights[visible.index].outerCutOffAngleCos;
+		shadowLight.importance = visible.coverage;
+		m_shadowLights.push_back(shadowLight);
+	}
+
+	m_shadowAtlas.Update(m_shadowLights, m_movedCasters);
 }
 
-void DeferredRendering::ImGuiEnd()
+void DeferredRendering::CullShadowCasters()
 {
-	ImGuiIO& io = ImGui::GetIO();
-	io.DisplaySize = ImVec2(static_cast<float>(m_window->GetDesc().width), static_cast<float>((m_window->GetDesc().height)));
+	GDX11_PROFILE_FUNCTION();
 
-	// Rendering
-	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	m_shadowCasterBounds.clear();
+	for (const auto& object : m_sceneObjects)
+	{
+		const auto& chain = m_meshLODs.at(object.mesh);
+		XMFLOAT4 bounds;
+		XMStoreFloat4(&bounds, XMVector3TransformCoord(XMLoadFloat3(&chain.center), object.GetTransform()));
+		bounds.w = chain.radius * object.scale;
+		m_shadowCasterBounds.push_back(bounds);
+	}
 
-	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+	const uint32_t cascadeCount = m_shadowCascades.GetCascadeCount();
+	const auto& renderViews = m_shadowAtlas.GetRenderViews();
+	const uint32_t viewCount = cascadeCount + (uint32_t)renderViews.size();
+	const uint32_t objectCount = (uint32_t)m_sceneObjects.size();
+	const uint32_t setCount = (viewCount + ViewSet::s_maxViewCount - 1) / ViewSet::s_maxViewCount;
+	m_shadowCasterMasks.resize((size_t)setCount * objectCount);
+	for (uint32_t set = 0; set < setCount; set++)
 	{
-		ImGui::UpdatePlatformWindows();
-		ImGui::RenderPlatformWindowsDefault();
+		const uint32_t first = set * ViewSet::s_maxViewCount;
+		const uint32_t count = std::min(viewCount - first, ViewSet::s_maxViewCount);
+		m_shadowViews.SetViewCount(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t view = first + i;
+			if (view < cascadeCount)
+			{
+				// casters in front of the box still cast, the shadow rasterizer state clamps them onto its near plane
+				m_shadowViews.SetViewProjection(i, XMLoadFloat4x4(&m_shadowCascades.GetCascade(view).viewProjection));
+				m_shadowViews.SetNearPlaneCulling(i, false);
+			}
+			else
+			{
+				m_shadowViews.SetViewProjection(i, XMLoadFloat4x4(&m_shadowAtlas.GetViews()[renderViews[view - cascadeCount]].viewProjection));
+				m_shadowViews.SetNearPlaneCulling(i, true);
+			}
+		}
+		m_shadowViews.Cull(m_shadowCasterBounds.data(), objectCount, &m_shadowCasterMasks[(size_t)set * objectCount]);
 	}
 }
 
-void DeferredRendering::DrawScene()
+void DeferredRendering::RecordGBufferPass(const RenderGraphPassResources& resources, bool depthOnly)
 {
-	std::shared_ptr<VertexShader> vs = m_resourceLib.Get<VertexShader>("g_buffer");
-	std::shared_ptr<PixelShader> ps = m_resourceLib.Get<PixelShader>("g_buffer");
+	const uint32_t threadCount = std::max(1u, std::min(m_recordingThreads, (uint32_t)m_drawList.size()));
+	if (m_recorders.size() < threadCount)
+		m_recorders.resize(threadCount);
 
-	// plane 0
+	for (uint32_t i = 0; i < threadCount; i++)
 	{
-		XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(0.0f, 0.0f, 0.0f);
-		XMMATRIX transformXM =
-			XMMatrixScaling(25.0f, 25.0f, 25.0f) *
-			XMMatrixRotationQuaternion(rotQuatXM) *
-			XMMatrixTranslation(0.0f, -0.5f, 0.0f);
-
-		XMFLOAT4X4 transformNormalMatrix[2];
-		XMStoreFloat4x4(&transformNormalMatrix[0], XMMatrixTranspose(transformXM));
-		XMStoreFloat4x4(&transformNormalMatrix[1], XMMatrixInverse(nullptr, transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->SetData(transformNormalMatrix);
-
-		XMFLOAT4 material[2];
-		material[0] = { 1.0f, 1.0f, 1.0f, 1.0f }; // diffuseCol
-		material[1] = { 10.0f, 10.0f, 120.0f, 0.0f }; // tiling.xy / shininess.z / padding.w
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->SetData(material);
-
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("diffuseMap"));
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("specularMap"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("diffuseMapSampler"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("specularMapSampler"));
-
-		DrawPlane();
+		m_recorders[i].culler = m_meshletCuller;
+		m_recorders[i].culler.ResetStats();
 	}
 
-
-
-
-	//  cube 0
+	if (threadCount == 1)
 	{
-		XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(0.0f, 0.0f, 0.0f);
-		XMMATRIX transformXM =
-			XMMatrixScaling(1.0f, 1.0f, 1.0f) *
-			XMMatrixRotationQuaternion(rotQuatXM) *
-			XMMatrixTranslation(0.0f, 1.5f, 0.0f);
-
-		XMFLOAT4X4 transformNormalMatrix[2];
-		XMStoreFloat4x4(&transformNormalMatrix[0], XMMatrixTranspose(transformXM));
-		XMStoreFloat4x4(&transformNormalMatrix[1], XMMatrixInverse(nullptr, transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->SetData(transformNormalMatrix);
-
-		XMFLOAT4 material[2];
-		material[0] = { 1.0f, 1.0f, 1.0f, 1.0f }; // diffuseCol
-		material[1] = { 1.0f, 1.0f, 32.0f, 0.0f }; // tiling.xy / shininess.z / padding.w
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->SetData(material);
-
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("diffuseMap"));
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("specularMap"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("diffuseMapSampler"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("specularMapSampler"));
-
-		DrawCube();
+		BindDefaultState();
+		BindGBufferPass(resources, depthOnly);
+		DrawScene(m_recorders[0], 0, m_drawList.size(), depthOnly);
 	}
-
-
-
-	// cube 1 
+	else
 	{
-		XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(0.0f, 0.0f, 0.0f);
-		XMMATRIX transformXM =
-			XMMatrixScaling(1.0f, 1.0f, 1.0f) *
-			XMMatrixRotationQuaternion(rotQuatXM) *
-			XMMatrixTranslation(2.0f, 0.0f, -1.0f);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			if (!m_recorders[i].context)
+				m_recorders[i].context = DeferredContext::Create(m_context.get());
+		}
 
-		XMFLOAT4X4 transformNormalMatrix[2];
-		XMStoreFloat4x4(&transformNormalMatrix[0], XMMatrixTranspose(transformXM));
-		XMStoreFloat4x4(&transformNormalMatrix[1], XMMatrixInverse(nullptr, transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->SetData(transformNormalMatrix);
+		const size_t objectCount = m_drawList.size();
+		std::vector<std::exception_ptr> errors(threadCount);
+		JobCounter counter;
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_jobSystem->Run([this, i, threadCount, objectCount, depthOnly, &errors, &resources]()
+			{
+				try
+				{
+					GDX11_PROFILE_SCOPE("Record G-Buffer");
+					SceneRecorder& recorder = m_recorders[i];
+					recorder.context->Begin();
+					BindDefaultState();
+					BindGBufferPass(resources, depthOnly);
+					DrawScene(recorder, objectCount * i / threadCount, objectCount * (i + 1) / threadCount, depthOnly);
+					recorder.context->End();
+				}
+				catch (...)
+				{
+					m_recorders[i].context->Abandon();
+					errors[i] = std::current_exception();
+				}
+			}, &counter);
+		}
 
-		XMFLOAT4 material[2];
-		material[0] = { 1.0f, 1.0f, 1.0f, 1.0f }; // diffuseCol
-		material[1] = { 1.0f, 1.0f, 32.0f, 0.0f }; // tiling.xy / shininess.z / padding.w
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->SetData(material);
+		m_jobSystem->Wait(counter);
+		for (const auto& error : errors)
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
 
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("diffuseMap"));
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("specularMap"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("diffuseMapSampler"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("specularMapSampler"));
+		// draw list order
+		{
+			GDX11_PROFILE_SCOPE("Execute G-Buffer");
+			for (uint32_t i = 0; i < threadCount; i++)
+				m_recorders[i].context->Execute();
+		}
 
-		DrawCube();
+		// executing a command list resets the immediate context
+		BindDefaultState();
 	}
 
+	// the pre-pass culls the same meshlets again
+	if (!depthOnly)
+	{
+		for (uint32_t i = 0; i < threadCount; i++)
+			m_meshletCuller.AddStats(m_recorders[i].culler.GetStats());
+	}
+}
 
+void DeferredRendering::DrawScene(SceneRecorder& recorder, size_t first, size_t last, bool depthOnly)
+{
+	auto vsUserCBuf = m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf");
 
-	// cube 2 
+	for (size_t i = first; i < last; i++)
 	{
-		XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(XMConvertToRadians(60.0f), XMConvertToRadians(60.0f), XMConvertToRadians(60.0f));
-		XMMATRIX transformXM =
-			XMMatrixScaling(0.5f, 0.5f, 0.5f) *
-			XMMatrixRotationQuaternion(rotQuatXM) *
-			XMMatrixTranslation(-1.0f, 0.0f, -2.0f);
-
-		XMFLOAT4X4 transformNormalMatrix[2];
-		XMStoreFloat4x4(&transformNormalMatrix[0], XMMatrixTranspose(transformXM));
-		XMStoreFloat4x4(&transformNormalMatrix[1], XMMatrixInverse(nullptr, transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->SetData(transformNormalMatrix);
+		const SceneObject& object = m_sceneObjects[m_drawList[i]];
+		const auto& chain = m_meshLODs.at(object.mesh);
 
-		XMFLOAT4 material[2];
-		material[0] = { 1.0f, 1.0f, 1.0f, 1.0f }; // diffuseCol
-		material[1] = { 1.0f, 1.0f, 32.0f, 0.0f }; // tiling.xy / shininess.z / padding.w
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->SetData(material);
+		XMMATRIX transformXM = object.GetTransform();
+		recorder.drawRanges.clear();
+		recorder.culler.Cull(m_meshlets.at(object.mesh)[object.lod], transformXM, chain.levels[object.lod].indexOffset, recorder.drawRanges);
+		if (recorder.drawRanges.empty())
+			continue;
 
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("diffuseMap"));
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("specularMap"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("diffuseMapSampler"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("specularMapSampler"));
+		// the material is only an index here, its constants and texture locations are in the material table
+		CBuf::VS::g_buffer::UserCBuf vsUserCBufData;
+		XMStoreFloat4x4(&vsUserCBufData.transform, XMMatrixTranspose(transformXM));
+		XMStoreFloat4x4(&vsUserCBufData.normalMatrix, XMMatrixInverse(nullptr, transformXM));
+		vsUserCBufData.materialIndex = object.material;
+		vsUserCBuf->SetData(&vsUserCBufData);
 
-		DrawCube();
+		DrawRanges(m_meshBuffers.at(object.mesh), recorder.drawRanges.data(), recorder.drawRanges.size());
 	}
+}
 
+void DeferredRendering::DrawShadowCasters(bool drawStatic, bool drawDynamic, uint32_t shadowView)
+{
+	auto vsUserCBuf = m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf");
 
-	// cube 3
+	// every object, the ones hidden from the camera still cast
+	const uint64_t* masks = &m_shadowCasterMasks[(size_t)(shadowView / ViewSet::s_maxViewCount) * m_sceneObjects.size()];
+	const uint64_t viewBit = 1ull << (shadowView % ViewSet::s_maxViewCount);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
 	{
-		XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(0.0f, 0.0f, 0.0f);
-		XMMATRIX transformXM =
-			XMMatrixScaling(0.25f, 0.25f, 0.25f) *
-			XMMatrixRotationQuaternion(rotQuatXM) *
-			XMMatrixTranslation(1.5f, 4.0f, -2.0f);
-
-		XMFLOAT4X4 transformNormalMatrix[2];
-		XMStoreFloat4x4(&transformNormalMatrix[0], XMMatrixTranspose(transformXM));
-		XMStoreFloat4x4(&transformNormalMatrix[1], XMMatrixInverse(nullptr, transformXM));
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.vs.UserCBuf")->SetData(transformNormalMatrix);
-
-		XMFLOAT4 material[2];
-		material[0] = { 1.0f, 1.0f, 1.0f, 1.0f }; // diffuseCol
-		material[1] = { 1.0f, 1.0f, 32.0f, 0.0f }; // tiling.xy / shininess.z / padding.w
-		m_resourceLib.Get<Buffer>("cbuf.g_buffer.ps.UserCBuf")->SetData(material);
-
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("diffuseMap"));
-		m_resourceLib.Get<ShaderResourceView>("basketball_court")->PSBind(ps->GetResBinding("specularMap"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("diffuseMapSampler"));
-		m_resourceLib.Get<SamplerState>("anisotropic_wrap")->PSBind(ps->GetResBinding("specularMapSampler"));
+		const auto& object = m_sceneObjects[i];
+		if (object.dynamic ? !drawDynamic : !drawStatic)
+			continue;
+		if (!(masks[i] & viewBit))
+			continue;
 
-		DrawCube();
+		const auto& chain = m_meshLODs.at(object.mesh);
+		const XMMATRIX transformXM = object.GetTransform();
+		CBuf::VS::g_buffer::UserCBuf vsUserCBufData;
+		XMStoreFloat4x4(&vsUserCBufData.transform, XMMatrixTranspose(transformXM));
+		XMStoreFloat4x4(&vsUserCBufData.normalMatrix, XMMatrixInverse(nullptr, transformXM));
+		vsUserCBuf->SetData(&vsUserCBufData);
+
+		const auto& level = chain.levels[object.lod];
+		const MeshletDrawRange range = { level.indexOffset, level.indexCount };
+		DrawRanges(m_meshBuffers.at(object.mesh), &range, 1);
+		m_shadowCasterDrawCount++;
 	}
 }
 
-void DeferredRendering::DrawCube()
+void DeferredRendering::DrawFullscreen()
 {
-	m_resourceLib.Get<Buffer>("vb.cube")->BindAsVB();
-	auto ib = m_resourceLib.Get<Buffer>("ib.cube");;
+	m_resourceLib.Get<Buffer>("vb.screen")->BindAsVB();
+	auto ib = m_resourceLib.Get<Buffer>("ib.screen");
 	ib->BindAsIB(DXGI_FORMAT_R32_UINT);
 	m_context->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	GDX11_CONTEXT_THROW_INFO_ONLY(m_context->GetDeviceContext()->DrawIndexed(ib->GetDesc().ByteWidth / sizeof(uint32_t), 0, 0));
+	RenderCounters::CountDraw(ib->GetDesc().ByteWidth / sizeof(uint32_t));
 }
 
-void DeferredRendering::DrawPlane()
+void DeferredRendering::DrawCube(uint32_t lod)
 {
-	m_resourceLib.Get<Buffer>("vb.plane")->BindAsVB();
-	auto ib = m_resourceLib.Get<Buffer>("ib.plane");;
-	ib->BindAsIB(DXGI_FORMAT_R32_UINT);
+	const auto& level = m_meshLODs.at("cube").levels.at(lod);
+	const MeshletDrawRange range = { level.indexOffset, level.indexCount };
+	DrawRanges(m_meshBuffers.at("cube"), &range, 1);
+}
+
+void DeferredRendering::DrawPlane(uint32_t lod)
+{
+	const auto& level = m_meshLODs.at("plane").levels.at(lod);
+	const MeshletDrawRange range = { level.indexOffset, level.indexCount };
+	DrawRanges(m_meshBuffers.at("plane"), &range, 1);
+}
+
+void DeferredRendering::DrawRanges(const MeshBuffers& mesh, const MeshletDrawRange* ranges, size_t rangeCount)
+{
+	mesh.vertexBuffer->BindAsVB();
+	mesh.indexBuffer->BindAsIB(DXGI_FORMAT_R32_UINT);
 	m_context->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	GDX11_CONTEXT_THROW_INFO_ONLY(m_context->GetDeviceContext()->DrawIndexed(ib->GetDesc().ByteWidth / sizeof(uint32_t), 0, 0));
+	for (size_t i = 0; i < rangeCount; i++)
+	{
+		GDX11_CONTEXT_THROW_INFO_ONLY(m_context->GetDeviceContext()->DrawIndexed(ranges[i].indexCount, ranges[i].indexOffset, 0));
+		RenderCounters::CountDraw(ranges[i].indexCount);
+	}
 }
 
 bool DeferredRendering::OnWindowResizedEvent(GDX11::WindowResizeEvent& e)
 {
 	m_resize = true;
+	m_resizeTime = m_resizeClock.Now();
 	return false;
 }
 
 void DeferredRendering::ResizeResources(uint32_t width, uint32_t height)
 {
+	GDX11_PROFILE_FUNCTION();
 
 	D3D11_VIEWPORT vp = {};
 	vp.TopLeftX = 0.0f;
@@ -875,14 +2037,14 @@ void DeferredRendering::ResizeResources(uint32_t width, uint32_t height)
 	m_context->GetDeviceContext()->RSSetViewports(1, &vp);
 
 
+	// nothing may hold the back buffer while the swap chain resizes
+	m_context->GetDeviceContext()->OMSetRenderTargets(0, nullptr, nullptr);
+	m_renderGraph->ReleaseImports();
 	m_resourceLib.Remove<RenderTargetView>("main");
-	m_resourceLib.Remove<DepthStencilView>("main");
 
+	m_framePacer->ResizeBuffers(width, height);
 
-	HRESULT hr;
-	GDX11_CONTEXT_THROW_INFO(m_context->GetSwapChain()->ResizeBuffers(1, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0));
-	ComPtr<ID3D11Texture2D> backBuffer = nullptr;
-	GDX11_CONTEXT_THROW_INFO(m_context->GetSwapChain()->GetBuffer(0, __uuidof(ID3D11Resource), &backBuffer));
+	ComPtr<ID3D11Texture2D> backBuffer = m_context->GetBackBuffer();
 
 	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
 	rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -890,90 +2052,9 @@ void DeferredRendering::ResizeResources(uint32_t width, uint32_t height)
 	rtvDesc.Texture2D.MipSlice = 0;
 	m_resourceLib.Add("main", RenderTargetView::Create(m_context.get(), rtvDesc, Texture2D::Create(m_context.get(), backBuffer.Get())));
 
-
-	D3D11_TEXTURE2D_DESC dsvTexDesc = {};
-	dsvTexDesc.Width = width;
-	dsvTexDesc.Height = height;
-	dsvTexDesc.MipLevels = 1;
-	dsvTexDesc.ArraySize = 1;
-	dsvTexDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	dsvTexDesc.SampleDesc.Count = 1;
-	dsvTexDesc.SampleDesc.Quality = 0;
-	dsvTexDesc.Usage = D3D11_USAGE_DEFAULT;
-	dsvTexDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	dsvTexDesc.CPUAccessFlags = 0;
-	dsvTexDesc.MiscFlags = 0;
-
-	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-	dsvDesc.Format = dsvTexDesc.Format;
-	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	dsvDesc.Texture2D.MipSlice = 0;
-	m_resourceLib.Add("main", DepthStencilView::Create(m_context.get(), dsvDesc, Texture2D::Create(m_context.get(), dsvTexDesc, (void*)nullptr)));
-
-
-
-
-
-
-
-	// G-Buffer
-	{
-		m_resourceLib.Remove<RenderTargetViewArray>("g_buffer");
-		for (int i = 0; i < 5; i++)
-			m_resourceLib.Remove<ShaderResourceView>("g_bufferTextureView" + std::to_string(i));
-
-		std::shared_ptr<RenderTargetViewArray> rtva = std::make_shared<RenderTargetViewArray>();
-		// 0 = pos
-		// 1 = normal 
-		// 2 = diffuse
-		// 3 = specular
-		// 4 = shininess
-		for (int i = 0; i < 5; i++)
-		{
-			D3D11_TEXTURE2D_DESC texDesc = {};
-			texDesc.Width = width;
-			texDesc.Height = height;
-			texDesc.MipLevels = 1;
-			texDesc.ArraySize = 1;
-
-			if (i < 2)
-				texDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-			else if (i < 4)
-				texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			else
-				texDesc.Format = DXGI_FORMAT_R32_FLOAT;
-
-			texDesc.SampleDesc.Count = 1;
-			texDesc.SampleDesc.Quality = 0;
-			texDesc.Usage = D3D11_USAGE_DEFAULT;
-			texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-			texDesc.CPUAccessFlags = 0;
-			texDesc.MiscFlags = 0;
-
-			D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-			rtvDesc.Format = texDesc.Format;
-			rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-			rtvDesc.Texture2D.MipSlice = 0;
-
-			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-			srvDesc.Format = texDesc.Format;
-			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			srvDesc.Texture2D.MostDetailedMip = 0;
-			srvDesc.Texture2D.MipLevels = 1;
-
-			auto texture = Texture2D::Create(m_context.get(), texDesc, (void*)nullptr);
-			rtva->push_back(RenderTargetView::Create(m_context.get(), rtvDesc, texture));
-			m_resourceLib.Add("g_bufferTextureView" + std::to_string(i), ShaderResourceView::Create(m_context.get(), srvDesc, texture));
-		}
-
-		m_resourceLib.Add("g_buffer", rtva);
-	}
-
-
-
-
-
-
+	m_renderGraph->ImportRenderTarget("back_buffer", m_resourceLib.Get<RenderTargetView>("main"));
+	m_renderGraph->SetBackBufferSize(width, height);
 
 	m_camera.SetAspect((float)m_window->GetDesc().width / (float)m_window->GetDesc().height);
+	m_lodSelector.SetViewportSize((float)width, (float)height);
 }
@@ -2,15 +2,52 @@
 
 #include <GDX11.h>
 #include "Utils/ResourceLibrary.h"
+#include "Utils/CBufs.h"
 #include "Utils/Camera.h"
 #include "Utils/CameraController.h"
+#include "Utils/LightCuller.h"
+#include "Utils/LODSelector.h"
+#include "Utils/MaterialTable.h"
+#include "Utils/MeshletCuller.h"
+#include "Utils/OcclusionCuller.h"
+#include "Utils/Scene.h"
+#include "Utils/SceneBenchmark.h"
+#include "Utils/ShadowAtlas.h"
+#include "Utils/ShadowCascades.h"
+#include "Utils/TexturePacker.h"
+#include "Utils/ViewSet.h"
 
 
+struct DeferredRenderingDesc
+{
+	// no window, swap chain or imgui. frames go to the context's offscreen swap chain
+	bool headless = false;
+	// headless, the run ends after this many frames, 0 leaves it to the input script
+	uint32_t frameCount = 0;
+	// headless, HeadlessWindow::ParseInputScript's format
+	std::string inputScript;
+	// headless, frame_<n>.bmp per frame when not empty
+	std::string outputDirectory;
+	// headless, the cpu rasteriser instead of the gpu
+	bool warp = false;
+	// generated scene and camera path instead of the hand built scene, frame timings written to benchmarkOutput.
+	// vsync and the frame limiter are off and the run ends after the recorded frames
+	bool benchmark = false;
+	DRUtils::SceneBenchmark::Desc benchmarkDesc;
+	std::string benchmarkOutput = "benchmark.json";
+	// Run logs DRUtils::MicroBenchmark's cases and returns without rendering
+	bool microBenchmark = false;
+	// MB of every category together, 0 is no budget. going over trims the render target pool
+	uint64_t memoryBudget = 0;
+	// GDX11::MemoryTracker::WriteJSON's report at the end of the run when not empty
+	std::string memoryReport;
+};
+
 class DeferredRendering
 {
 public:
-	DeferredRendering();
-	~DeferredRendering() = default;
+	DeferredRendering(const DeferredRenderingDesc& desc = DeferredRenderingDesc());
+	~DeferredRendering();
 
 	void Run();
 
@@ -18,8 +55,11 @@ private:
 	void SetResources();
 	void SetShaders();
 	void SetBuffers();
+	// material textures packed into m_texturePacker's arrays, "texture_array.i"
 	void SetLoadedTexture();
 	void SetSamplers();
+	// depth array with a slice per cascade, the static caster cache of the cached ones and the point and spot light atlas
+	void SetShadowMaps();
 
 	void SetImGui();
 	void OnEvent(GDX11::Event& event);
@@ -30,18 +70,166 @@ private:
 	void ImGuiBegin();
 	void ImGuiEnd();
 
-	void DrawScene();
-	void DrawCube();
-	void DrawPlane();
+	// per recording thread scratch, [0] also serves the single threaded path
+	struct SceneRecorder
+	{
+		std::shared_ptr<GDX11::DeferredContext> context;
+		DRUtils::MeshletCuller culler;
+		std::vector<DRUtils::MeshletDrawRange> drawRanges;
+	};
+
+	void SetScene();
+	// benchmark mode, the generated scene's lights and the camera to frame m_benchmarkFrame
+	void UpdateBenchmark();
+	// benchmark mode, once the frame is presented
+	void RecordBenchmarkFrame(uint64_t frameBegin);
+	// occluders into the cpu depth buffer, objects it doesn't hide go to m_drawList sorted by material.
+	// also selects lods and decides on the depth pre-pass, both passes have to draw the same geometry
+	void BuildDrawList();
+	// point and spot light shadow views to render this frame, for the lights the light culler kept
+	void UpdateShadowAtlas();
+	// every caster against every shadow view this frame, once. view i is cascade i, then the atlas render views in order
+	void CullShadowCasters();
+	// passes and the textures they use, the g-buffer and depth are created and resized by the graph
+	void SetRenderGraph();
+	void BindDefaultState();
+	// depthOnly is the pre-pass, position only and no pixel shader
+	void BindGBufferPass(const GDX11::RenderGraphPassResources& resources, bool depthOnly);
+	// splits the draw list across m_recordingThreads deferred contexts recorded as jobs, executed in draw list order
+	void RecordGBufferPass(const GDX11::RenderGraphPassResources& resources, bool depthOnly);
+	// [first, last) of the draw list
+	void DrawScene(SceneRecorder& recorder, size_t first, size_t last, bool depthOnly);
+	// depth_only shader and the shadow view projection bound. shadowView is a CullShadowCasters view
+	void DrawShadowCasters(bool drawStatic, bool drawDynamic, uint32_t shadowView);
+	// screen quad, vb./ib.screen
+	void DrawFullscreen();
+	void DrawCube(uint32_t lod = 0);
+	void DrawPlane(uint32_t lod = 0);
+	struct MeshBuffers;
+	void DrawRanges(const MeshBuffers& mesh, const DRUtils::MeshletDrawRange* ranges, size_t rangeCount);
+
+	// ms, what the dynamic resolution controller is fed
+	float GetGPUFrameTime() const;
 
 	bool OnWindowResizedEvent(GDX11::WindowResizeEvent& e);
 	void ResizeResources(uint32_t width, uint32_t height);
 
 	bool m_resize = false;
+	uint64_t m_resizeTime = 0;
+	GDX11::SystemClock m_resizeClock;
+	// ns the window size has to stay the same before the swap chain and targets are resized
+	static constexpr uint64_t s_resizeDelay = 100'000'000;
 
+	DeferredRenderingDesc m_desc;
+	// before the window, which posts into it until it's destroyed
+	GDX11::EventQueue m_eventQueue;
 	std::unique_ptr<GDX11::Window> m_window;
 	std::unique_ptr<GDX11::GDX11Context> m_context;
+	std::shared_ptr<GDX11::GPUProfiler> m_gpuProfiler;
+	std::shared_ptr<GDX11::FramePacer> m_framePacer;
+	std::shared_ptr<GDX11::RenderTargetPool> m_renderTargetPool;
+	std::unique_ptr<GDX11::JobSystem> m_jobSystem;
+	GDX11::MemoryTracker::CallbackID m_memoryBudgetCallback;
+	std::shared_ptr<GDX11::RenderGraph> m_renderGraph;
 	DRUtils::ResourceLibrary m_resourceLib;
 	DRUtils::Camera m_camera;
 	DRUtils::CameraController m_cameraController;
+	DRUtils::LODSelector m_lodSelector;
+	DRUtils::MeshletCuller m_meshletCuller;
+	DRUtils::OcclusionCuller m_occlusionCuller;
+	bool m_occlusionCulling = true;
+
+	// lod chains share the mesh vertex buffer, key matches the vb./ib. resource name
+	std::unordered_map<std::string, DRUtils::MeshSimplifier::LODChain> m_meshLODs;
+
+	// vb./ib. resources of a mesh, looked up once when they're created instead of per draw
+	struct MeshBuffers
+	{
+		std::shared_ptr<GDX11::Buffer> vertexBuffer;
+		std::shared_ptr<GDX11::Buffer> indexBuffer;
+	};
+	std::unordered_map<std::string, MeshBuffers> m_meshBuffers;
+
+	// one meshlet set per lod level
+	std::unordered_map<std::string, std::vector<DRUtils::Meshlets::MeshletMesh>> m_meshlets;
+
+	// cpu copy of lod 0 for the occlusion culler, key matches the vb./ib. resource name
+	struct OcclusionMesh
+	{
+		std::vector<float> vertices; // position, uv, normal
+		std::vector<uint32_t> indices;
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+	};
+	std::unordered_map<std::string, OcclusionMesh> m_occlusionMeshes;
+
+	DRUtils::MaterialTable m_materials;
+	DRUtils::TexturePacker m_texturePacker;
+
+	std::vector<DRUtils::SceneObject> m_sceneObjects;
+	std::vector<uint32_t> m_drawList; // indices into m_sceneObjects
+
+	enum class DepthPrePassMode
+	{
+		Off, On, Auto
+	};
+	DepthPrePassMode m_depthPrePassMode = DepthPrePassMode::Auto;
+	bool m_depthPrePass = false; // this frame
+	// summed screen coverage of the draw list's bounds, 1 = every pixel shaded once
+	float m_estimatedOverdraw = 0.0f;
+	// auto mode hysteresis. the pre-pass adds a position only geometry pass and 4 bytes/pixel of depth,
+	// every g-buffer layer it removes saves 42 bytes/pixel and a pixel shader run. box bounds overestimate coverage
+	static constexpr float s_depthPrePassEnableOverdraw = 1.5f;
+	static constexpr float s_depthPrePassDisableOverdraw = 1.25f;
+
+	// dirLights[0]
+	DRUtils::ShadowCascades m_shadowCascades;
+	uint32_t m_shadowCasterDrawCount = 0; // this frame, cascades and atlas
+
+	// lights that can't reach the screen aren't uploaded or shadowed
+	DRUtils::LightCuller m_lightCuller;
+	uint32_t m_lightingVariant = 0; // deferred_light keyword mask, last frame
+
+	// visible point lights first, then spot lights. ids are 2 * index for point lights and 2 * index + 1 for spot lights
+	DRUtils::ShadowAtlas m_shadowAtlas;
+	std::vector<DRUtils::ShadowLight> m_shadowLights;
+	// dynamic caster spheres, last frame's and this frame's
+	std::vector<DirectX::XMFLOAT4> m_dynamicCasterBounds;
+	std::vector<DirectX::XMFLOAT4> m_movedCasters;
+
+	// culls the shadow views s_maxViewCount at a time
+	DRUtils::ViewSet m_shadowViews;
+	std::vector<DirectX::XMFLOAT4> m_shadowCasterBounds; // m_sceneObjects order
+	// view masks, m_sceneObjects.size() per ViewSet::s_maxViewCount shadow views
+	std::vector<uint64_t> m_shadowCasterMasks;
+
+	CBuf::PS::deferred_lighting::SystemCBuf::DirectionalLight m_dirLight;
+	std::vector<CBuf::PS::deferred_lighting::SystemCBuf::PointLight> m_pointLights;
+	std::vector<CBuf::PS::deferred_lighting::SystemCBuf::SpotLight> m_spotLights;
+	std::vector<SceneRecorder> m_recorders;
+	uint32_t m_recordingThreads = 1;
+
+	DRUtils::SceneBenchmark::Scene m_benchmarkScene;
+	uint64_t m_benchmarkFrame = 0; // warmup included
+	std::vector<DRUtils::SceneBenchmark::FrameSample> m_benchmarkSamples;
+	uint64_t m_benchmarkGPUFrameID = 0; // GPUProfiler::GetFrameID of the last gpu time recorded
+
+	GDX11::DynamicResolution m_dynamicResolution;
+	bool m_dynamicResolutionEnabled = true;
+	uint64_t m_dynamicResolutionGPUFrameID = 0; // GPUProfiler::GetFrameID of the last gpu time fed to it
+
+	struct GBufferBindings
+	{
+		uint32_t vsSystemCBuf, vsUserCBuf, psMaterialCBuf;
+		uint32_t textureArrays, textureSampler;
+	} m_gBufferBindings = {};
+
+	// deferred_light's cbuffers, resolved against its reflection at load
+	struct LightingParameters
+	{
+		GDX11::ParameterBlock::VariableID dirLights, pointLights, spotLights, viewPosition;
+		GDX11::ParameterBlock::VariableID activeDirLights, activePointLights, activeSpotLights;
+		GDX11::ParameterBlock::VariableID cascadeViewProjections, cascadeSplits, cascadeTexelSizes, viewDirection, cascadeCount;
+		GDX11::ParameterBlock::VariableID atlasViews;
+	} m_lightingParameters = {};
 };
\ No newline at end of file
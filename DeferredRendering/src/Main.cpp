@@ -2,24 +2,119 @@
 
 #include "DeferredRendering.h"
 
-int main()
+#include <iostream>
+
+// --headless [frames] [--input script.txt] [--output dir] [--warp]
+// --micro-benchmark
+// --memory-budget MB --memory-report memory.json
+// --benchmark [frames] [--objects n] [--point-lights n] [--spot-lights n] [--layout grid|random] [--seed n] [--json results.json]
+static DeferredRenderingDesc ParseArgs(int argc, char** argv)
+{
+	DeferredRenderingDesc desc;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+		if (arg == "--headless")
+		{
+			desc.headless = true;
+			if (hasValue)
+				desc.frameCount = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--input" && hasValue)
+		{
+			desc.inputScript = argv[++i];
+		}
+		else if (arg == "--output" && hasValue)
+		{
+			desc.outputDirectory = argv[++i];
+		}
+		else if (arg == "--warp")
+		{
+			desc.warp = true;
+		}
+		else if (arg == "--benchmark")
+		{
+			desc.benchmark = true;
+			if (hasValue)
+				desc.benchmarkDesc.frameCount = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--objects" && hasValue)
+		{
+			desc.benchmarkDesc.objectCount = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--point-lights" && hasValue)
+		{
+			desc.benchmarkDesc.pointLightCount = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--spot-lights" && hasValue)
+		{
+			desc.benchmarkDesc.spotLightCount = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--layout" && hasValue)
+		{
+			desc.benchmarkDesc.layout = std::string(argv[++i]) == "random" ? DRUtils::SceneBenchmark::Layout::Random : DRUtils::SceneBenchmark::Layout::Grid;
+		}
+		else if (arg == "--seed" && hasValue)
+		{
+			desc.benchmarkDesc.seed = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (arg == "--json" && hasValue)
+		{
+			desc.benchmarkOutput = argv[++i];
+		}
+		else if (arg == "--micro-benchmark")
+		{
+			desc.microBenchmark = true;
+		}
+		else if (arg == "--memory-budget" && hasValue)
+		{
+			desc.memoryBudget = std::stoull(argv[++i]);
+		}
+		else if (arg == "--memory-report" && hasValue)
+		{
+			desc.memoryReport = argv[++i];
+		}
+	}
+
+	return desc;
+}
+
+// no desktop to show a message box on when headless, or outside windows
+static void ReportError(bool headless, const char* what, const char* type)
+{
+#ifdef _WIN32
+	if (!headless)
+	{
+		MessageBoxA(nullptr, what, type, MB_OK | MB_ICONERROR);
+		return;
+	}
+#endif // _WIN32
+	std::cerr << type << '\n' << what << std::endl;
+}
+
+int main(int argc, char** argv)
 {
+	const DeferredRenderingDesc desc = ParseArgs(argc, argv);
 	try
 	{
-		DeferredRendering().Run();
+		DeferredRendering(desc).Run();
 	}
 	catch (const GDX11::GDX11Exception& e)
 	{
-		MessageBoxA(nullptr, e.what(), e.GetType(), MB_OK | MB_ICONERROR);
+		ReportError(desc.headless, e.what(), e.GetType());
+		return 1;
 	}
 	catch (const std::exception& e)
 	{
-		MessageBoxA(nullptr, e.what(), "Standard Exception", MB_OK | MB_ICONERROR);
+		ReportError(desc.headless, e.what(), "Standard Exception");
+		return 1;
 	}
 	catch (...)
 	{
-		MessageBoxA(nullptr, "No details available", "Unknown Exception", MB_OK | MB_ICONERROR);
+		ReportError(desc.headless, "No details available", "Unknown Exception");
+		return 1;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
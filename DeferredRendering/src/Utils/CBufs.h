@@ -7,7 +7,9 @@ namespace CBuf
 	{
 		static constexpr uint32_t s_lightMaxCount = 32;
 
-		struct SystemCBuf
+		// the cbuffers are ParameterBlocks laid out from the shader's reflection, these are the element types of its
+		// arrays. GetVariableID checks their sizes against the shader at load
+		namespace SystemCBuf
 		{
 			struct DirectionalLight
 			{
@@ -19,12 +21,7 @@ namespace CBuf
 				float p2;
 				DirectX::XMFLOAT3 specular = { 1.0f, 1.0f, 1.0f };
 				float p3;
-
-
-				// for shadow calculation
-				//DirectX::XMFLOAT4X4 viewProjMatrix;
-
-			} dirLights[s_lightMaxCount];
+			};
 
 			struct PointLight
 			{
@@ -35,17 +32,8 @@ namespace CBuf
 				DirectX::XMFLOAT3 diffuse = { 0.8f, 0.8f, 0.8f };
 				float quadratic = 0.0007f;
 				DirectX::XMFLOAT3 specular = { 1.0f, 1.0f, 1.0f };
-				float p0;
-
-
-				// for shadow calculation
-				//float farPlane;
-				//float nearPlane;
-				//float p1;
-				//float p2;
-				//DirectX::XMFLOAT4X4 viewMatrix;
-
-			} pointLights[s_lightMaxCount];
+				int32_t shadowIndex = -1; // first of its 6 atlas views, -1 without shadow
+			};
 
 			struct SpotLight
 			{
@@ -57,23 +45,72 @@ namespace CBuf
 				DirectX::XMFLOAT3 ambient = { 0.2f, 0.2f, 0.2f };
 				float quadratic = 0.0007f;
 				DirectX::XMFLOAT3 diffuse = { 0.8f, 0.8f, 0.8f };
-				float innerCutOffAngleCos = cosf(10.0f);
+				float innerCutOffAngleCos = cosf(DirectX::XMConvertToRadians(10.0f));
 				DirectX::XMFLOAT3 specular = { 1.0f, 1.0f, 1.0f };
-				float outerCutOffAngleCos = cosf(15.0f);
+				float outerCutOffAngleCos = cosf(DirectX::XMConvertToRadians(15.0f));
 
+				int32_t shadowIndex = -1; // atlas view, -1 without shadow
+				DirectX::XMFLOAT3 p0;
+			};
+		}
 
-				// for shadow calculation
-				//DirectX::XMFLOAT4X4 viewProjMatrix;
+		static constexpr uint32_t s_atlasViewMaxCount = 64;
 
-			} spotLights[s_lightMaxCount];
+		// point and spot light shadows, indexed by the lights' shadowIndex
+		namespace AtlasShadowCBuf
+		{
+			struct AtlasView
+			{
+				DirectX::XMFLOAT4X4 viewProjection;
+				DirectX::XMFLOAT4 atlasRect; // tile uv scale xy, offset zw
+			};
+		}
+	}
 
-			DirectX::XMFLOAT3 viewPosition;
-			float p0;
+	namespace VS::g_buffer
+	{
+		// depth_only.vs reads the same buffer, up to normalMatrix
+		struct UserCBuf
+		{
+			DirectX::XMFLOAT4X4 transform;
+			DirectX::XMFLOAT4X4 normalMatrix;
+			uint32_t materialIndex = 0;
+			DirectX::XMFLOAT3 p0;
+		};
+	}
+
+	namespace PS::g_buffer
+	{
+		static constexpr uint32_t s_materialMaxCount = 256;
+
+		// the material table, deferred_light.ps reads shininess from it by the g-buffer's material index
+		struct MaterialCBuf
+		{
+			struct Material
+			{
+				DirectX::XMFLOAT4 diffuseCol = { 1.0f, 1.0f, 1.0f, 1.0f };
+				DirectX::XMFLOAT2 tiling = { 1.0f, 1.0f };
+				float shininess = 32.0f;
+				float p0;
 
-			uint32_t activeDirLights = 0;
-			uint32_t activePointLights = 0;
-			uint32_t activeSpotLights = 0;
-			float p1;
+				// slice of textureArrays[array], sampled inside rect
+				struct Texture
+				{
+					DirectX::XMFLOAT4 rect = { 1.0f, 1.0f, 0.0f, 0.0f }; // uv scale xy, offset zw
+					uint32_t array = 0;
+					uint32_t slice = 0;
+					DirectX::XMFLOAT2 p0;
+				} diffuseMap, specularMap;
+			} materials[s_materialMaxCount];
+		};
+	}
+
+	namespace PS::upscale
+	{
+		struct SystemCBuf
+		{
+			DirectX::XMFLOAT2 uvScale;
+			DirectX::XMFLOAT2 uvMax;
 		};
 	}
 }
\ No newline at end of file
@@ -99,6 +99,24 @@ namespace DRUtils
 		return XMQuaternionRotationRollPitchYaw(m_desc.pitch, m_desc.yaw, 0.0f);
 	}
 
+	void Camera::GetFrustumPlanes(DirectX::XMFLOAT4 planes[6]) const
+	{
+		// rows of the transposed view projection are its columns
+		XMMATRIX vp = XMMatrixTranspose(GetViewMatrix() * GetProjectionMatrix());
+		XMVECTOR planesXM[6] =
+		{
+			vp.r[3] + vp.r[0],
+			vp.r[3] - vp.r[0],
+			vp.r[3] + vp.r[1],
+			vp.r[3] - vp.r[1],
+			vp.r[2],
+			vp.r[3] - vp.r[2],
+		};
+
+		for (int i = 0; i < 6; i++)
+			XMStoreFloat4(&planes[i], XMPlaneNormalize(planesXM[i]));
+	}
+
 	void Camera::UpdateViewMatrix()
 	{
 		XMMATRIX view = XMMatrixIdentity();
@@ -36,6 +36,9 @@ namespace DRUtils
 		virtual DirectX::XMVECTOR GetForwardDirection() const;
 		virtual DirectX::XMVECTOR GetOrientation() const;
 
+		// world space left, right, bottom, top, near, far; normalized, pointing inwards
+		void GetFrustumPlanes(DirectX::XMFLOAT4 planes[6]) const;
+
 	protected:
 		void UpdateViewMatrix();
 		void UpdateProjectionMatrix();
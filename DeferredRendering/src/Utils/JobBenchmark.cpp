@@ -0,0 +1,96 @@
+#include "JobBenchmark.h"
+
+#include <GDX11/Core/JobSystem.h>
+#include <GDX11/Core/Profiler.h>
+#include <GDX11/Core/Log.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace GDX11;
+
+namespace DRUtils::JobBenchmark
+{
+	struct Sphere
+	{
+		float x, y, z, radius;
+	};
+
+	static uint32_t CullRange(const std::vector<Sphere>& spheres, uint32_t begin, uint32_t end)
+	{
+		static const float planes[6][4] = {
+			{ 1.0f, 0.0f, 0.0f, 50.0f }, { -1.0f, 0.0f, 0.0f, 50.0f },
+			{ 0.0f, 1.0f, 0.0f, 50.0f }, { 0.0f, -1.0f, 0.0f, 50.0f },
+			{ 0.0f, 0.0f, 1.0f, 50.0f }, { 0.0f, 0.0f, -1.0f, 50.0f },
+		};
+
+		uint32_t visible = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Sphere& s = spheres[i];
+			// every 8th item is a lot heavier so chunks finish at different times and stealing has work to do
+			const uint32_t iterations = (i & 7) == 0 ? 32 : 1;
+			bool inside = true;
+			for (uint32_t k = 0; k < iterations; k++)
+			{
+				for (const auto& p : planes)
+					inside &= p[0] * s.x + p[1] * s.y + p[2] * s.z + p[3] > -s.radius * std::sqrt((float)(k + 1));
+			}
+			visible += inside ? 1 : 0;
+		}
+
+		return visible;
+	}
+
+	std::vector<Result> Run(const std::vector<uint32_t>& threadCounts, uint32_t itemCount, uint32_t runCount)
+	{
+		std::vector<Sphere> spheres(itemCount);
+		uint32_t seed = 12345;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24); };
+		for (auto& s : spheres)
+			s = { random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 5.0f };
+
+		std::vector<Result> results;
+		for (uint32_t threadCount : threadCounts)
+		{
+			JobSystemDesc desc;
+			desc.threadCount = std::max(threadCount, 1u);
+			JobSystem jobSystem(desc);
+
+			Result result = {};
+			uint64_t best = UINT64_MAX;
+			for (uint32_t run = 0; run < runCount; run++)
+			{
+				std::atomic<uint32_t> visible = 0;
+				const uint64_t begin = Profiler::Now();
+				jobSystem.ParallelFor(itemCount, [&](uint32_t first, uint32_t last)
+				{
+					visible.fetch_add(CullRange(spheres, first, last), std::memory_order_relaxed);
+				});
+				best = std::min(best, Profiler::Now() - begin);
+				result.visibleCount = visible.load();
+			}
+
+			result.threadCount = jobSystem.GetThreadCount();
+			result.time = (float)best * 1e-6f;
+			for (const auto& stats : jobSystem.GetStats())
+			{
+				result.executed += stats.executed;
+				result.stolen += stats.stolen;
+				result.failedSteals += stats.failedSteals;
+			}
+			result.speedup = results.empty() ? 1.0f : results.front().time / result.time;
+			results.push_back(result);
+		}
+
+		return results;
+	}
+
+	void Log(const std::vector<Result>& results)
+	{
+		for (const auto& result : results)
+		{
+			GDX11_LOG_INFO("Job benchmark: {0} threads {1:.3f} ms (x{2:.2f}), {3} jobs, {4} stolen, {5} failed steals",
+				result.threadCount, result.time, result.speedup, result.executed, result.stolen, result.failedSteals);
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace DRUtils::JobBenchmark
+{
+	struct Result
+	{
+		uint32_t threadCount;
+		float time;    // ms, best of the runs
+		float speedup; // relative to the first thread count
+		uint64_t executed;
+		uint64_t stolen;
+		uint64_t failedSteals;
+		uint32_t visibleCount; // same for every thread count, or the jobs raced
+	};
+
+	// ParallelFor over a fixed synthetic culling workload (sphere vs 6 planes, uneven per item cost)
+	// once per thread count, each on its own JobSystem
+	std::vector<Result> Run(const std::vector<uint32_t>& threadCounts = { 1, 2, 4, 8, 16, 32, 64 }, uint32_t itemCount = 1 << 20, uint32_t runCount = 5);
+
+	// one line per thread count to the client log
+	void Log(const std::vector<Result>& results);
+}
@@ -0,0 +1,93 @@
+#include "LODSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	LODSelector::LODSelector(const LODSelectorDesc& desc)
+		: m_desc(desc)
+	{
+		UpdateProjectionScale();
+	}
+
+	LODSelector::LODSelector()
+		: LODSelector(LODSelectorDesc())
+	{
+	}
+
+	void LODSelector::Set(const LODSelectorDesc& desc)
+	{
+		m_desc = desc;
+		UpdateProjectionScale();
+	}
+
+	void LODSelector::SetPixelThreshold(float pixelThreshold)
+	{
+		m_desc.pixelThreshold = pixelThreshold;
+	}
+
+	void LODSelector::SetHysteresis(float hysteresis)
+	{
+		m_desc.hysteresis = hysteresis;
+	}
+
+	void LODSelector::SetViewportSize(float width, float height)
+	{
+		m_desc.viewportWidth = width;
+		m_desc.viewportHeight = height;
+		UpdateProjectionScale();
+	}
+
+	void LODSelector::Update(const Camera& camera)
+	{
+		const CameraDesc& desc = camera.GetDesc();
+		m_cameraPosition = desc.position;
+		m_fov = desc.fov;
+		m_aspect = desc.aspect;
+		m_nearPlane = desc.nearPlane;
+		UpdateProjectionScale();
+	}
+
+	float LODSelector::GetScreenSpaceError(float error, const XMFLOAT3& center, float radius) const
+	{
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&center) - XMLoadFloat3(&m_cameraPosition))) - radius;
+		distance = std::max(distance, m_nearPlane);
+		return error * m_projectionScale / distance;
+	}
+
+	uint32_t LODSelector::Select(const MeshSimplifier::LODChain& chain, const XMFLOAT3& position, float scale, uint32_t currentLOD) const
+	{
+		if (chain.levels.size() <= 1)
+			return 0;
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMLoadFloat3(&position) + XMLoadFloat3(&chain.center) * scale);
+		const float radius = chain.radius * scale;
+
+		auto screenError = [&](uint32_t lod) { return GetScreenSpaceError(chain.levels[lod].error * scale, center, radius); };
+
+		const uint32_t levelCount = static_cast<uint32_t>(chain.levels.size());
+		const float refineThreshold = m_desc.pixelThreshold * (1.0f + m_desc.hysteresis);
+		const float coarsenThreshold = m_desc.pixelThreshold * (1.0f - m_desc.hysteresis);
+
+		uint32_t lod = std::min(currentLOD, levelCount - 1);
+		while (lod > 0 && screenError(lod) > refineThreshold)
+			lod--;
+		while (lod + 1 < levelCount && screenError(lod + 1) <= coarsenThreshold)
+			lod++;
+
+		return lod;
+	}
+
+	void LODSelector::UpdateProjectionScale()
+	{
+		// pixels per world unit at distance 1, the larger axis wins if the camera aspect lags the viewport
+		const float tanHalfFov = std::tan(m_fov * 0.5f);
+		const float scaleY = 0.5f * m_desc.viewportHeight / tanHalfFov;
+		const float scaleX = 0.5f * m_desc.viewportWidth / (tanHalfFov * m_aspect);
+		m_projectionScale = std::max(scaleX, scaleY);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Camera.h"
+#include "MeshSimplifier.h"
+
+namespace DRUtils
+{
+	struct LODSelectorDesc
+	{
+		float pixelThreshold = 1.0f; // max screen space error in pixels
+		float hysteresis = 0.25f;	 // fraction of the threshold, prevents popping at the switch distance
+		float viewportWidth = 1280.0f;
+		float viewportHeight = 720.0f;
+	};
+
+	class LODSelector
+	{
+	public:
+		LODSelector(const LODSelectorDesc& desc);
+		LODSelector();
+		~LODSelector() = default;
+
+		void Set(const LODSelectorDesc& desc);
+		void SetPixelThreshold(float pixelThreshold);
+		void SetHysteresis(float hysteresis);
+		void SetViewportSize(float width, float height);
+
+		// call once per frame before selecting
+		void Update(const Camera& camera);
+
+		// world space error -> pixels, for a bounding sphere (world space)
+		float GetScreenSpaceError(float error, const DirectX::XMFLOAT3& center, float radius) const;
+
+		// currentLOD is the level used last frame, scale is the object's (uniform) world scale
+		uint32_t Select(const MeshSimplifier::LODChain& chain, const DirectX::XMFLOAT3& position, float scale, uint32_t currentLOD) const;
+
+		const LODSelectorDesc& GetDesc() const { return m_desc; }
+
+	private:
+		void UpdateProjectionScale();
+
+		LODSelectorDesc m_desc;
+		DirectX::XMFLOAT3 m_cameraPosition = { 0.0f, 0.0f, 0.0f };
+		float m_fov = DirectX::XMConvertToRadians(45.0f);
+		float m_aspect = 1280.0f / 720.0f;
+		float m_nearPlane = 0.1f;
+		float m_projectionScale = 1.0f;
+	};
+}
@@ -0,0 +1,237 @@
+#include "LightCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	LightCuller::LightCuller(const LightCullerDesc& desc)
+		: m_desc(desc)
+	{
+	}
+
+	void LightCuller::Update(const Camera& camera)
+	{
+		camera.GetFrustumPlanes(m_planes);
+		m_cameraPosition = camera.GetDesc().position;
+		m_projectionScale = 1.0f / std::tan(camera.GetDesc().fov * 0.5f);
+		m_aspect = camera.GetDesc().aspect;
+	}
+
+	void LightCuller::Cull(const PointLight* pointLights, uint32_t pointLightCount, const SpotLight* spotLights, uint32_t spotLightCount)
+	{
+		m_stats = {};
+		m_stats.lightCount = pointLightCount + spotLightCount;
+		m_pointLights.clear();
+		m_spotLights.clear();
+
+		XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int i = 0; i < 6; i++)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&m_planes[i]);
+			planeX[i] = XMVectorSplatX(plane);
+			planeY[i] = XMVectorSplatY(plane);
+			planeZ[i] = XMVectorSplatZ(plane);
+			planeW[i] = XMVectorSplatW(plane);
+		}
+
+		// point lights, spheres
+		{
+			const uint32_t padded = (pointLightCount + 3) & ~3u;
+			m_soa.assign((size_t)padded * 4, 0.0f);
+			float* x = &m_soa[0];
+			float* y = &m_soa[padded];
+			float* z = &m_soa[(size_t)padded * 2];
+			float* r = &m_soa[(size_t)padded * 3];
+			for (uint32_t i = 0; i < pointLightCount; i++)
+			{
+				const PointLight& light = pointLights[i];
+				x[i] = light.position.x;
+				y[i] = light.position.y;
+				z[i] = light.position.z;
+				r[i] = GetInfluenceRadius(light.constant, light.linear, light.quadratic,
+					GetLuminance(light.ambient, light.diffuse, light.specular), m_desc.luminanceThreshold);
+			}
+
+			for (uint32_t i = 0; i < pointLightCount; i += 4)
+			{
+				const XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&x[i]));
+				const XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&y[i]));
+				const XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&z[i]));
+				const XMVECTOR cr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&r[i]));
+
+				XMVECTOR inside = XMVectorTrueInt();
+				for (int p = 0; p < 6; p++)
+				{
+					XMVECTOR d = XMVectorMultiplyAdd(cx, planeX[p], XMVectorMultiplyAdd(cy, planeY[p], XMVectorMultiplyAdd(cz, planeZ[p], planeW[p])));
+					inside = XMVectorAndInt(inside, XMVectorGreater(d, -cr));
+				}
+
+				XMUINT4 insideMask;
+				XMStoreUInt4(&insideMask, inside);
+				const uint32_t inside4[4] = { insideMask.x, insideMask.y, insideMask.z, insideMask.w };
+				const uint32_t laneCount = std::min(4u, pointLightCount - i);
+				for (uint32_t lane = 0; lane < laneCount; lane++)
+				{
+					const uint32_t index = i + lane;
+					if (!inside4[lane])
+					{
+						m_stats.frustumCulledCount++;
+						continue;
+					}
+
+					const PointLight& light = pointLights[index];
+					VisibleLight visible;
+					visible.index = index;
+					visible.radius = r[index];
+					visible.coverage = GetCoverage(light.position, r[index]);
+					visible.contribution = visible.coverage * GetLuminance(light.ambient, light.diffuse, light.specular);
+					m_pointLights.push_back(visible);
+				}
+			}
+		}
+
+		// spot lights, cones capped at the influence radius. a cone is outside a plane when its apex and the
+		// farthest point of its base disk are both behind it
+		{
+			const uint32_t padded = (spotLightCount + 3) & ~3u;
+			m_soa.assign((size_t)padded * 8, 0.0f);
+			float* stream[8];
+			for (uint32_t s = 0; s < 8; s++)
+				stream[s] = &m_soa[(size_t)padded * s];
+			for (uint32_t i = 0; i < spotLightCount; i++)
+			{
+				const SpotLight& light = spotLights[i];
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&light.direction)));
+				const float radius = GetInfluenceRadius(light.constant, light.linear, light.quadratic,
+					GetLuminance(light.ambient, light.diffuse, light.specular), m_desc.luminanceThreshold);
+				// past 89 degrees the base disk explodes, the sphere test below bounds those
+				const float angle = std::min(std::acos(std::clamp(light.outerCutOffAngleCos, -1.0f, 1.0f)), XMConvertToRadians(89.0f));
+				stream[0][i] = light.position.x;
+				stream[1][i] = light.position.y;
+				stream[2][i] = light.position.z;
+				stream[3][i] = direction.x;
+				stream[4][i] = direction.y;
+				stream[5][i] = direction.z;
+				stream[6][i] = radius;
+				stream[7][i] = radius * std::tan(angle);
+			}
+
+			for (uint32_t i = 0; i < spotLightCount; i += 4)
+			{
+				const XMVECTOR ax = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[0][i]));
+				const XMVECTOR ay = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[1][i]));
+				const XMVECTOR az = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[2][i]));
+				const XMVECTOR dx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[3][i]));
+				const XMVECTOR dy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[4][i]));
+				const XMVECTOR dz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[5][i]));
+				const XMVECTOR h = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[6][i]));
+				const XMVECTOR baseRadius = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[7][i]));
+				const XMVECTOR bx = XMVectorMultiplyAdd(dx, h, ax);
+				const XMVECTOR by = XMVectorMultiplyAdd(dy, h, ay);
+				const XMVECTOR bz = XMVectorMultiplyAdd(dz, h, az);
+
+				XMVECTOR inside = XMVectorTrueInt();
+				for (int p = 0; p < 6; p++)
+				{
+					const XMVECTOR apexDistance = XMVectorMultiplyAdd(ax, planeX[p], XMVectorMultiplyAdd(ay, planeY[p], XMVectorMultiplyAdd(az, planeZ[p], planeW[p])));
+					const XMVECTOR baseDistance = XMVectorMultiplyAdd(bx, planeX[p], XMVectorMultiplyAdd(by, planeY[p], XMVectorMultiplyAdd(bz, planeZ[p], planeW[p])));
+					const XMVECTOR nd = XMVectorMultiplyAdd(dx, planeX[p], XMVectorMultiplyAdd(dy, planeY[p], dz * planeZ[p]));
+					const XMVECTOR baseExtent = baseRadius * XMVectorSqrt(XMVectorMax(XMVectorSplatOne() - nd * nd, XMVectorZero()));
+					inside = XMVectorAndInt(inside, XMVectorGreater(XMVectorMax(apexDistance, baseDistance + baseExtent), XMVectorZero()));
+					inside = XMVectorAndInt(inside, XMVectorGreater(apexDistance, -h));
+				}
+
+				XMUINT4 insideMask;
+				XMStoreUInt4(&insideMask, inside);
+				const uint32_t inside4[4] = { insideMask.x, insideMask.y, insideMask.z, insideMask.w };
+				const uint32_t laneCount = std::min(4u, spotLightCount - i);
+				for (uint32_t lane = 0; lane < laneCount; lane++)
+				{
+					const uint32_t index = i + lane;
+					if (!inside4[lane])
+					{
+						m_stats.frustumCulledCount++;
+						continue;
+					}
+
+					// coverage of the cone's bounding sphere
+					const SpotLight& light = spotLights[index];
+					const float height = stream[6][index];
+					const float cosAngle = std::clamp(light.outerCutOffAngleCos, 0.0f, 1.0f);
+					const float sinAngle = std::sqrt(1.0f - cosAngle * cosAngle);
+					const float offset = cosAngle > 0.70710678f ? height / (2.0f * cosAngle) : height * cosAngle;
+					const float sphereRadius = cosAngle > 0.70710678f ? offset : height * sinAngle;
+					const XMFLOAT3 center = {
+						light.position.x + stream[3][index] * offset,
+						light.position.y + stream[4][index] * offset,
+						light.position.z + stream[5][index] * offset };
+
+					VisibleLight visible;
+					visible.index = index;
+					visible.radius = height;
+					visible.coverage = cosAngle > 0.0f ? GetCoverage(center, sphereRadius) : GetCoverage(light.position, height);
+					visible.contribution = visible.coverage * GetLuminance(light.ambient, light.diffuse, light.specular);
+					m_spotLights.push_back(visible);
+				}
+			}
+		}
+
+		Rank(m_pointLights, m_desc.maxPointLights);
+		Rank(m_spotLights, m_desc.maxSpotLights);
+		m_stats.visibleCount = (uint32_t)(m_pointLights.size() + m_spotLights.size());
+	}
+
+	float LightCuller::GetInfluenceRadius(float constant, float linear, float quadratic, float luminance, float threshold)
+	{
+		// quadratic * d^2 + linear * d + constant - luminance / threshold = 0
+		const float c = constant - luminance / std::max(threshold, 1e-6f);
+		if (c >= 0.0f)
+			return 0.0f;
+		if (quadratic > 0.0f)
+			return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+		return linear > 0.0f ? -c / linear : FLT_MAX;
+	}
+
+	float LightCuller::GetLuminance(const XMFLOAT3& ambient, const XMFLOAT3& diffuse, const XMFLOAT3& specular)
+	{
+		const float r = ambient.x + diffuse.x + specular.x;
+		const float g = ambient.y + diffuse.y + specular.y;
+		const float b = ambient.z + diffuse.z + specular.z;
+		return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+	}
+
+	float LightCuller::GetCoverage(const XMFLOAT3& center, float radius) const
+	{
+		const float dx = center.x - m_cameraPosition.x;
+		const float dy = center.y - m_cameraPosition.y;
+		const float dz = center.z - m_cameraPosition.z;
+		const float distanceSq = dx * dx + dy * dy + dz * dz;
+		if (distanceSq <= radius * radius)
+			return 1.0f;
+
+		// projected radius in ndc y, the ellipse it makes over the 2x2 ndc square
+		const float projected = radius / std::sqrt(distanceSq - radius * radius) * m_projectionScale;
+		return std::min(XM_PI * projected * projected / (4.0f * m_aspect), 1.0f);
+	}
+
+	void LightCuller::Rank(std::vector<VisibleLight>& lights, uint32_t budget)
+	{
+		auto compare = [](const VisibleLight& a, const VisibleLight& b)
+		{
+			return a.contribution != b.contribution ? a.contribution > b.contribution : a.index < b.index;
+		};
+
+		if (lights.size() > budget)
+		{
+			std::nth_element(lights.begin(), lights.begin() + budget, lights.end(), compare);
+			m_stats.budgetCulledCount += (uint32_t)lights.size() - budget;
+			lights.resize(budget);
+		}
+		std::sort(lights.begin(), lights.end(), compare);
+	}
+}
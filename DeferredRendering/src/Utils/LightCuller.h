@@ -0,0 +1,82 @@
+#pragma once
+#include "Camera.h"
+#include "CBufs.h"
+
+#include <vector>
+
+namespace DRUtils
+{
+	struct LightCullerDesc
+	{
+		// a light's influence ends where its attenuated luminance drops below this
+		float luminanceThreshold = 1.0f / 256.0f;
+		// shader budget per type, the lights estimated to contribute the least are dropped past it
+		uint32_t maxPointLights = CBuf::PS::deferred_lighting::s_lightMaxCount;
+		uint32_t maxSpotLights = CBuf::PS::deferred_lighting::s_lightMaxCount;
+	};
+
+	struct VisibleLight
+	{
+		uint32_t index; // into the array passed to Cull
+		float radius; // influence radius
+		float coverage; // [0, 1], screen fraction of the influence bounds, 1 with the camera inside
+		float contribution; // coverage times luminance, what the list is sorted by
+	};
+
+	struct LightCullStats
+	{
+		uint32_t lightCount = 0;
+		uint32_t visibleCount = 0;
+		uint32_t frustumCulledCount = 0;
+		uint32_t budgetCulledCount = 0;
+	};
+
+	// per frame light visibility before the lights are uploaded. point lights are tested as spheres and spot lights
+	// as cones against the camera frustum, 4 at a time. what's left is sorted by estimated screen contribution and
+	// cut to the shader budget, lights that can't light anything on screen never reach the gpu
+	class LightCuller
+	{
+	public:
+		using PointLight = CBuf::PS::deferred_lighting::SystemCBuf::PointLight;
+		using SpotLight = CBuf::PS::deferred_lighting::SystemCBuf::SpotLight;
+
+		LightCuller(const LightCullerDesc& desc = LightCullerDesc());
+		~LightCuller() = default;
+
+		void Set(const LightCullerDesc& desc) { m_desc = desc; }
+		void SetLuminanceThreshold(float luminanceThreshold) { m_desc.luminanceThreshold = luminanceThreshold; }
+
+		// call once per frame before culling
+		void Update(const Camera& camera);
+		void Cull(const PointLight* pointLights, uint32_t pointLightCount, const SpotLight* spotLights, uint32_t spotLightCount);
+
+		// most contributing first, at most the budget
+		const std::vector<VisibleLight>& GetPointLights() const { return m_pointLights; }
+		const std::vector<VisibleLight>& GetSpotLights() const { return m_spotLights; }
+		const LightCullStats& GetStats() const { return m_stats; }
+		const LightCullerDesc& GetDesc() const { return m_desc; }
+
+		// distance luminance / (constant + linear * d + quadratic * d^2) falls to threshold at
+		static float GetInfluenceRadius(float constant, float linear, float quadratic, float luminance, float threshold);
+		// upper bound of what the light adds to a white surface, ambient, diffuse and specular together
+		static float GetLuminance(const DirectX::XMFLOAT3& ambient, const DirectX::XMFLOAT3& diffuse, const DirectX::XMFLOAT3& specular);
+
+	private:
+		float GetCoverage(const DirectX::XMFLOAT3& center, float radius) const;
+		// sorts by contribution and drops what's past the budget
+		void Rank(std::vector<VisibleLight>& lights, uint32_t budget);
+
+		LightCullerDesc m_desc;
+		DirectX::XMFLOAT4 m_planes[6] = {};
+		DirectX::XMFLOAT3 m_cameraPosition = { 0.0f, 0.0f, 0.0f };
+		float m_projectionScale = 1.0f; // cot(fov / 2)
+		float m_aspect = 1.0f;
+
+		// structure of arrays scratch, padded to 4
+		std::vector<float> m_soa;
+
+		std::vector<VisibleLight> m_pointLights;
+		std::vector<VisibleLight> m_spotLights;
+		LightCullStats m_stats;
+	};
+}
@@ -0,0 +1,57 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+
+namespace DRUtils
+{
+	bool Material::operator==(const Material& other) const
+	{
+		return diffuseCol.x == other.diffuseCol.x && diffuseCol.y == other.diffuseCol.y &&
+			diffuseCol.z == other.diffuseCol.z && diffuseCol.w == other.diffuseCol.w &&
+			tiling.x == other.tiling.x && tiling.y == other.tiling.y &&
+			shininess == other.shininess &&
+			diffuseMap == other.diffuseMap && specularMap == other.specularMap;
+	}
+
+	uint32_t MaterialTable::Add(const Material& material)
+	{
+		for (uint32_t i = 0; i < (uint32_t)m_materials.size(); i++)
+		{
+			if (m_materials[i] == material)
+				return i;
+		}
+
+		m_materials.push_back(material);
+		m_dirty = true;
+		return (uint32_t)m_materials.size() - 1;
+	}
+
+	void MaterialTable::Clear()
+	{
+		m_materials.clear();
+		m_dirty = true;
+	}
+
+	void MaterialTable::Fill(MaterialCBuf& cbuf, const TexturePacker& textures)
+	{
+		auto fillTexture = [&textures](MaterialCBuf::Material::Texture& texture, const std::string& name)
+		{
+			const TextureRef& ref = textures.GetRef(name);
+			texture.rect = ref.rect;
+			texture.array = ref.array;
+			texture.slice = ref.slice;
+		};
+
+		const uint32_t count = std::min((uint32_t)m_materials.size(), CBuf::PS::g_buffer::s_materialMaxCount);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Material& material = m_materials[i];
+			cbuf.materials[i].diffuseCol = material.diffuseCol;
+			cbuf.materials[i].tiling = material.tiling;
+			cbuf.materials[i].shininess = material.shininess;
+			fillTexture(cbuf.materials[i].diffuseMap, material.diffuseMap);
+			fillTexture(cbuf.materials[i].specularMap, material.specularMap);
+		}
+		m_dirty = false;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "CBufs.h"
+#include "TexturePacker.h"
+
+#include <string>
+#include <vector>
+
+namespace DRUtils
+{
+	struct Material
+	{
+		DirectX::XMFLOAT4 diffuseCol = { 1.0f, 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT2 tiling = { 1.0f, 1.0f };
+		float shininess = 32.0f;
+		// texture names in the texture packer
+		std::string diffuseMap;
+		std::string specularMap;
+
+		bool operator==(const Material& other) const;
+	};
+
+	// every material the scene uses, uploaded once into a single cbuf array the g-buffer and lighting shaders index.
+	// equal materials share an index, so a material change between draws is an index in the per draw cbuf instead of
+	// a cbuf map. textures are referenced by array, slice and atlas rect, the arrays are bound once per pass
+	class MaterialTable
+	{
+	public:
+		using MaterialCBuf = CBuf::PS::g_buffer::MaterialCBuf;
+
+		MaterialTable() = default;
+		~MaterialTable() = default;
+
+		// index of an equal material if there's one. load time, a linear search
+		uint32_t Add(const Material& material);
+		void Clear();
+
+		const Material& Get(uint32_t material) const { return m_materials[material]; }
+		uint32_t GetCount() const { return (uint32_t)m_materials.size(); }
+
+		// set by Add and Clear, the cbuf has to be filled and uploaded again
+		bool IsDirty() const { return m_dirty; }
+		// at most s_materialMaxCount, the rest is left as it was. textures have to be packed
+		void Fill(MaterialCBuf& cbuf, const TexturePacker& textures);
+
+	private:
+		std::vector<Material> m_materials;
+		bool m_dirty = true;
+	};
+}
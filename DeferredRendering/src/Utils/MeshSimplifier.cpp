@@ -0,0 +1,577 @@
+#include "MeshSimplifier.h"
+
+#include <GDX11/Core/JobSystem.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace DirectX;
+
+namespace DRUtils::MeshSimplifier
+{
+	// error(p) = p'Ap + 2b'p + c, with A symmetric
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(double nx, double ny, double nz, double d, double w)
+		{
+			a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz;
+			a11 += w * ny * ny; a12 += w * ny * nz; a22 += w * nz * nz;
+			b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02;
+			a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		double Error(const XMFLOAT3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double e =
+				a00 * x * x + a11 * y * y + a22 * z * z +
+				2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+				2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return e < 0.0 ? 0.0 : e;
+		}
+	};
+
+	enum class VertexKind : uint8_t
+	{
+		Manifold,
+		Border,
+		Seam, // one of two wedges along a uv/normal seam
+		Locked,
+	};
+
+	struct PositionKey
+	{
+		uint32_t x, y, z;
+
+		bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& k) const { return (k.x * 73856093u) ^ (k.y * 19349663u) ^ (k.z * 83492791u); }
+	};
+
+	static uint32_t FloatBits(float f)
+	{
+		f += 0.0f; // -0 -> +0
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	static uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	static uint64_t UndirectedEdgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? EdgeKey(a, b) : EdgeKey(b, a);
+	}
+
+	static void GetBounds(const MeshDesc& mesh, XMFLOAT3& minPos, XMFLOAT3& maxPos)
+	{
+		XMVECTOR minXM = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxXM = XMVectorReplicate(-FLT_MAX);
+		for (uint32_t i = 0; i < mesh.vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(mesh.vertices + i * mesh.vertexStride));
+			minXM = XMVectorMin(minXM, p);
+			maxXM = XMVectorMax(maxXM, p);
+		}
+		XMStoreFloat3(&minPos, minXM);
+		XMStoreFloat3(&maxPos, maxXM);
+	}
+
+	float GetMeshExtent(const MeshDesc& mesh)
+	{
+		if (mesh.vertexCount == 0) return 0.0f;
+
+		XMFLOAT3 minPos, maxPos;
+		GetBounds(mesh, minPos, maxPos);
+		return std::max({ maxPos.x - minPos.x, maxPos.y - minPos.y, maxPos.z - minPos.z });
+	}
+
+	SimplifyResult Simplify(const MeshDesc& mesh, const SimplifyDesc& desc)
+	{
+		SimplifyResult result;
+		result.indices.assign(mesh.indices, mesh.indices + mesh.indexCount);
+
+		if (mesh.indexCount <= desc.targetIndexCount || mesh.vertexCount == 0)
+			return result;
+
+		const uint32_t vertexCount = mesh.vertexCount;
+
+		// work in normalized space so errors are independent of the mesh scale
+		XMFLOAT3 minPos, maxPos;
+		GetBounds(mesh, minPos, maxPos);
+		const float extent = std::max({ maxPos.x - minPos.x, maxPos.y - minPos.y, maxPos.z - minPos.z, 1e-6f });
+		const XMVECTOR minXM = XMLoadFloat3(&minPos);
+		const float invExtent = 1.0f / extent;
+
+		std::vector<XMFLOAT3> positions(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(mesh.vertices + i * mesh.vertexStride));
+			XMStoreFloat3(&positions[i], (p - minXM) * invExtent);
+		}
+
+		// vertices that share a position (wedges), linked in a ring
+		std::vector<uint32_t> positionRemap(vertexCount);
+		std::vector<uint32_t> wedgeCount(vertexCount, 0);
+		std::vector<uint32_t> wedges(vertexCount);
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+			lookup.reserve(vertexCount);
+			std::iota(wedges.begin(), wedges.end(), 0);
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const float* p = mesh.vertices + i * mesh.vertexStride;
+				PositionKey key = { FloatBits(p[0]), FloatBits(p[1]), FloatBits(p[2]) };
+				auto it = lookup.emplace(key, i).first;
+				positionRemap[i] = it->second;
+				wedgeCount[it->second]++;
+				if (it->second != i)
+				{
+					wedges[i] = wedges[it->second];
+					wedges[it->second] = i;
+				}
+			}
+		}
+
+		const std::vector<uint32_t>& srcIndices = result.indices;
+
+		// edges without an opposite half edge (in position space) form the border, in position space.
+		// edges that have one in position space but not between the same vertices are seams, in vertex space.
+		// collapses along them make new ones, so they're found again after every pass
+		std::unordered_set<uint64_t> borderEdges;
+		std::unordered_set<uint64_t> seamEdges;
+		std::unordered_set<uint64_t> halfEdges;
+		std::unordered_set<uint64_t> vertexHalfEdges;
+		auto findOutlineEdges = [&](const std::vector<uint32_t>& triangles)
+		{
+			borderEdges.clear();
+			seamEdges.clear();
+			halfEdges.clear();
+			vertexHalfEdges.clear();
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					uint32_t a = triangles[i + e];
+					uint32_t b = triangles[i + (e + 1) % 3];
+					halfEdges.insert(EdgeKey(positionRemap[a], positionRemap[b]));
+					vertexHalfEdges.insert(EdgeKey(a, b));
+				}
+			}
+
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					uint32_t a = triangles[i + e];
+					uint32_t b = triangles[i + (e + 1) % 3];
+					if (halfEdges.find(EdgeKey(positionRemap[b], positionRemap[a])) == halfEdges.end())
+						borderEdges.insert(UndirectedEdgeKey(positionRemap[a], positionRemap[b]));
+					else if (vertexHalfEdges.find(EdgeKey(b, a)) == vertexHalfEdges.end())
+						seamEdges.insert(UndirectedEdgeKey(a, b));
+				}
+			}
+		};
+		findOutlineEdges(srcIndices);
+
+		std::vector<VertexKind> positionKinds(vertexCount, VertexKind::Manifold);
+		for (uint64_t edge : borderEdges)
+		{
+			positionKinds[edge >> 32] = VertexKind::Border;
+			positionKinds[edge & 0xffffffff] = VertexKind::Border;
+		}
+
+		std::vector<uint32_t> seamEdgeCount(vertexCount, 0);
+		for (uint64_t edge : seamEdges)
+		{
+			seamEdgeCount[edge >> 32]++;
+			seamEdgeCount[edge & 0xffffffff]++;
+		}
+
+		std::vector<VertexKind> kinds(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			uint32_t p = positionRemap[i];
+			if (wedgeCount[p] > 1)
+			{
+				// a seam running through, more wedges or a seam that forks or meets the border stays put
+				bool seam = wedgeCount[p] == 2 && positionKinds[p] != VertexKind::Border &&
+					seamEdgeCount[i] == 2 && seamEdgeCount[wedges[i]] == 2;
+				kinds[i] = seam ? VertexKind::Seam : VertexKind::Locked;
+			}
+			else if (positionKinds[p] == VertexKind::Border)
+				kinds[i] = desc.lockBorder ? VertexKind::Locked : VertexKind::Border;
+			else
+				kinds[i] = VertexKind::Manifold;
+		}
+
+		// plane quadrics, weighted by triangle area
+		std::vector<Quadric> quadrics(vertexCount);
+		std::vector<float> areas(vertexCount, 0.0f);
+		for (size_t i = 0; i < srcIndices.size(); i += 3)
+		{
+			const uint32_t tri[3] = { srcIndices[i], srcIndices[i + 1], srcIndices[i + 2] };
+			XMVECTOR p0 = XMLoadFloat3(&positions[tri[0]]);
+			XMVECTOR p1 = XMLoadFloat3(&positions[tri[1]]);
+			XMVECTOR p2 = XMLoadFloat3(&positions[tri[2]]);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+			float length = XMVectorGetX(XMVector3Length(normal));
+			float area = length * 0.5f;
+			if (length > 0.0f)
+				normal = normal / XMVectorReplicate(length);
+
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, normal);
+			float d = -XMVectorGetX(XMVector3Dot(normal, p0));
+
+			for (int k = 0; k < 3; k++)
+			{
+				quadrics[tri[k]].AddPlane(n.x, n.y, n.z, d, area);
+				areas[tri[k]] += area / 3.0f;
+			}
+
+			// border and seam edges get a perpendicular plane so the outline is preserved
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = tri[e];
+				uint32_t b = tri[(e + 1) % 3];
+				bool outline = seamEdges.find(UndirectedEdgeKey(a, b)) != seamEdges.end() ||
+					(!desc.lockBorder && borderEdges.find(UndirectedEdgeKey(positionRemap[a], positionRemap[b])) != borderEdges.end());
+				if (!outline)
+					continue;
+
+				XMVECTOR pa = XMLoadFloat3(&positions[a]);
+				XMVECTOR edge = XMLoadFloat3(&positions[b]) - pa;
+				XMVECTOR perp = XMVector3Normalize(XMVector3Cross(edge, normal));
+				XMFLOAT3 pn;
+				XMStoreFloat3(&pn, perp);
+				float pd = -XMVectorGetX(XMVector3Dot(perp, pa));
+				float weight = XMVectorGetX(XMVector3LengthSq(edge)) * 2.0f;
+				quadrics[a].AddPlane(pn.x, pn.y, pn.z, pd, weight);
+				quadrics[b].AddPlane(pn.x, pn.y, pn.z, pd, weight);
+			}
+		}
+
+		// the wedge of 'to' the other wedge of seam vertex 'from' moves to, along the seam on its side
+		auto seamTarget = [&](uint32_t from, uint32_t to)
+		{
+			if (seamEdges.find(UndirectedEdgeKey(from, to)) == seamEdges.end())
+				return UINT32_MAX;
+
+			const uint32_t other = wedges[from];
+			uint32_t w = to;
+			do
+			{
+				if (seamEdges.find(UndirectedEdgeKey(other, w)) != seamEdges.end())
+					return w;
+				w = wedges[w];
+			} while (w != to);
+			return UINT32_MAX;
+		};
+
+		auto canCollapse = [&](uint32_t from, uint32_t to)
+		{
+			if (kinds[from] == VertexKind::Locked)
+				return false;
+			if (kinds[from] == VertexKind::Border)
+				return borderEdges.find(UndirectedEdgeKey(positionRemap[from], positionRemap[to])) != borderEdges.end();
+			if (kinds[from] == VertexKind::Seam)
+				return seamTarget(from, to) != UINT32_MAX;
+			return true;
+		};
+
+		auto vertexCollapseCost = [&](uint32_t from, uint32_t to)
+		{
+			double error = quadrics[from].Error(positions[to]);
+
+			if (mesh.attributeCount > 0 && desc.attributeWeight > 0.0f)
+			{
+				const float* attrFrom = mesh.vertices + from * mesh.vertexStride + mesh.attributeOffset;
+				const float* attrTo = mesh.vertices + to * mesh.vertexStride + mesh.attributeOffset;
+				double attrError = 0.0;
+				for (uint32_t k = 0; k < mesh.attributeCount; k++)
+				{
+					double diff = attrFrom[k] - attrTo[k];
+					attrError += diff * diff;
+				}
+				error += desc.attributeWeight * areas[from] * attrError;
+			}
+
+			// normalize to a squared distance
+			return error / std::max(quadrics[from].weight, 1e-12);
+		};
+
+		// both wedges of a seam vertex move together, each side of the seam pays for its own
+		auto collapseCost = [&](uint32_t from, uint32_t to)
+		{
+			double cost = vertexCollapseCost(from, to);
+			if (kinds[from] == VertexKind::Seam)
+				cost += vertexCollapseCost(wedges[from], seamTarget(from, to));
+			return cost;
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		const double maxCost = static_cast<double>(desc.maxError) * desc.maxError;
+		const size_t targetTriangles = desc.targetIndexCount / 3;
+
+		std::vector<uint32_t>& indices = result.indices;
+		std::vector<uint64_t> edges;
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> collapseRemap(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<uint32_t> adjOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjTriangles;
+		double maxAppliedCost = 0.0;
+
+		while (indices.size() / 3 > targetTriangles)
+		{
+			const size_t triangleCount = indices.size() / 3;
+
+			edges.clear();
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+					edges.push_back(UndirectedEdgeKey(indices[i + e], indices[i + (e + 1) % 3]));
+			}
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			collapses.clear();
+			for (uint64_t edge : edges)
+			{
+				uint32_t a = static_cast<uint32_t>(edge >> 32);
+				uint32_t b = static_cast<uint32_t>(edge & 0xffffffff);
+
+				double costAB = canCollapse(a, b) ? collapseCost(a, b) : DBL_MAX;
+				double costBA = canCollapse(b, a) ? collapseCost(b, a) : DBL_MAX;
+
+				Collapse c = costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA };
+				if (c.cost <= maxCost)
+					collapses.push_back(c);
+			}
+
+			if (collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+			// vertex -> triangles
+			std::fill(adjOffsets.begin(), adjOffsets.end(), 0);
+			for (uint32_t index : indices)
+				adjOffsets[index + 1]++;
+			for (uint32_t i = 0; i < vertexCount; i++)
+				adjOffsets[i + 1] += adjOffsets[i];
+			adjTriangles.resize(indices.size());
+			{
+				std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++)
+					adjTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			auto flips = [&](uint32_t from, uint32_t to)
+			{
+				XMVECTOR newPos = XMLoadFloat3(&positions[to]);
+				for (uint32_t j = adjOffsets[from]; j < adjOffsets[from + 1]; j++)
+				{
+					const uint32_t* tri = &indices[adjTriangles[j] * 3];
+					if (tri[0] == to || tri[1] == to || tri[2] == to)
+						continue;
+
+					XMVECTOR p[3] = { XMLoadFloat3(&positions[tri[0]]), XMLoadFloat3(&positions[tri[1]]), XMLoadFloat3(&positions[tri[2]]) };
+					XMVECTOR oldNormal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+					for (int k = 0; k < 3; k++)
+					{
+						if (tri[k] == from)
+							p[k] = newPos;
+					}
+					XMVECTOR newNormal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+
+					float dot = XMVectorGetX(XMVector3Dot(oldNormal, newNormal));
+					float lengths = XMVectorGetX(XMVector3Length(oldNormal)) * XMVectorGetX(XMVector3Length(newNormal));
+					if (dot <= 0.25f * lengths)
+						return true;
+				}
+				return false;
+			};
+
+			std::iota(collapseRemap.begin(), collapseRemap.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+
+			const size_t removeGoal = triangleCount - targetTriangles;
+			size_t removed = 0;
+			size_t applied = 0;
+			auto apply = [&](uint32_t from, uint32_t to)
+			{
+				for (uint32_t j = adjOffsets[from]; j < adjOffsets[from + 1]; j++)
+				{
+					const uint32_t* tri = &indices[adjTriangles[j] * 3];
+					if (tri[0] == to || tri[1] == to || tri[2] == to)
+						removed++;
+
+					touched[tri[0]] = 1;
+					touched[tri[1]] = 1;
+					touched[tri[2]] = 1;
+				}
+
+				collapseRemap[from] = to;
+				quadrics[to].Add(quadrics[from]);
+				areas[to] += areas[from];
+			};
+
+			for (const Collapse& c : collapses)
+			{
+				if (removed >= removeGoal)
+					break;
+
+				// one collapse per neighbourhood per pass keeps the flip test valid
+				if (touched[c.from] || touched[c.to])
+					continue;
+
+				if (flips(c.from, c.to))
+					continue;
+
+				if (kinds[c.from] == VertexKind::Seam)
+				{
+					const uint32_t otherFrom = wedges[c.from];
+					const uint32_t otherTo = seamTarget(c.from, c.to);
+					if (touched[otherFrom] || touched[otherTo] || flips(otherFrom, otherTo))
+						continue;
+
+					apply(otherFrom, otherTo);
+				}
+
+				apply(c.from, c.to);
+				maxAppliedCost = std::max(maxAppliedCost, c.cost);
+				applied++;
+			}
+
+			if (applied == 0)
+				break;
+
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				uint32_t i0 = collapseRemap[indices[i + 0]];
+				uint32_t i1 = collapseRemap[indices[i + 1]];
+				uint32_t i2 = collapseRemap[indices[i + 2]];
+				if (i0 == i1 || i1 == i2 || i2 == i0)
+					continue;
+
+				indices[write + 0] = i0;
+				indices[write + 1] = i1;
+				indices[write + 2] = i2;
+				write += 3;
+			}
+			indices.resize(write);
+
+			findOutlineEdges(indices);
+		}
+
+		result.error = static_cast<float>(std::sqrt(maxAppliedCost));
+		return result;
+	}
+
+
+
+	LODChain GenerateLODChain(const MeshDesc& mesh, const LODChainDesc& desc)
+	{
+		LODChain chain;
+		chain.indices.assign(mesh.indices, mesh.indices + mesh.indexCount);
+		chain.levels.push_back({ 0, mesh.indexCount, 0.0f });
+
+		if (mesh.vertexCount == 0)
+			return chain;
+
+		XMFLOAT3 minPos, maxPos;
+		GetBounds(mesh, minPos, maxPos);
+		XMVECTOR center = (XMLoadFloat3(&minPos) + XMLoadFloat3(&maxPos)) * 0.5f;
+		float radiusSq = 0.0f;
+		for (uint32_t i = 0; i < mesh.vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(mesh.vertices + i * mesh.vertexStride));
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+		}
+		XMStoreFloat3(&chain.center, center);
+		chain.radius = std::sqrt(radiusSq);
+
+		const float extent = GetMeshExtent(mesh);
+		uint32_t prevCount = mesh.indexCount;
+		float prevError = 0.0f;
+
+		// every level is simplified from lod 0 so errors don't accumulate
+		while (chain.levels.size() < desc.maxLevels)
+		{
+			SimplifyDesc simplifyDesc = {};
+			simplifyDesc.targetIndexCount = static_cast<uint32_t>(prevCount * desc.reduction) / 3 * 3;
+			simplifyDesc.maxError = desc.maxError;
+			simplifyDesc.attributeWeight = desc.attributeWeight;
+			simplifyDesc.lockBorder = desc.lockBorder;
+
+			SimplifyResult simplified = Simplify(mesh, simplifyDesc);
+
+			// not worth a level if the simplifier got stuck on locked vertices or the error limit
+			if (simplified.indices.empty() || simplified.indices.size() > prevCount * 0.9f)
+				break;
+
+			float error = std::max(prevError, simplified.error * extent);
+			chain.levels.push_back({ static_cast<uint32_t>(chain.indices.size()), static_cast<uint32_t>(simplified.indices.size()), error });
+			chain.indices.insert(chain.indices.end(), simplified.indices.begin(), simplified.indices.end());
+
+			prevCount = static_cast<uint32_t>(simplified.indices.size());
+			prevError = error;
+		}
+
+		return chain;
+	}
+
+	std::vector<LODChain> GenerateLODChains(const std::vector<MeshDesc>& meshes, const LODChainDesc& desc, GDX11::JobSystem* jobSystem)
+	{
+		std::vector<LODChain> chains(meshes.size());
+		if (!jobSystem)
+		{
+			for (size_t i = 0; i < meshes.size(); i++)
+				chains[i] = GenerateLODChain(meshes[i], desc);
+			return chains;
+		}
+
+		// meshes differ a lot in cost, one job each lets idle threads steal the rest
+		GDX11::JobCounter counter;
+		for (size_t i = 0; i < meshes.size(); i++)
+			jobSystem->Run([&chains, &meshes, &desc, i]() { chains[i] = GenerateLODChain(meshes[i], desc); }, &counter);
+		jobSystem->Wait(counter);
+
+		return chains;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+namespace GDX11
+{
+	class JobSystem;
+}
+
+namespace DRUtils::MeshSimplifier
+{
+	struct MeshDesc
+	{
+		// interleaved vertices, position (xyz) must be the first 3 floats of a vertex
+		const float* vertices = nullptr;
+		uint32_t vertexCount = 0;
+		uint32_t vertexStride = 3; // in floats
+
+		// attributes (uv, normal, ...) that contribute to the collapse error
+		uint32_t attributeOffset = 0; // in floats
+		uint32_t attributeCount = 0;
+
+		const uint32_t* indices = nullptr;
+		uint32_t indexCount = 0;
+	};
+
+	struct SimplifyDesc
+	{
+		uint32_t targetIndexCount = 0;
+		float maxError = 0.01f; // relative to the mesh extent
+		float attributeWeight = 1.0f;
+		bool lockBorder = true;
+	};
+
+	struct SimplifyResult
+	{
+		// indexes into the original vertices, so every lod can share one vertex buffer
+		std::vector<uint32_t> indices;
+		float error = 0.0f; // relative to the mesh extent
+	};
+
+	// quadric error metric edge collapse
+	// vertices that share a position but not attributes (uv/normal seams) move together along the seam,
+	// where more than two of them meet (cube corners) or a seam meets the border they're never moved
+	SimplifyResult Simplify(const MeshDesc& mesh, const SimplifyDesc& desc);
+	float GetMeshExtent(const MeshDesc& mesh);
+
+
+
+	struct LODChainDesc
+	{
+		uint32_t maxLevels = 4; // including lod 0
+		float reduction = 0.5f; // index count of a level relative to the previous one
+		float maxError = 0.05f;
+		float attributeWeight = 1.0f;
+		bool lockBorder = true;
+	};
+
+	struct LODLevel
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error; // mesh local units
+	};
+
+	struct LODChain
+	{
+		std::vector<uint32_t> indices; // all levels concatenated, lod 0 first
+		std::vector<LODLevel> levels;
+
+		// bounding sphere of lod 0 (mesh local)
+		DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+		float radius = 0.0f;
+	};
+
+	LODChain GenerateLODChain(const MeshDesc& mesh, const LODChainDesc& desc);
+	// one job per mesh, null simplifies them on the calling thread
+	std::vector<LODChain> GenerateLODChains(const std::vector<MeshDesc>& meshes, const LODChainDesc& desc, GDX11::JobSystem* jobSystem = nullptr);
+}
@@ -0,0 +1,109 @@
+#include "MeshletCuller.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	void MeshletCuller::Update(const Camera& camera)
+	{
+		camera.GetFrustumPlanes(m_planes);
+		m_cameraPosition = camera.GetDesc().position;
+	}
+
+	void MeshletCuller::AddStats(const MeshletCullStats& stats)
+	{
+		m_stats.meshletCount += stats.meshletCount;
+		m_stats.visibleMeshletCount += stats.visibleMeshletCount;
+		m_stats.frustumCulledCount += stats.frustumCulledCount;
+		m_stats.backfaceCulledCount += stats.backfaceCulledCount;
+		m_stats.triangleCount += stats.triangleCount;
+		m_stats.visibleTriangleCount += stats.visibleTriangleCount;
+	}
+
+	void MeshletCuller::Cull(const Meshlets::MeshletMesh& mesh, FXMMATRIX world, uint32_t baseIndex, std::vector<MeshletDrawRange>& ranges)
+	{
+		// bring the view into mesh space so the bounds don't have to be transformed
+		const XMMATRIX worldT = XMMatrixTranspose(world);
+		XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int i = 0; i < 6; i++)
+		{
+			XMVECTOR plane = XMPlaneNormalize(XMVector4Transform(XMLoadFloat4(&m_planes[i]), worldT));
+			planeX[i] = XMVectorSplatX(plane);
+			planeY[i] = XMVectorSplatY(plane);
+			planeZ[i] = XMVectorSplatZ(plane);
+			planeW[i] = XMVectorSplatW(plane);
+		}
+
+		const XMVECTOR eye = XMVector3TransformCoord(XMLoadFloat3(&m_cameraPosition), XMMatrixInverse(nullptr, world));
+		const XMVECTOR eyeX = XMVectorSplatX(eye);
+		const XMVECTOR eyeY = XMVectorSplatY(eye);
+		const XMVECTOR eyeZ = XMVectorSplatZ(eye);
+
+		const Meshlets::MeshletBounds& b = mesh.bounds;
+		const uint32_t meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+
+		// 4 meshlets per iteration
+		for (uint32_t i = 0; i < meshletCount; i += 4)
+		{
+			const XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.centerX[i]));
+			const XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.centerY[i]));
+			const XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.centerZ[i]));
+			const XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.radius[i]));
+
+			XMVECTOR inside = XMVectorTrueInt();
+			for (int p = 0; p < 6; p++)
+			{
+				XMVECTOR d = XMVectorMultiplyAdd(cx, planeX[p], XMVectorMultiplyAdd(cy, planeY[p], XMVectorMultiplyAdd(cz, planeZ[p], planeW[p])));
+				inside = XMVectorAndInt(inside, XMVectorGreater(d, -r));
+			}
+
+			// all triangles face away: dot(c - eye, axis) >= cutoff * |c - eye| + r
+			const XMVECTOR vx = cx - eyeX;
+			const XMVECTOR vy = cy - eyeY;
+			const XMVECTOR vz = cz - eyeZ;
+			const XMVECTOR ax = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.coneAxisX[i]));
+			const XMVECTOR ay = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.coneAxisY[i]));
+			const XMVECTOR az = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.coneAxisZ[i]));
+			const XMVECTOR cutoff = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&b.coneCutoff[i]));
+			const XMVECTOR len = XMVectorSqrt(vx * vx + vy * vy + vz * vz);
+			const XMVECTOR backface = XMVectorGreaterOrEqual(vx * ax + vy * ay + vz * az, XMVectorMultiplyAdd(cutoff, len, r));
+
+			XMUINT4 insideMask, visibleMask;
+			XMStoreUInt4(&insideMask, inside);
+			XMStoreUInt4(&visibleMask, XMVectorAndCInt(inside, backface));
+			const uint32_t inside4[4] = { insideMask.x, insideMask.y, insideMask.z, insideMask.w };
+			const uint32_t visible4[4] = { visibleMask.x, visibleMask.y, visibleMask.z, visibleMask.w };
+
+			const uint32_t laneCount = std::min(4u, meshletCount - i);
+			for (uint32_t lane = 0; lane < laneCount; lane++)
+			{
+				const Meshlets::Meshlet& meshlet = mesh.meshlets[i + lane];
+				m_stats.meshletCount++;
+				m_stats.triangleCount += meshlet.triangleCount;
+
+				if (!inside4[lane])
+				{
+					m_stats.frustumCulledCount++;
+					continue;
+				}
+				if (!visible4[lane])
+				{
+					m_stats.backfaceCulledCount++;
+					continue;
+				}
+
+				m_stats.visibleMeshletCount++;
+				m_stats.visibleTriangleCount += meshlet.triangleCount;
+
+				const uint32_t offset = baseIndex + meshlet.indexOffset;
+				const uint32_t count = meshlet.triangleCount * 3;
+				if (!ranges.empty() && ranges.back().indexOffset + ranges.back().indexCount == offset)
+					ranges.back().indexCount += count;
+				else
+					ranges.push_back({ offset, count });
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Camera.h"
+#include "Meshlets.h"
+
+namespace DRUtils
+{
+	struct MeshletDrawRange
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+	};
+
+	struct MeshletCullStats
+	{
+		uint32_t meshletCount = 0;
+		uint32_t visibleMeshletCount = 0;
+		uint32_t frustumCulledCount = 0;
+		uint32_t backfaceCulledCount = 0;
+		uint32_t triangleCount = 0;
+		uint32_t visibleTriangleCount = 0;
+
+		float GetCulledTriangleRatio() const { return triangleCount ? 1.0f - (float)visibleTriangleCount / triangleCount : 0.0f; }
+	};
+
+	class MeshletCuller
+	{
+	public:
+		MeshletCuller() = default;
+		~MeshletCuller() = default;
+
+		// call once per frame before culling
+		void Update(const Camera& camera);
+		void ResetStats() { m_stats = MeshletCullStats(); }
+		// folds in stats of a culler that ran on another thread
+		void AddStats(const MeshletCullStats& stats);
+
+		// world must only rotate, translate and uniformly scale.
+		// visible meshlets are appended to ranges as index ranges offset by baseIndex, adjacent ones merged
+		void Cull(const Meshlets::MeshletMesh& mesh, DirectX::FXMMATRIX world, uint32_t baseIndex, std::vector<MeshletDrawRange>& ranges);
+
+		// accumulated since the last ResetStats
+		const MeshletCullStats& GetStats() const { return m_stats; }
+
+	private:
+		DirectX::XMFLOAT4 m_planes[6] = {};
+		DirectX::XMFLOAT3 m_cameraPosition = { 0.0f, 0.0f, 0.0f };
+		MeshletCullStats m_stats;
+	};
+}
@@ -0,0 +1,203 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace DRUtils::Meshlets
+{
+	static XMVECTOR LoadPosition(const MeshSimplifier::MeshDesc& mesh, uint32_t index)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(mesh.vertices + index * mesh.vertexStride));
+	}
+
+	static void ComputeBounds(const MeshSimplifier::MeshDesc& mesh, const uint32_t* indices, uint32_t triangleCount, MeshletBounds& bounds)
+	{
+		// sphere around the aabb center
+		XMVECTOR minXM = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxXM = XMVectorReplicate(-FLT_MAX);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			XMVECTOR p = LoadPosition(mesh, indices[i]);
+			minXM = XMVectorMin(minXM, p);
+			maxXM = XMVectorMax(maxXM, p);
+		}
+
+		XMVECTOR center = (minXM + maxXM) * 0.5f;
+		float radiusSq = 0.0f;
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(LoadPosition(mesh, indices[i]) - center)));
+
+		// normal cone
+		XMVECTOR axis = XMVectorZero();
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			XMVECTOR p0 = LoadPosition(mesh, indices[i * 3 + 0]);
+			XMVECTOR p1 = LoadPosition(mesh, indices[i * 3 + 1]);
+			XMVECTOR p2 = LoadPosition(mesh, indices[i * 3 + 2]);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+			if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+				axis += XMVector3Normalize(normal);
+		}
+		axis = XMVector3Normalize(axis);
+
+		float minDot = 1.0f;
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			XMVECTOR p0 = LoadPosition(mesh, indices[i * 3 + 0]);
+			XMVECTOR p1 = LoadPosition(mesh, indices[i * 3 + 1]);
+			XMVECTOR p2 = LoadPosition(mesh, indices[i * 3 + 2]);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+			if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+				minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, XMVector3Normalize(normal))));
+		}
+
+		XMFLOAT3 c, a;
+		XMStoreFloat3(&c, center);
+		XMStoreFloat3(&a, axis);
+		bounds.centerX.push_back(c.x);
+		bounds.centerY.push_back(c.y);
+		bounds.centerZ.push_back(c.z);
+		bounds.radius.push_back(std::sqrt(radiusSq));
+		bounds.coneAxisX.push_back(a.x);
+		bounds.coneAxisY.push_back(a.y);
+		bounds.coneAxisZ.push_back(a.z);
+		// normals spread over more than ~84 degrees, the cone can't cull anything
+		bounds.coneCutoff.push_back(minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot));
+	}
+
+	MeshletMesh Build(const MeshSimplifier::MeshDesc& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		MeshletMesh result;
+		const uint32_t triangleCount = mesh.indexCount / 3;
+		if (triangleCount == 0)
+			return result;
+
+		result.indices.reserve(triangleCount * 3);
+
+		// vertex -> triangles
+		std::vector<uint32_t> adjOffsets(mesh.vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjOffsets[mesh.indices[i] + 1]++;
+		for (uint32_t i = 0; i < mesh.vertexCount; i++)
+			adjOffsets[i + 1] += adjOffsets[i];
+		std::vector<uint32_t> adjTriangles(triangleCount * 3);
+		{
+			std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+			for (uint32_t i = 0; i < triangleCount * 3; i++)
+				adjTriangles[fill[mesh.indices[i]]++] = i / 3;
+		}
+
+		// unemitted triangles per vertex, finishing almost done fans first keeps meshlets compact
+		std::vector<uint32_t> liveTriangles(mesh.vertexCount, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			liveTriangles[mesh.indices[i]]++;
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint8_t> inMeshlet(mesh.vertexCount, 0);
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> candidates;
+		uint32_t seed = 0;
+
+		auto newVertexCount = [&](uint32_t tri)
+		{
+			const uint32_t* t = &mesh.indices[tri * 3];
+			return (inMeshlet[t[0]] ? 0u : 1u) + (inMeshlet[t[1]] ? 0u : 1u) + (inMeshlet[t[2]] ? 0u : 1u);
+		};
+
+		auto addTriangle = [&](uint32_t tri)
+		{
+			const uint32_t* t = &mesh.indices[tri * 3];
+			for (int k = 0; k < 3; k++)
+			{
+				liveTriangles[t[k]]--;
+				result.indices.push_back(t[k]);
+				if (inMeshlet[t[k]]) continue;
+
+				inMeshlet[t[k]] = 1;
+				meshletVertices.push_back(t[k]);
+				for (uint32_t j = adjOffsets[t[k]]; j < adjOffsets[t[k] + 1]; j++)
+				{
+					if (!emitted[adjTriangles[j]])
+						candidates.push_back(adjTriangles[j]);
+				}
+			}
+			emitted[tri] = 1;
+		};
+
+		while (true)
+		{
+			while (seed < triangleCount && emitted[seed])
+				seed++;
+			if (seed == triangleCount)
+				break;
+
+			Meshlet meshlet = {};
+			meshlet.indexOffset = static_cast<uint32_t>(result.indices.size());
+
+			addTriangle(seed);
+			meshlet.triangleCount = 1;
+
+			while (meshlet.triangleCount < maxTriangles)
+			{
+				uint32_t best = UINT32_MAX;
+				uint32_t bestNew = UINT32_MAX;
+				uint32_t bestLive = UINT32_MAX;
+
+				size_t write = 0;
+				for (size_t i = 0; i < candidates.size(); i++)
+				{
+					uint32_t tri = candidates[i];
+					if (emitted[tri]) continue;
+					candidates[write++] = tri;
+
+					uint32_t extra = newVertexCount(tri);
+					if (meshletVertices.size() + extra > maxVertices) continue;
+
+					const uint32_t* t = &mesh.indices[tri * 3];
+					uint32_t live = liveTriangles[t[0]] + liveTriangles[t[1]] + liveTriangles[t[2]];
+					if (extra < bestNew || (extra == bestNew && live < bestLive))
+					{
+						best = tri;
+						bestNew = extra;
+						bestLive = live;
+					}
+				}
+				candidates.resize(write);
+
+				if (best == UINT32_MAX)
+					break;
+
+				addTriangle(best);
+				meshlet.triangleCount++;
+			}
+
+			meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+			ComputeBounds(mesh, &result.indices[meshlet.indexOffset], meshlet.triangleCount, result.bounds);
+			result.meshlets.push_back(meshlet);
+
+			for (uint32_t v : meshletVertices)
+				inMeshlet[v] = 0;
+			meshletVertices.clear();
+			candidates.clear();
+		}
+
+		// pad with meshlets that never pass the frustum test
+		MeshletBounds& b = result.bounds;
+		while (b.radius.size() % 4 != 0)
+		{
+			b.centerX.push_back(0.0f);
+			b.centerY.push_back(0.0f);
+			b.centerZ.push_back(0.0f);
+			b.radius.push_back(-FLT_MAX);
+			b.coneAxisX.push_back(0.0f);
+			b.coneAxisY.push_back(0.0f);
+			b.coneAxisZ.push_back(0.0f);
+			b.coneCutoff.push_back(1.0f);
+		}
+
+		return result;
+	}
+}
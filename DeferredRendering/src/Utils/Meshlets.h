@@ -0,0 +1,34 @@
+#pragma once
+#include "MeshSimplifier.h"
+
+namespace DRUtils::Meshlets
+{
+	static constexpr uint32_t s_maxVertices = 64;
+	static constexpr uint32_t s_maxTriangles = 124;
+
+	struct Meshlet
+	{
+		uint32_t indexOffset; // into MeshletMesh::indices
+		uint32_t triangleCount;
+		uint32_t vertexCount;
+	};
+
+	// structure of arrays (mesh local), padded to a multiple of 4 for the simd culler
+	struct MeshletBounds
+	{
+		std::vector<float> centerX, centerY, centerZ, radius;
+		// a cutoff of 1 disables backface cone culling
+		std::vector<float> coneAxisX, coneAxisY, coneAxisZ, coneCutoff;
+	};
+
+	struct MeshletMesh
+	{
+		std::vector<Meshlet> meshlets;
+		MeshletBounds bounds;
+
+		// same triangles as the source, reordered so every meshlet is a contiguous index range
+		std::vector<uint32_t> indices;
+	};
+
+	MeshletMesh Build(const MeshSimplifier::MeshDesc& mesh, uint32_t maxVertices = s_maxVertices, uint32_t maxTriangles = s_maxTriangles);
+}
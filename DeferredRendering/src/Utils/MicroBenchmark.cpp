@@ -0,0 +1,402 @@
+#include "MicroBenchmark.h"
+#include "BasicMesh.h"
+#include "Camera.h"
+#include "LODSelector.h"
+#include "LightCuller.h"
+#include "MeshletCuller.h"
+#include "OcclusionCuller.h"
+#include "ResourceLibrary.h"
+
+#include <GDX11/Core/JobSystem.h>
+#include <GDX11/Core/Log.h>
+#include <GDX11/Core/Profiler.h>
+#include <GDX11/Event/EventQueue.h>
+#include <GDX11/Renderer/NativeArray.h>
+#include <GDX11/Renderer/ResBindingCache.h>
+#include <GDX11/Utils/Loader.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <GDX11.h>
+#endif // _WIN32
+
+using namespace DirectX;
+using namespace GDX11;
+
+namespace DRUtils::MicroBenchmark
+{
+	// allocations per op are its difference over a run, null doesn't count them
+	static AllocationCounter s_allocationCounter = nullptr;
+
+	// what the ops return is summed in here, so the compiler can't drop them
+	static volatile uint64_t s_sink = 0;
+
+	// ns of runs that short are mostly timer noise
+	static constexpr uint64_t s_minRunTime = 5'000'000;
+
+	template<typename Op>
+	static Result Measure(const char* name, uint32_t runCount, Op&& op)
+	{
+		auto run = [&](uint64_t iterations)
+		{
+			uint64_t sink = 0;
+			const uint64_t begin = Profiler::Now();
+			for (uint64_t i = 0; i < iterations; i++)
+				sink += (uint64_t)op(i);
+			const uint64_t time = Profiler::Now() - begin;
+			s_sink = s_sink + sink;
+			return time;
+		};
+
+		// doubles until a run is long enough to time, that run also warms the caches
+		uint64_t iterations = 1;
+		while (run(iterations) < s_minRunTime && iterations < (1ull << 30))
+			iterations *= 2;
+
+		Result result = {};
+		result.name = name;
+		result.iterations = iterations;
+		uint64_t best = UINT64_MAX;
+		const uint64_t allocationsBegin = s_allocationCounter ? s_allocationCounter() : 0;
+		for (uint32_t i = 0; i < std::max(runCount, 1u); i++)
+			best = std::min(best, run(iterations));
+		result.time = (double)best / iterations;
+		result.allocations = s_allocationCounter ? (double)(s_allocationCounter() - allocationsBegin) / ((double)iterations * std::max(runCount, 1u)) : -1.0;
+		return result;
+	}
+
+	// stands in for a RenderTargetView, GetNativeArray only asks for the native pointer
+	struct StubView
+	{
+		const StubView* GetNative() const { return this; }
+	};
+
+	// the cpu side of the resource calls, with stubs where the device would be so they run everywhere
+	static void RunResourceCases(uint32_t runCount, std::vector<Result>& results)
+	{
+		// keys shaped like the renderer's. the values are never dereferenced
+		ResourceLibrary library;
+		std::vector<std::string> keys;
+		for (const char* stage : { "vs", "ps" })
+		{
+			for (uint32_t pass = 0; pass < 32; pass++)
+				keys.push_back("cbuf.pass_" + std::to_string(pass) + "." + stage + ".SystemCBuf");
+		}
+		for (const auto& key : keys)
+			library.Add<Buffer>(key, nullptr);
+		library.Add<Buffer>("vb.cube", nullptr);
+		const std::string mesh = "cube";
+
+		results.push_back(Measure("ResourceLibrary::Get<Buffer>", runCount, [&](uint64_t i)
+		{
+			return library.Get<Buffer>(keys[i % keys.size()]) == nullptr;
+		}));
+
+		// a key built per lookup, what resolving a mesh's buffers once at load avoids
+		results.push_back(Measure("ResourceLibrary::Get<Buffer>, \"vb.\" + mesh", runCount, [&](uint64_t)
+		{
+			return library.Get<Buffer>("vb." + mesh) == nullptr;
+		}));
+
+		// what Shader::GetResBinding does once a name is cached, the reflection is never asked again
+		const char* bindings[] = { "SystemCBuf", "UserCBuf", "diffuseMap", "textureSampler" };
+		ResBindingCache bindingCache;
+		for (uint32_t i = 0; i < 4; i++)
+			bindingCache.Get(bindings[i], [i](const std::string&) { return i; });
+
+		results.push_back(Measure("ResBindingCache::Get, cached (Shader::GetResBinding, stub reflection)", runCount, [&](uint64_t i)
+		{
+			return bindingCache.Get(bindings[i & 3], [](const std::string&) { return UINT32_MAX; });
+		}));
+
+		// what RenderTargetView::Bind(RenderTargetViewArray) does before it calls OMSetRenderTargets, the g-buffer's 5 targets
+		std::vector<std::shared_ptr<StubView>> views;
+		for (uint32_t i = 0; i < 5; i++)
+			views.push_back(std::make_shared<StubView>());
+
+		results.push_back(Measure("GetNativeArray, 5 views (RenderTargetView::Bind(RenderTargetViewArray), stub views)", runCount, [&](uint64_t)
+		{
+			return GetNativeArray(views.data(), (uint32_t)views.size())[4] != nullptr;
+		}));
+	}
+
+#ifdef _WIN32
+	static void RunDeviceCases(GDX11Context* context, uint32_t runCount, std::vector<Result>& results)
+	{
+		const char* bindings[] = { "SystemCBuf", "UserCBuf", "diffuseMap", "textureSampler" };
+		auto ps = PixelShader::Create(context,
+			"cbuffer SystemCBuf : register(b0) { float4 a; };\n"
+			"cbuffer UserCBuf : register(b1) { float4 b; };\n"
+			"Texture2D diffuseMap : register(t0);\n"
+			"SamplerState textureSampler : register(s0);\n"
+			"float4 main(float2 uv : TEXCOORD) : SV_TARGET { return diffuseMap.Sample(textureSampler, uv) * a + b; }\n");
+		for (const char* binding : bindings)
+			ps->GetResBinding(binding);
+
+		results.push_back(Measure("Shader::GetResBinding, cached", runCount, [&](uint64_t i)
+		{
+			return ps->GetResBinding(bindings[i & 3]);
+		}));
+
+		// the g-buffer's targets
+		D3D11_TEXTURE2D_DESC texDesc = {};
+		texDesc.Width = 64;
+		texDesc.Height = 64;
+		texDesc.MipLevels = 1;
+		texDesc.ArraySize = 1;
+		texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		texDesc.SampleDesc.Count = 1;
+		texDesc.Usage = D3D11_USAGE_DEFAULT;
+		texDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+		rtvDesc.Format = texDesc.Format;
+		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		RenderTargetViewArray rtvs;
+		for (uint32_t i = 0; i < 5; i++)
+			rtvs.push_back(RenderTargetView::Create(context, rtvDesc, Texture2D::Create(context, texDesc, (void*)nullptr)));
+
+		// put back what was bound, this can run in the middle of a frame
+		ID3D11RenderTargetView* boundRTVs[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+		ID3D11DepthStencilView* boundDSV = nullptr;
+		context->GetDeviceContext()->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, boundRTVs, &boundDSV);
+
+		results.push_back(Measure("RenderTargetView::Bind(RenderTargetViewArray)", runCount, [&](uint64_t)
+		{
+			RenderTargetView::Bind(rtvs, nullptr);
+			return 0;
+		}));
+
+		context->GetDeviceContext()->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, boundRTVs, boundDSV);
+		// OMGetRenderTargets added a reference to each
+		for (ID3D11RenderTargetView* rtv : boundRTVs)
+		{
+			if (rtv) rtv->Release();
+		}
+		if (boundDSV) boundDSV->Release();
+	}
+#endif // _WIN32
+
+	// segments x segments quads in xz, [-0.5, 0.5], position only
+	static void CreateGrid(uint32_t segments, std::vector<float>& vertices, std::vector<uint32_t>& indices)
+	{
+		for (uint32_t z = 0; z <= segments; z++)
+		{
+			for (uint32_t x = 0; x <= segments; x++)
+				vertices.insert(vertices.end(), { (float)x / segments - 0.5f, 0.0f, (float)z / segments - 0.5f });
+		}
+
+		for (uint32_t z = 0; z < segments; z++)
+		{
+			for (uint32_t x = 0; x < segments; x++)
+			{
+				const uint32_t i = z * (segments + 1) + x;
+				indices.insert(indices.end(), { i, i + segments + 1, i + segments + 2, i, i + segments + 2, i + 1 });
+			}
+		}
+	}
+
+	// what the renderer does per frame on the cpu before it draws, sized like a busy scene
+	static void RunCullingCases(uint32_t runCount, std::vector<Result>& results)
+	{
+		JobSystem jobSystem;
+
+		results.push_back(Measure("JobSystem::Run + Wait, empty job", runCount, [&](uint64_t i)
+		{
+			JobCounter counter;
+			jobSystem.Run([]() {}, &counter);
+			jobSystem.Wait(counter);
+			return i;
+		}));
+
+		std::vector<float> items(1 << 14);
+		results.push_back(Measure("JobSystem::ParallelFor, 16K items", runCount, [&](uint64_t i)
+		{
+			jobSystem.ParallelFor((uint32_t)items.size(), [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t j = first; j < last; j++)
+					items[j] = items[j] * 0.5f + (float)j;
+			});
+			return items[i % items.size()] > 0.0f;
+		}));
+
+		CameraDesc cameraDesc;
+		cameraDesc.fov = XMConvertToRadians(45.0f);
+		cameraDesc.position = { 0.0f, 4.0f, -10.0f };
+		cameraDesc.pitch = XMConvertToRadians(20.0f);
+		Camera camera(cameraDesc);
+
+		std::vector<float> gridVertices;
+		std::vector<uint32_t> gridIndices;
+		CreateGrid(64, gridVertices, gridIndices);
+		MeshSimplifier::MeshDesc grid = {};
+		grid.vertices = gridVertices.data();
+		grid.vertexCount = (uint32_t)gridVertices.size() / 3;
+		grid.indices = gridIndices.data();
+		grid.indexCount = (uint32_t)gridIndices.size();
+
+		// half of it is behind the camera
+		const Meshlets::MeshletMesh meshlets = Meshlets::Build(grid);
+		const XMMATRIX gridWorld = XMMatrixScaling(40.0f, 1.0f, 40.0f);
+		MeshletCuller meshletCuller;
+		meshletCuller.Update(camera);
+		std::vector<MeshletDrawRange> ranges;
+		results.push_back(Measure("MeshletCuller::Cull, 8K triangles", runCount, [&](uint64_t)
+		{
+			ranges.clear();
+			meshletCuller.Cull(meshlets, gridWorld, 0, ranges);
+			return ranges.size();
+		}));
+
+		std::vector<LightCuller::PointLight> pointLights(256);
+		std::vector<LightCuller::SpotLight> spotLights(64);
+		for (size_t i = 0; i < pointLights.size(); i++)
+			pointLights[i].position = { (float)(i % 16) * 4.0f - 32.0f, 1.0f, (float)(i / 16) * 4.0f - 32.0f };
+		for (size_t i = 0; i < spotLights.size(); i++)
+			spotLights[i].position = { (float)(i % 8) * 8.0f - 32.0f, 5.0f, (float)(i / 8) * 8.0f - 32.0f };
+		LightCuller lightCuller;
+		results.push_back(Measure("LightCuller::Update + Cull, 256 point, 64 spot", runCount, [&](uint64_t)
+		{
+			lightCuller.Update(camera);
+			lightCuller.Cull(pointLights.data(), (uint32_t)pointLights.size(), spotLights.data(), (uint32_t)spotLights.size());
+			return lightCuller.GetPointLights().size();
+		}));
+
+		// a wall of cubes in front of the camera, the grid as the floor
+		const std::vector<float> cubeVertices = BasicMesh::CreateCubeVertices(false, false);
+		const auto cubeIndices = BasicMesh::CreateCubeIndices();
+		std::vector<XMFLOAT4X4> occluders(16);
+		for (size_t i = 0; i < occluders.size(); i++)
+			XMStoreFloat4x4(&occluders[i], XMMatrixScaling(2.0f, 3.0f, 1.0f) * XMMatrixTranslation((float)i * 2.0f - 16.0f, 1.5f, 5.0f));
+		OcclusionCuller occlusionCuller;
+		auto rasterize = [&](JobSystem* jobs)
+		{
+			occlusionCuller.Begin(camera);
+			occlusionCuller.AddOccluder(gridVertices.data(), grid.vertexCount, 3, gridIndices.data(), grid.indexCount, gridWorld);
+			for (const XMFLOAT4X4& world : occluders)
+				occlusionCuller.AddOccluder(cubeVertices.data(), (uint32_t)cubeVertices.size() / 3, 3, cubeIndices.data(), (uint32_t)cubeIndices.size(), XMLoadFloat4x4(&world));
+			occlusionCuller.Rasterize(jobs);
+			return occlusionCuller.GetStats().rasterizedTriangleCount;
+		};
+
+		results.push_back(Measure("OcclusionCuller::Begin + AddOccluder + Rasterize, 8K triangles", runCount, [&](uint64_t)
+		{
+			return rasterize(nullptr);
+		}));
+
+		results.push_back(Measure("OcclusionCuller::Begin + AddOccluder + Rasterize, 8K triangles, jobs", runCount, [&](uint64_t)
+		{
+			return rasterize(&jobSystem);
+		}));
+
+		// boxes behind the wall and in the open
+		const XMFLOAT3 boxMin = { -0.5f, -0.5f, -0.5f };
+		const XMFLOAT3 boxMax = { 0.5f, 0.5f, 0.5f };
+		results.push_back(Measure("OcclusionCuller::IsVisible", runCount, [&](uint64_t i)
+		{
+			return occlusionCuller.IsVisible(boxMin, boxMax, XMMatrixTranslation((float)(i & 31) - 16.0f, 0.5f, (float)(i & 3) * 4.0f + 2.0f));
+		}));
+
+		EventQueue events;
+		uint32_t dispatched = 0;
+		results.push_back(Measure("EventQueue::Post + Dispatch, 64 events", runCount, [&](uint64_t i)
+		{
+			for (int j = 0; j < 64; j++)
+				events.Post(j & 7 ? EventRecord::MouseMoved(j, (int)i) : EventRecord::KeyPressed(Key::W, 0));
+			events.Dispatch([&](const EventRecord&) { dispatched++; });
+			return dispatched;
+		}));
+
+		const MeshSimplifier::LODChain chain = MeshSimplifier::GenerateLODChain(grid, MeshSimplifier::LODChainDesc());
+		LODSelector lodSelector;
+		lodSelector.Update(camera);
+		uint32_t lod = 0;
+		results.push_back(Measure("LODSelector::Select", runCount, [&](uint64_t i)
+		{
+			lod = lodSelector.Select(chain, { 0.0f, 0.0f, (float)(i & 63) }, 4.0f, lod);
+			return lod;
+		}));
+	}
+
+	std::vector<Result> Run([[maybe_unused]] GDX11Context* context, uint32_t runCount, AllocationCounter allocationCounter)
+	{
+		std::vector<Result> results;
+		s_allocationCounter = allocationCounter;
+
+		RunResourceCases(runCount, results);
+#ifdef _WIN32
+		if (context)
+			RunDeviceCases(context, runCount, results);
+#endif // _WIN32
+
+		Camera camera;
+		results.push_back(Measure("Camera::SetPosition (UpdateViewMatrix)", runCount, [&](uint64_t i)
+		{
+			camera.SetPosition({ (float)(i & 15), 1.0f, -5.0f });
+			return i;
+		}));
+
+		results.push_back(Measure("Camera::GetForwardDirection", runCount, [&](uint64_t)
+		{
+			return XMVectorGetX(camera.GetForwardDirection()) > 0.5f;
+		}));
+
+		results.push_back(Measure("BasicMesh::CreateCubeVerticesEx", runCount, [&](uint64_t i)
+		{
+			return BasicMesh::CreateCubeVerticesEx()[i % 36].tangent.x > 0.5f;
+		}));
+
+		// a shader sized text file and a texture sized image
+		const std::filesystem::path directory = std::filesystem::temp_directory_path();
+		const std::string textFile = (directory / "micro_benchmark.txt").string();
+		const std::string imageFile = (directory / "micro_benchmark.bmp").string();
+		{
+			std::ofstream text(textFile, std::ios::out | std::ios::trunc);
+			for (uint32_t i = 0; i < 2048; i++)
+				text << "float4 line" << i << " = float4(0.0f, 0.0f, 0.0f, 1.0f);\n";
+		}
+		std::vector<uint8_t> pixels(256 * 256 * 4);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (uint8_t)(i * 7);
+		Utils::SaveImageBMP(imageFile, pixels.data(), 256, 256, 256 * 4);
+
+		results.push_back(Measure("Utils::LoadText, 100 KB", runCount, [&](uint64_t)
+		{
+			return Utils::LoadText(textFile).size();
+		}));
+
+		results.push_back(Measure("Utils::LoadImageFile, 256x256", runCount, [&](uint64_t)
+		{
+			Utils::ImageData image = Utils::LoadImageFile(imageFile, false, 4);
+			const int width = image.width;
+			Utils::FreeImageData(&image);
+			return width;
+		}));
+
+		std::error_code error;
+		std::filesystem::remove(textFile, error);
+		std::filesystem::remove(imageFile, error);
+
+		RunCullingCases(runCount, results);
+
+		return results;
+	}
+
+	void Log(const std::vector<Result>& results)
+	{
+		for (const auto& result : results)
+		{
+			if (result.allocations < 0.0)
+			{
+				GDX11_LOG_INFO("Micro benchmark: {0}: {1:.1f} ns/op, allocations not counted ({2} iterations per run)",
+					result.name, result.time, result.iterations);
+			}
+			else
+			{
+				GDX11_LOG_INFO("Micro benchmark: {0}: {1:.1f} ns/op, {2:.2f} allocations/op ({3} iterations per run)",
+					result.name, result.time, result.allocations, result.iterations);
+			}
+		}
+	}
+}
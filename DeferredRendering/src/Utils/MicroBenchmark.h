@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GDX11
+{
+	class GDX11Context;
+}
+
+namespace DRUtils::MicroBenchmark
+{
+	struct Result
+	{
+		std::string name;
+		double time;		// ns per op, best of the runs
+		double allocations; // operator new calls per op, C allocations (stb_image) aren't seen. -1 when not counted
+		uint64_t iterations; // per run
+	};
+
+	// the cpu side of calls the renderer makes every frame or at load. the cases that need a device (resource
+	// library, shader reflection, render target binds) only run on windows with a context, the rest (camera,
+	// basic meshes, loaders, job system, culling, occlusion raster, event queue, lod selection) build anywhere
+	// DirectXMath, spdlog and stb_image do, see DeferredRenderingBenchmarks. files go to the temp directory
+	// operator new calls so far in the process
+	using AllocationCounter = uint64_t(*)();
+	// defined by benchmarks/AllocationCounter.cpp, which replaces the global operator new to count the calls. only the
+	// benchmark executable links it, the app keeps the default allocator and runs without a counter
+	uint64_t GetAllocationCount();
+
+	std::vector<Result> Run(GDX11::GDX11Context* context = nullptr, uint32_t runCount = 5, AllocationCounter allocationCounter = nullptr);
+
+	// one line per case to the client log
+	void Log(const std::vector<Result>& results);
+}
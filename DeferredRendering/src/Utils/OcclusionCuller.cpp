@@ -0,0 +1,477 @@
+#include "OcclusionCuller.h"
+
+#include <GDX11/Core/JobSystem.h>
+#include <GDX11/Core/Profiler.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DR_TARGET_AVX2
+#else
+#define DR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	// edge functions and the depth plane relative to the first pixel center of a row aligned bounding box,
+	// set up in double so big guard band coordinates don't cost precision
+	struct TriangleSetup
+	{
+		uint32_t x0, y0, x1, y1; // x0 and x1 aligned to 8
+		float a[3], b[3], c[3];  // edge(i, j) = a * i + b * j + c, the whole pixel is inside when all >= 0
+		float dzdx, dzdy, z;     // pushed back to the farthest point of the pixel
+		float zMin;
+	};
+
+	static bool SetupTriangle(const float x[3], const float y[3], const float z[3], uint32_t binX0, uint32_t binY0, uint32_t binX1, uint32_t binY1, TriangleSetup& setup)
+	{
+		const float minX = std::min({ x[0], x[1], x[2] });
+		const float maxX = std::max({ x[0], x[1], x[2] });
+		const float minY = std::min({ y[0], y[1], y[2] });
+		const float maxY = std::max({ y[0], y[1], y[2] });
+
+		setup.x0 = (uint32_t)std::max((float)binX0, std::floor(minX)) & ~7u;
+		setup.y0 = (uint32_t)std::max((float)binY0, std::floor(minY));
+		setup.x1 = (uint32_t)std::min((float)binX1, std::ceil(maxX));
+		setup.y1 = (uint32_t)std::min((float)binY1, std::ceil(maxY));
+		setup.x1 = (setup.x1 + 7) & ~7u;
+		if (setup.x0 >= setup.x1 || setup.y0 >= setup.y1)
+			return false;
+
+		const double originX = setup.x0 + 0.5;
+		const double originY = setup.y0 + 0.5;
+		for (int i = 0; i < 3; i++)
+		{
+			const int j = (i + 1) % 3;
+			const double dx = (double)x[j] - x[i];
+			const double dy = (double)y[j] - y[i];
+			setup.a[i] = (float)-dy;
+			setup.b[i] = (float)dx;
+			// moved in by half a pixel along both axes, the farthest a corner gets from the center along the edge
+			// normal, so a pixel the triangle only partly covers isn't written and can't hide what's behind its gap
+			setup.c[i] = (float)(dx * (originY - y[i]) - dy * (originX - x[i]) - 0.5 * (std::abs(dx) + std::abs(dy)));
+		}
+
+		const double x10 = (double)x[1] - x[0], y10 = (double)y[1] - y[0], z10 = (double)z[1] - z[0];
+		const double x20 = (double)x[2] - x[0], y20 = (double)y[2] - y[0], z20 = (double)z[2] - z[0];
+		const double area = x10 * y20 - y10 * x20;
+		const double dzdx = (z10 * y20 - z20 * y10) / area;
+		const double dzdy = (z20 * x10 - z10 * x20) / area;
+		setup.dzdx = (float)dzdx;
+		setup.dzdy = (float)dzdy;
+		setup.z = (float)(z[0] + dzdx * (originX - x[0]) + dzdy * (originY - y[0]) - 0.5 * (std::abs(dzdx) + std::abs(dzdy)));
+		setup.zMin = std::min({ z[0], z[1], z[2] });
+		return true;
+	}
+
+	OcclusionCuller::OcclusionCuller(const OcclusionCullerDesc& desc)
+	{
+		m_tileCountX = std::max((desc.width + s_tileWidth - 1) / s_tileWidth, 1u);
+		m_tileCountY = std::max((desc.height + s_tileHeight - 1) / s_tileHeight, 1u);
+		m_width = m_tileCountX * s_tileWidth;
+		m_height = m_tileCountY * s_tileHeight;
+
+		// bins are whole tiles so every tile belongs to one job
+		const uint32_t binTilesX = (m_tileCountX + std::max(desc.binCountX, 1u) - 1) / std::max(desc.binCountX, 1u);
+		const uint32_t binTilesY = (m_tileCountY + std::max(desc.binCountY, 1u) - 1) / std::max(desc.binCountY, 1u);
+		m_binWidth = binTilesX * s_tileWidth;
+		m_binHeight = binTilesY * s_tileHeight;
+		m_binCountX = (m_tileCountX + binTilesX - 1) / binTilesX;
+		const uint32_t binCountY = (m_tileCountY + binTilesY - 1) / binTilesY;
+		for (uint32_t y = 0; y < binCountY; y++)
+		{
+			for (uint32_t x = 0; x < m_binCountX; x++)
+			{
+				Bin bin;
+				bin.x0 = x * m_binWidth;
+				bin.y0 = y * m_binHeight;
+				bin.x1 = std::min(bin.x0 + m_binWidth, m_width);
+				bin.y1 = std::min(bin.y0 + m_binHeight, m_height);
+				m_bins.push_back(std::move(bin));
+			}
+		}
+
+		m_depth.resize((size_t)m_width * m_height, 0.0f);
+		m_tileMinDepth.resize((size_t)m_tileCountX * m_tileCountY, 0.0f);
+		m_avx2 = HasAVX2();
+		XMStoreFloat4x4(&m_viewProjection, XMMatrixIdentity());
+	}
+
+	void OcclusionCuller::Begin(const Camera& camera)
+	{
+		XMStoreFloat4x4(&m_viewProjection, camera.GetViewMatrix() * camera.GetProjectionMatrix());
+		m_nearPlane = camera.GetDesc().nearPlane;
+
+		std::fill(m_depth.begin(), m_depth.end(), 0.0f);
+		std::fill(m_tileMinDepth.begin(), m_tileMinDepth.end(), 0.0f);
+		m_triangles.clear();
+		for (auto& bin : m_bins)
+			bin.triangles.clear();
+		m_stats = OcclusionCullStats();
+	}
+
+	void OcclusionCuller::AddOccluder(const float* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indices, uint32_t indexCount, FXMMATRIX world)
+	{
+		const uint64_t begin = GDX11::Profiler::Now();
+
+		const XMMATRIX worldViewProjection = world * XMLoadFloat4x4(&m_viewProjection);
+		m_clipVertices.resize(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const float* position = vertices + (size_t)i * vertexStride;
+			XMStoreFloat4(&m_clipVertices[i], XMVector4Transform(XMVectorSet(position[0], position[1], position[2], 1.0f), worldViewProjection));
+		}
+
+		for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			const XMFLOAT4 clip[3] = { m_clipVertices[indices[i]], m_clipVertices[indices[i + 1]], m_clipVertices[indices[i + 2]] };
+			AddTriangle(clip);
+		}
+
+		m_stats.occluderCount++;
+		m_stats.occluderTriangleCount += indexCount / 3;
+		m_stats.rasterTime += (float)(GDX11::Profiler::Now() - begin) * 1e-6f;
+	}
+
+	void OcclusionCuller::AddTriangle(const XMFLOAT4 clip[3])
+	{
+		// outside one of the side planes or behind the near plane
+		uint32_t outside = 0x1f;
+		uint32_t behind = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& v = clip[i];
+			const uint32_t code = (v.x > v.w ? 1 : 0) | (v.x < -v.w ? 2 : 0) | (v.y > v.w ? 4 : 0) | (v.y < -v.w ? 8 : 0) | (v.w < m_nearPlane ? 16 : 0);
+			outside &= code;
+			behind += v.w < m_nearPlane ? 1 : 0;
+		}
+		if (outside)
+			return;
+
+		if (behind == 0)
+		{
+			AddProjected(clip[0], clip[1], clip[2]);
+			return;
+		}
+
+		// clipped against w = near, one vertex behind leaves a quad
+		XMFLOAT4 polygon[4];
+		uint32_t count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& v0 = clip[i];
+			const XMFLOAT4& v1 = clip[(i + 1) % 3];
+			const bool in0 = v0.w >= m_nearPlane;
+			const bool in1 = v1.w >= m_nearPlane;
+			if (in0)
+				polygon[count++] = v0;
+			if (in0 != in1)
+			{
+				const float t = (m_nearPlane - v0.w) / (v1.w - v0.w);
+				XMStoreFloat4(&polygon[count++], XMVectorLerp(XMLoadFloat4(&v0), XMLoadFloat4(&v1), t));
+			}
+		}
+
+		for (uint32_t i = 2; i < count; i++)
+			AddProjected(polygon[0], polygon[i - 1], polygon[i]);
+	}
+
+	void OcclusionCuller::AddProjected(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+	{
+		Triangle triangle;
+		const XMFLOAT4* clip[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; i++)
+		{
+			const float invW = 1.0f / clip[i]->w;
+			triangle.x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * m_width;
+			triangle.y[i] = (0.5f - clip[i]->y * invW * 0.5f) * m_height;
+			triangle.z[i] = invW;
+		}
+
+		// y points down, clockwise front faces have a positive area
+		const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+		if (!(area > 0.0f))
+			return;
+
+		const float minX = std::max(std::floor(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] })), 0.0f);
+		const float minY = std::max(std::floor(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] })), 0.0f);
+		const float maxX = std::min(std::ceil(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] })), (float)m_width);
+		const float maxY = std::min(std::ceil(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] })), (float)m_height);
+		if (minX >= maxX || minY >= maxY)
+			return;
+
+		const uint32_t index = (uint32_t)m_triangles.size();
+		m_triangles.push_back(triangle);
+		m_stats.rasterizedTriangleCount++;
+
+		const uint32_t binX0 = (uint32_t)minX / m_binWidth;
+		const uint32_t binY0 = (uint32_t)minY / m_binHeight;
+		const uint32_t binX1 = ((uint32_t)maxX - 1) / m_binWidth;
+		const uint32_t binY1 = ((uint32_t)maxY - 1) / m_binHeight;
+		for (uint32_t y = binY0; y <= binY1; y++)
+		{
+			for (uint32_t x = binX0; x <= binX1; x++)
+				m_bins[y * m_binCountX + x].triangles.push_back(index);
+		}
+	}
+
+	void OcclusionCuller::Rasterize(GDX11::JobSystem* jobSystem)
+	{
+		const uint64_t begin = GDX11::Profiler::Now();
+
+		// bins don't share pixels or tiles, no synchronisation needed
+		if (jobSystem)
+		{
+			jobSystem->ParallelFor((uint32_t)m_bins.size(), [this](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+					RasterizeBin(m_bins[i]);
+			}, 1);
+		}
+		else
+		{
+			for (auto& bin : m_bins)
+				RasterizeBin(bin);
+		}
+
+		m_stats.rasterTime += (float)(GDX11::Profiler::Now() - begin) * 1e-6f;
+	}
+
+	void OcclusionCuller::RasterizeBin(Bin& bin)
+	{
+		for (uint32_t index : bin.triangles)
+		{
+			if (m_avx2)
+				RasterizeTriangleAVX2(m_triangles[index], bin);
+			else
+				RasterizeTriangle(m_triangles[index], bin);
+		}
+
+		UpdateTiles(bin);
+	}
+
+	void OcclusionCuller::RasterizeTriangle(const Triangle& triangle, const Bin& bin)
+	{
+		TriangleSetup s;
+		if (!SetupTriangle(triangle.x, triangle.y, triangle.z, bin.x0, bin.y0, bin.x1, bin.y1, s))
+			return;
+
+		// the same operations in the same order as the avx2 rows, the two write the same depth bit for bit
+		for (uint32_t y = s.y0; y < s.y1; y++)
+		{
+			const float j = (float)(y - s.y0);
+			const float e0 = s.b[0] * j + s.c[0];
+			const float e1 = s.b[1] * j + s.c[1];
+			const float e2 = s.b[2] * j + s.c[2];
+			const float zRow = s.z + s.dzdy * j;
+
+			float* row = &m_depth[(size_t)y * m_width];
+			for (uint32_t x = s.x0; x < s.x1; x++)
+			{
+				const float i = (float)(x - s.x0);
+				// the sign bit like the avx2 rows, -0 is outside too
+				if (std::signbit(e0 + s.a[0] * i) || std::signbit(e1 + s.a[1] * i) || std::signbit(e2 + s.a[2] * i))
+					continue;
+
+				const float z = std::max(zRow + s.dzdx * i, s.zMin);
+				row[x] = std::max(row[x], z);
+			}
+		}
+	}
+
+	DR_TARGET_AVX2 void OcclusionCuller::RasterizeTriangleAVX2(const Triangle& triangle, const Bin& bin)
+	{
+		TriangleSetup s;
+		if (!SetupTriangle(triangle.x, triangle.y, triangle.z, bin.x0, bin.y0, bin.x1, bin.y1, s))
+			return;
+
+		// the pixel offset is recomputed every 8 pixels instead of stepping the edges, so the result
+		// matches the scalar rows exactly
+		const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		const __m256 a0 = _mm256_set1_ps(s.a[0]);
+		const __m256 a1 = _mm256_set1_ps(s.a[1]);
+		const __m256 a2 = _mm256_set1_ps(s.a[2]);
+		const __m256 dzdx = _mm256_set1_ps(s.dzdx);
+		const __m256 zMin = _mm256_set1_ps(s.zMin);
+
+		for (uint32_t y = s.y0; y < s.y1; y++)
+		{
+			const float j = (float)(y - s.y0);
+			const __m256 e0 = _mm256_set1_ps(s.b[0] * j + s.c[0]);
+			const __m256 e1 = _mm256_set1_ps(s.b[1] * j + s.c[1]);
+			const __m256 e2 = _mm256_set1_ps(s.b[2] * j + s.c[2]);
+			const __m256 zRow = _mm256_set1_ps(s.z + s.dzdy * j);
+
+			float* row = &m_depth[(size_t)y * m_width];
+			for (uint32_t x = s.x0; x < s.x1; x += 8)
+			{
+				const __m256 i = _mm256_add_ps(_mm256_set1_ps((float)(x - s.x0)), lane);
+
+				// sign bit set in any edge means outside
+				const __m256 outside = _mm256_or_ps(_mm256_add_ps(e0, _mm256_mul_ps(a0, i)),
+					_mm256_or_ps(_mm256_add_ps(e1, _mm256_mul_ps(a1, i)), _mm256_add_ps(e2, _mm256_mul_ps(a2, i))));
+				if (_mm256_movemask_ps(outside) != 0xff)
+				{
+					const __m256 z = _mm256_add_ps(zRow, _mm256_mul_ps(dzdx, i));
+					const __m256 depth = _mm256_loadu_ps(row + x);
+					const __m256 nearest = _mm256_max_ps(depth, _mm256_max_ps(z, zMin));
+					_mm256_storeu_ps(row + x, _mm256_blendv_ps(nearest, depth, outside));
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::UpdateTiles(const Bin& bin)
+	{
+		for (uint32_t ty = bin.y0 / s_tileHeight; ty < bin.y1 / s_tileHeight; ty++)
+		{
+			for (uint32_t tx = bin.x0 / s_tileWidth; tx < bin.x1 / s_tileWidth; tx++)
+			{
+				float farthest = FLT_MAX;
+				for (uint32_t y = ty * s_tileHeight; y < (ty + 1) * s_tileHeight; y++)
+				{
+					const float* row = &m_depth[(size_t)y * m_width + tx * s_tileWidth];
+					for (uint32_t x = 0; x < s_tileWidth; x++)
+						farthest = std::min(farthest, row[x]);
+				}
+				m_tileMinDepth[ty * m_tileCountX + tx] = farthest;
+			}
+		}
+	}
+
+	bool OcclusionCuller::ProjectBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, FXMMATRIX world, XMFLOAT4& rect, float& nearest) const
+	{
+		const XMMATRIX worldViewProjection = world * XMLoadFloat4x4(&m_viewProjection);
+		rect = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+		nearest = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			const XMVECTOR corner = XMVectorSet(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z, 1.0f);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(corner, worldViewProjection));
+			if (clip.w < m_nearPlane)
+				return false;
+
+			const float invW = 1.0f / clip.w;
+			const float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+			const float y = (0.5f - clip.y * invW * 0.5f) * m_height;
+			rect.x = std::min(rect.x, x);
+			rect.y = std::min(rect.y, y);
+			rect.z = std::max(rect.z, x);
+			rect.w = std::max(rect.w, y);
+			nearest = std::max(nearest, invW);
+		}
+
+		return true;
+	}
+
+	bool OcclusionCuller::IsVisible(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, FXMMATRIX world)
+	{
+		m_stats.testedCount++;
+
+		// crosses the near plane, the camera may be inside it
+		XMFLOAT4 rect;
+		float nearest;
+		if (!ProjectBounds(boundsMin, boundsMax, world, rect, nearest))
+			return true;
+
+		// off screen is the frustum culler's job
+		const uint32_t x0 = (uint32_t)std::clamp(std::floor(rect.x), 0.0f, (float)m_width);
+		const uint32_t y0 = (uint32_t)std::clamp(std::floor(rect.y), 0.0f, (float)m_height);
+		const uint32_t x1 = (uint32_t)std::clamp(std::ceil(rect.z), 0.0f, (float)m_width);
+		const uint32_t y1 = (uint32_t)std::clamp(std::ceil(rect.w), 0.0f, (float)m_height);
+		if (x0 >= x1 || y0 >= y1)
+			return true;
+
+		if (IsRectVisible(x0, y0, x1, y1, nearest))
+			return true;
+
+		m_stats.occludedCount++;
+		return false;
+	}
+
+	float OcclusionCuller::GetScreenCoverage(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, FXMMATRIX world) const
+	{
+		XMFLOAT4 rect;
+		float nearest;
+		if (!ProjectBounds(boundsMin, boundsMax, world, rect, nearest))
+			return 1.0f;
+
+		const float width = std::clamp(rect.z, 0.0f, (float)m_width) - std::clamp(rect.x, 0.0f, (float)m_width);
+		const float height = std::clamp(rect.w, 0.0f, (float)m_height) - std::clamp(rect.y, 0.0f, (float)m_height);
+		return width * height / ((float)m_width * m_height);
+	}
+
+	DR_TARGET_AVX2 static bool IsTileRowVisibleAVX2(const float* row, uint32_t x0, uint32_t x1, float z)
+	{
+		// row starts at the tile, lanes outside [x0, x1) don't count
+		const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		const __m256 inRect = _mm256_and_ps(
+			_mm256_cmp_ps(lane, _mm256_set1_ps((float)x0), _CMP_GE_OQ),
+			_mm256_cmp_ps(lane, _mm256_set1_ps((float)x1), _CMP_LT_OQ));
+		const __m256 behind = _mm256_cmp_ps(_mm256_loadu_ps(row), _mm256_set1_ps(z), _CMP_LE_OQ);
+		return _mm256_movemask_ps(_mm256_and_ps(inRect, behind)) != 0;
+	}
+
+	bool OcclusionCuller::IsRectVisible(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, float z) const
+	{
+		// a tile whose farthest pixel is still in front of the box hides its part, the rest is checked per pixel
+		for (uint32_t ty = y0 / s_tileHeight; ty <= (y1 - 1) / s_tileHeight; ty++)
+		{
+			for (uint32_t tx = x0 / s_tileWidth; tx <= (x1 - 1) / s_tileWidth; tx++)
+			{
+				if (m_tileMinDepth[ty * m_tileCountX + tx] > z)
+					continue;
+
+				const uint32_t tileX = tx * s_tileWidth;
+				const uint32_t px0 = std::max(x0, tileX) - tileX;
+				const uint32_t px1 = std::min(x1, tileX + s_tileWidth) - tileX;
+				const uint32_t py0 = std::max(y0, ty * s_tileHeight);
+				const uint32_t py1 = std::min(y1, (ty + 1) * s_tileHeight);
+				for (uint32_t y = py0; y < py1; y++)
+				{
+					const float* row = &m_depth[(size_t)y * m_width + tileX];
+					if (m_avx2)
+					{
+						if (IsTileRowVisibleAVX2(row, px0, px1, z))
+							return true;
+						continue;
+					}
+
+					for (uint32_t x = px0; x < px1; x++)
+					{
+						if (row[x] <= z)
+							return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	bool OcclusionCuller::HasAVX2()
+	{
+#if defined(_MSC_VER)
+		// avx2 (leaf 7) and the os saving ymm registers (osxsave, xcr0)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+}
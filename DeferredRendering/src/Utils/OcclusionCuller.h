@@ -0,0 +1,110 @@
+#pragma once
+#include "Camera.h"
+
+#include <vector>
+
+namespace GDX11
+{
+	class JobSystem;
+}
+
+namespace DRUtils
+{
+	struct OcclusionCullerDesc
+	{
+		// depth buffer resolution, rounded up to whole tiles
+		uint32_t width = 320;
+		uint32_t height = 192;
+		// the screen is split into binCountX x binCountY bins, each rasterised by one job
+		uint32_t binCountX = 4;
+		uint32_t binCountY = 4;
+	};
+
+	struct OcclusionCullStats
+	{
+		uint32_t occluderCount = 0;
+		uint32_t occluderTriangleCount = 0;
+		uint32_t rasterizedTriangleCount = 0; // after backface, frustum and near plane clipping
+		uint32_t testedCount = 0;
+		uint32_t occludedCount = 0;
+		float rasterTime = 0.0f; // ms, transform, binning and rasterisation
+
+		float GetOccludedRatio() const { return testedCount ? (float)occludedCount / testedCount : 0.0f; }
+	};
+
+	// cpu depth buffer in the spirit of masked occlusion culling: a few big occluders are rasterised at low
+	// resolution, occludee bounds are tested against it before they're drawn. stores 1/w, bigger is nearer
+	// and 0 is empty. occluders only write the pixels they cover completely, at the farthest depth in each one, so
+	// tests stay conservative. the cost is that pixels along edges shared by two triangles are left empty.
+	// rows are 8 pixels at a time with avx2, scalar where the cpu doesn't have it
+	class OcclusionCuller
+	{
+	public:
+		static constexpr uint32_t s_tileWidth = 8;
+		static constexpr uint32_t s_tileHeight = 8;
+
+		OcclusionCuller(const OcclusionCullerDesc& desc = OcclusionCullerDesc());
+		~OcclusionCuller() = default;
+
+		// clears the depth buffer, occluders and stats
+		void Begin(const Camera& camera);
+		// vertexStride in floats, position must be the first 3 floats of a vertex. clockwise triangles are front facing
+		void AddOccluder(const float* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indices, uint32_t indexCount, DirectX::FXMMATRIX world);
+		// bins run as jobs, null rasterises on the calling thread
+		void Rasterize(GDX11::JobSystem* jobSystem = nullptr);
+
+		// mesh local box, false when it's hidden behind the occluders. counts stats, not thread safe
+		bool IsVisible(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, DirectX::FXMMATRIX world);
+		// fraction of the screen the projected box covers, 1 when it crosses the near plane. uses the camera of the last Begin
+		float GetScreenCoverage(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, DirectX::FXMMATRIX world) const;
+
+		const OcclusionCullStats& GetStats() const { return m_stats; }
+		uint32_t GetWidth() const { return m_width; }
+		uint32_t GetHeight() const { return m_height; }
+		// 1/w, row major
+		const std::vector<float>& GetDepth() const { return m_depth; }
+
+		static bool HasAVX2();
+		// false takes the scalar rows, to compare the two. true only when the cpu has avx2
+		void SetAVX2(bool enabled) { m_avx2 = enabled && HasAVX2(); }
+		bool IsAVX2() const { return m_avx2; }
+
+	private:
+		struct Triangle
+		{
+			// screen space x, y (pixels, y down) and 1/w
+			float x[3], y[3], z[3];
+		};
+
+		struct Bin
+		{
+			uint32_t x0, y0, x1, y1; // pixels, multiples of the tile size
+			std::vector<uint32_t> triangles;
+		};
+
+		void AddTriangle(const DirectX::XMFLOAT4 clip[3]);
+		void AddProjected(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+		void RasterizeBin(Bin& bin);
+		void RasterizeTriangle(const Triangle& triangle, const Bin& bin);
+		void RasterizeTriangleAVX2(const Triangle& triangle, const Bin& bin);
+		void UpdateTiles(const Bin& bin);
+		// pixel rect (min x, min y, max x, max y, unclamped) and nearest 1/w, false when the box crosses the near plane
+		bool ProjectBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, DirectX::FXMMATRIX world, DirectX::XMFLOAT4& rect, float& nearest) const;
+		bool IsRectVisible(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, float z) const;
+
+		uint32_t m_width, m_height;
+		uint32_t m_tileCountX, m_tileCountY;
+		uint32_t m_binWidth, m_binHeight, m_binCountX;
+		bool m_avx2;
+
+		DirectX::XMFLOAT4X4 m_viewProjection;
+		float m_nearPlane = 0.1f;
+
+		std::vector<float> m_depth;
+		std::vector<float> m_tileMinDepth; // farthest depth of every tile
+		std::vector<Triangle> m_triangles;
+		std::vector<Bin> m_bins;
+		std::vector<DirectX::XMFLOAT4> m_clipVertices; // AddOccluder scratch
+		OcclusionCullStats m_stats;
+	};
+}
@@ -0,0 +1,44 @@
+#include "ProfilerOverlay.h"
+
+#include <GDX11/Core/Profiler.h>
+#include <GDX11/Core/Log.h>
+#include <imgui.h>
+
+using namespace GDX11;
+
+namespace DRUtils::ProfilerOverlay
+{
+	static void ZoneTable(const char* label, const std::vector<ProfileZone>& zones)
+	{
+		if (!ImGui::CollapsingHeader(label, ImGuiTreeNodeFlags_DefaultOpen))
+			return;
+
+		for (const auto& zone : zones)
+		{
+			ImGui::Text("%*s%s", zone.depth * 2, "", zone.name);
+			ImGui::SameLine(220.0f);
+			ImGui::Text("%.3f ms", (float)(zone.end - zone.begin) * 1e-6f);
+		}
+	}
+
+	void Render()
+	{
+		ImGui::Begin("Profiler");
+
+		const float frameTime = Profiler::GetFrameTime();
+		ImGui::Text("Frame: %.3f ms (%.1f fps)", frameTime, frameTime > 0.0f ? 1000.0f / frameTime : 0.0f);
+		if (Profiler::GetDroppedZoneCount() > 0)
+			ImGui::Text("Dropped zones: %llu", (unsigned long long)Profiler::GetDroppedZoneCount());
+
+		ZoneTable("CPU", Profiler::GetCPUZones());
+		ZoneTable("GPU", Profiler::GetGPUZones());
+
+		if (ImGui::Button("Export trace"))
+		{
+			if (Profiler::ExportChromeTrace("profile.json"))
+				GDX11_LOG_INFO("Profiler trace written to profile.json");
+		}
+
+		ImGui::End();
+	}
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace DRUtils::ProfilerOverlay
+{
+	// per pass cpu/gpu times of the last frame, call between ImGui::NewFrame and ImGui::Render
+	void Render();
+}
@@ -1,6 +1,34 @@
 #pragma once
-#include <GDX11.h>
+#include <GDX11/Core/GDX11Assert.h>
+
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+// the library only holds pointers, declarations are enough and keep it buildable without d3d11 (see the benchmarks)
+namespace GDX11
+{
+	class BlendState;
+	class Buffer;
+	class DepthStencilState;
+	class DepthStencilView;
+	class RasterizerState;
+	class RenderTargetView;
+	using RenderTargetViewArray = std::vector<std::shared_ptr<RenderTargetView>>;
+	class SamplerState;
+	class VertexShader;
+	class GeometryShader;
+	class PixelShader;
+	template<class T>
+	class ShaderPermutations;
+	using VertexShaderPermutations = ShaderPermutations<VertexShader>;
+	using PixelShaderPermutations = ShaderPermutations<PixelShader>;
+	class Texture2D;
+	class InputLayout;
+	class ParameterBlock;
+	class ShaderResourceView;
+}
 
 namespace DRUtils
 {
@@ -16,42 +44,53 @@ namespace DRUtils
 	X(VertexShader) \
 	X(GeometryShader) \
 	X(PixelShader) \
+	X(VertexShaderPermutations) \
+	X(PixelShaderPermutations) \
 	X(Texture2D) \
 	X(InputLayout) \
+	X(ParameterBlock) \
 	X(ShaderResourceView)
 
 
 	class ResourceLibrary
 	{
 	public:
+		// a type that isn't one of the leaf elements has no GetMap overload and doesn't compile
 		template<typename T>
 		void Add(const std::string& key, const std::shared_ptr<T>& res)
 		{
-			static_assert(false);
+			auto& map = GetMap(Tag<T>());
+			GDX11_ASSERT(map.find(key) == map.end(), "Storing Duplicate");
+			map[key] = res;
 		}
 
 		template<typename T>
 		std::shared_ptr<T> Get(const std::string& key) const
 		{
-			static_assert(false);
+			const auto& map = GetMap(Tag<T>());
+			GDX11_ASSERT(map.find(key) != map.end(), "Resource does not exists");
+			return map.at(key);
 		}
 
 		template<typename T>
 		void Remove(const std::string& key)
 		{
-			static_assert(false);
+			auto& map = GetMap(Tag<T>());
+			GDX11_ASSERT(map.find(key) != map.end(), "Resource does not exists");
+			map.erase(key);
 		}
 
 		template<typename T>
 		bool Exist(const std::string& key) const
 		{
-			static_assert(false);
+			const auto& map = GetMap(Tag<T>());
+			return map.find(key) != map.end();
 		}
 
 		template<typename T>
 		void Clear()
 		{
-			static_assert()
+			GetMap(Tag<T>()).clear();
 		}
 
 		void ClearAll()
@@ -61,68 +100,17 @@ namespace DRUtils
 #undef X
 		}
 
-#define X(e) \
-	template<> \
-	void Add<GDX11::e>(const std::string& key, const std::shared_ptr<GDX11::e>& res) \
-	{ \
-		GDX11_ASSERT(m_##e.find(key) == m_##e.end(), "Storing Duplicate"); \
-		m_##e[key] = res; \
-	} 
-
-		LEAF_ELEMENTS
-#undef X
-
-
-
-#define X(e) \
-	template<> \
-	std::shared_ptr<GDX11::e> Get<GDX11::e>(const std::string& key) const \
-	{ \
-		GDX11_ASSERT(m_##e.find(key) != m_##e.end(), "Resource does not exists"); \
-		return m_##e.at(key); \
-	} 
-
-			LEAF_ELEMENTS
-#undef X
-
-
-
-#define X(e) \
-	template<> \
-	void Remove<GDX11::e>(const std::string& key) \
-	{ \
-		GDX11_ASSERT(m_##e.find(key) != m_##e.end(), "Resource does not exists"); \
-		m_##e.erase(key); \
-	}
-
-			LEAF_ELEMENTS
-#undef X
-
-
-
-#define X(e) \
-	template<> \
-	bool Exist<GDX11::e>(const std::string& key) const \
-	{ \
-		return m_##e.find(key) != m_##e.end(); \
-	}
-
-			LEAF_ELEMENTS
-#undef X
-
-
+	private:
+		template<typename T>
+		struct Tag { };
 
 #define X(e) \
-	template<> \
-	void Clear<GDX11::e>() \
-	{ \
-		m_##e.clear(); \
-	} 
+	std::unordered_map<std::string, std::shared_ptr<GDX11::e>>& GetMap(Tag<GDX11::e>) { return m_##e; } \
+	const std::unordered_map<std::string, std::shared_ptr<GDX11::e>>& GetMap(Tag<GDX11::e>) const { return m_##e; }
 
-			LEAF_ELEMENTS
+		LEAF_ELEMENTS
 #undef X
 
-	private:
 #define X(e) std::unordered_map<std::string, std::shared_ptr<GDX11::e>> m_##e;
 		LEAF_ELEMENTS
 #undef X
@@ -130,4 +118,4 @@ namespace DRUtils
 	};
 
 #undef LEAF_ELEMENTS
-}
\ No newline at end of file
+}
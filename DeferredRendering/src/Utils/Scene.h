@@ -0,0 +1,29 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+
+namespace DRUtils
+{
+	struct SceneObject
+	{
+		std::string mesh; // matches the vb./ib. resource and lod chain name
+		DirectX::XMFLOAT3 position = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 rotation = { 0.0f, 0.0f, 0.0f }; // pitch, yaw, roll in degrees
+		float scale = 1.0f;
+
+		uint32_t material = 0; // index into the material table
+
+		uint32_t lod = 0; // selected last frame
+		bool occluder = false; // rasterised by the occlusion culler, big and solid objects only
+		bool dynamic = false; // moves, drawn into the cached shadow cascades every frame instead of kept in their cache
+
+		DirectX::XMMATRIX GetTransform() const
+		{
+			using namespace DirectX;
+			XMVECTOR rotQuatXM = XMQuaternionRotationRollPitchYaw(XMConvertToRadians(rotation.x), XMConvertToRadians(rotation.y), XMConvertToRadians(rotation.z));
+			return XMMatrixScaling(scale, scale, scale) *
+				XMMatrixRotationQuaternion(rotQuatXM) *
+				XMMatrixTranslation(position.x, position.y, position.z);
+		}
+	};
+}
@@ -0,0 +1,294 @@
+#include "SceneBenchmark.h"
+
+#include <GDX11/Core/Log.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace DRUtils::SceneBenchmark
+{
+	Scene Generate(const Desc& desc, const Material& baseMaterial)
+	{
+		uint32_t seed = desc.seed;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24); };
+		auto randomRange = [&](float min, float max) { return min + (max - min) * random(); };
+
+		Scene scene;
+		const uint32_t side = std::max((uint32_t)std::ceil(std::sqrt((float)desc.objectCount)), 1u);
+		scene.extent = side * desc.spacing * 0.5f;
+
+		// materials[0] is the ground
+		Material ground = baseMaterial;
+		ground.tiling = { scene.extent * 0.4f, scene.extent * 0.4f };
+		scene.materials.push_back(ground);
+		const uint32_t tintCount = std::max(desc.materialCount, 1u);
+		for (uint32_t i = 0; i < tintCount; i++)
+		{
+			Material material = baseMaterial;
+			material.diffuseCol = { randomRange(0.4f, 1.0f), randomRange(0.4f, 1.0f), randomRange(0.4f, 1.0f), 1.0f };
+			scene.materials.push_back(material);
+		}
+
+		SceneObject plane;
+		plane.mesh = "plane";
+		plane.position = { 0.0f, -0.5f, 0.0f };
+		plane.scale = 2.0f * (scene.extent + desc.spacing);
+		plane.material = 0;
+		scene.objects.push_back(plane);
+
+		for (uint32_t i = 0; i < desc.objectCount; i++)
+		{
+			SceneObject object;
+			// every 8th is an upright panel, the rest are cubes standing on the ground
+			const bool panel = i % 8 == 7;
+			object.mesh = panel ? "plane" : "cube";
+			object.scale = randomRange(0.5f, 1.5f);
+			object.rotation = { panel ? -90.0f : 0.0f, randomRange(0.0f, 360.0f), 0.0f };
+			object.material = 1 + std::min((uint32_t)(random() * tintCount), tintCount - 1);
+			object.dynamic = !panel && random() < desc.dynamicFraction;
+			object.occluder = !panel && !object.dynamic && object.scale >= 1.0f;
+
+			float x, z;
+			if (desc.layout == Layout::Grid)
+			{
+				x = ((i % side) + 0.5f) * desc.spacing - scene.extent;
+				z = ((i / side) + 0.5f) * desc.spacing - scene.extent;
+			}
+			else
+			{
+				x = randomRange(-scene.extent, scene.extent);
+				z = randomRange(-scene.extent, scene.extent);
+			}
+			object.position = { x, object.scale * 0.5f - 0.5f, z };
+			scene.objects.push_back(object);
+		}
+
+		auto randomPath = [&](float minHeight, float maxHeight)
+		{
+			LightPath path;
+			path.center = { randomRange(-scene.extent, scene.extent), randomRange(minHeight, maxHeight), randomRange(-scene.extent, scene.extent) };
+			path.radius = randomRange(0.5f, 2.0f * desc.spacing);
+			path.speed = randomRange(0.2f, 1.0f) * (random() < 0.5f ? -1.0f : 1.0f);
+			path.phase = randomRange(0.0f, XM_2PI);
+			return path;
+		};
+
+		// saturated colours, low ambient since dozens of lights can reach a pixel. short ranges keep them local
+		auto randomColor = [&]()
+		{
+			XMFLOAT3 color = { random(), random(), random() };
+			const float maxComponent = std::max(std::max(color.x, color.y), std::max(color.z, 1e-3f));
+			return XMFLOAT3{ color.x / maxComponent, color.y / maxComponent, color.z / maxComponent };
+		};
+
+		for (uint32_t i = 0; i < desc.pointLightCount; i++)
+		{
+			Scene::PointLight light;
+			const XMFLOAT3 color = randomColor();
+			light.ambient = { color.x * 0.02f, color.y * 0.02f, color.z * 0.02f };
+			light.diffuse = color;
+			light.specular = color;
+			light.linear = 0.35f;
+			light.quadratic = 0.44f;
+			scene.pointLights.push_back(light);
+			scene.pointLightPaths.push_back(randomPath(1.0f, 4.0f));
+		}
+
+		for (uint32_t i = 0; i < desc.spotLightCount; i++)
+		{
+			Scene::SpotLight light;
+			const XMFLOAT3 color = randomColor();
+			light.ambient = { color.x * 0.02f, color.y * 0.02f, color.z * 0.02f };
+			light.diffuse = color;
+			light.specular = color;
+			light.linear = 0.14f;
+			light.quadratic = 0.07f;
+			light.direction = { 0.0f, -1.0f, 0.0f };
+			scene.spotLights.push_back(light);
+			scene.spotLightPaths.push_back(randomPath(5.0f, 8.0f));
+		}
+
+		Animate(scene, 0.0f);
+		return scene;
+	}
+
+	static XMFLOAT3 GetPathPosition(const LightPath& path, float time)
+	{
+		const float angle = path.phase + path.speed * time;
+		return { path.center.x + path.radius * std::cos(angle), path.center.y, path.center.z + path.radius * std::sin(angle) };
+	}
+
+	void Animate(Scene& scene, float time)
+	{
+		for (size_t i = 0; i < scene.pointLights.size(); i++)
+			scene.pointLights[i].position = GetPathPosition(scene.pointLightPaths[i], time);
+		for (size_t i = 0; i < scene.spotLights.size(); i++)
+			scene.spotLights[i].position = GetPathPosition(scene.spotLightPaths[i], time);
+	}
+
+	void UpdateCamera(const Scene& scene, const Desc& desc, float time, Camera& camera)
+	{
+		// the radius swings between 10% and 90% of the extent twice per loop, the height three times
+		auto pathPosition = [&](float angle)
+		{
+			const float radius = scene.extent * (0.5f + 0.4f * std::cos(2.0f * angle));
+			const float height = 1.5f + 0.3f * scene.extent * (0.5f + 0.5f * std::sin(3.0f * angle));
+			return XMVectorSet(radius * std::cos(angle), height, radius * std::sin(angle), 0.0f);
+		};
+
+		const float angle = XM_2PI * std::fmod(time, desc.cameraLoopTime) / desc.cameraLoopTime;
+		const XMVECTOR position = pathPosition(angle);
+		// halfway between the middle and the ground a bit further along, looks ahead when deep in the scene
+		const XMVECTOR target = XMVectorMultiply(pathPosition(angle + 0.5f), XMVectorSet(0.5f, 0.0f, 0.5f, 0.0f));
+
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSubtract(target, position)));
+
+		CameraDesc cameraDesc = camera.GetDesc();
+		XMStoreFloat3(&cameraDesc.position, position);
+		cameraDesc.yaw = std::atan2(direction.x, direction.z);
+		cameraDesc.pitch = -std::asin(std::clamp(direction.y, -1.0f, 1.0f));
+		camera.Set(cameraDesc);
+	}
+
+	Percentiles GetPercentiles(std::vector<float> values)
+	{
+		Percentiles percentiles = {};
+		if (values.empty())
+			return percentiles;
+
+		std::sort(values.begin(), values.end());
+		auto rank = [&](float p) { return values[std::clamp<size_t>((size_t)std::ceil(p * values.size()), 1, values.size()) - 1]; };
+
+		double sum = 0.0;
+		for (float value : values)
+			sum += value;
+		percentiles.mean = (float)(sum / values.size());
+		percentiles.min = values.front();
+		percentiles.p50 = rank(0.5f);
+		percentiles.p95 = rank(0.95f);
+		percentiles.p99 = rank(0.99f);
+		percentiles.max = values.back();
+		return percentiles;
+	}
+
+	template<typename T>
+	static std::vector<float> Gather(const std::vector<FrameSample>& samples, T FrameSample::* member)
+	{
+		std::vector<float> values;
+		values.reserve(samples.size());
+		for (const auto& sample : samples)
+			values.push_back((float)(sample.*member));
+		return values;
+	}
+
+	// frames without a gpu time left out, they'd pull the percentiles to 0
+	static std::vector<float> GatherGPUTimes(const std::vector<FrameSample>& samples)
+	{
+		std::vector<float> values;
+		for (const auto& sample : samples)
+		{
+			if (sample.gpuTime > 0.0f)
+				values.push_back(sample.gpuTime);
+		}
+		return values;
+	}
+
+	bool WriteJSON(const std::string& filepath, const Desc& desc, const std::string& device, const std::vector<FrameSample>& samples)
+	{
+		std::ofstream file(filepath, std::ios::out | std::ios::trunc);
+		if (!file)
+		{
+			GDX11_LOG_ERROR("Failed to open {0} for the benchmark results", filepath);
+			return false;
+		}
+
+		auto writeString = [&](const std::string& string)
+		{
+			file << '"';
+			for (char c : string)
+			{
+				if (c == '"' || c == '\\')
+					file << '\\';
+				file << c;
+			}
+			file << '"';
+		};
+
+		auto writePercentiles = [&](const Percentiles& p)
+		{
+			file << "{\"mean\":" << p.mean << ",\"min\":" << p.min << ",\"p50\":" << p.p50 << ",\"p95\":" << p.p95
+				<< ",\"p99\":" << p.p99 << ",\"max\":" << p.max << "}";
+		};
+
+		file.precision(3);
+		file << std::fixed;
+		file << "{\n\"scene\":{\"objects\":" << desc.objectCount << ",\"point_lights\":" << desc.pointLightCount << ",\"spot_lights\":" << desc.spotLightCount
+			<< ",\"layout\":\"" << (desc.layout == Layout::Grid ? "grid" : "random") << "\",\"seed\":" << desc.seed << ",\"spacing\":" << desc.spacing
+			<< ",\"dynamic_fraction\":" << desc.dynamicFraction << ",\"materials\":" << desc.materialCount
+			<< ",\"warmup_frames\":" << desc.warmupFrames << ",\"frames\":" << desc.frameCount << ",\"time_step\":" << desc.timeStep << "},\n";
+		file << "\"device\":";
+		writeString(device);
+		file << ",\n\"cpu_ms\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::cpuTime)));
+		// gpu times are only recorded with GDX11_PROFILE
+		const std::vector<float> gpuTimes = GatherGPUTimes(samples);
+		file << ",\n\"gpu_ms\":";
+		if (!gpuTimes.empty())
+			writePercentiles(GetPercentiles(gpuTimes));
+		else
+			file << "null";
+		file << ",\n\"draws\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::drawCount)));
+		file << ",\n\"state_changes\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::stateChangeCount)));
+		file << ",\n\"uploaded_bytes\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::uploadedBytes)));
+		file << ",\n\"visible_meshlets\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::visibleMeshletCount)));
+		file << ",\n\"visible_triangles\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::visibleTriangleCount)));
+		file << ",\n\"occluded_objects\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::occludedCount)));
+		file << ",\n\"occlusion_raster_ms\":";
+		writePercentiles(GetPercentiles(Gather(samples, &FrameSample::occlusionRasterTime)));
+
+		file << ",\n\"samples\":[";
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			const FrameSample& s = samples[i];
+			file << (i ? ",\n" : "\n") << "{\"cpu_ms\":" << s.cpuTime << ",\"gpu_ms\":" << s.gpuTime << ",\"draws\":" << s.drawCount
+				<< ",\"indices\":" << s.indexCount << ",\"state_changes\":" << s.stateChangeCount << ",\"skipped_state_changes\":" << s.skippedStateChangeCount
+				<< ",\"uploaded_bytes\":" << s.uploadedBytes << ",\"visible_objects\":" << s.visibleObjectCount << ",\"visible_lights\":" << s.visibleLightCount
+				<< ",\"meshlets\":" << s.meshletCount << ",\"visible_meshlets\":" << s.visibleMeshletCount << ",\"frustum_culled_meshlets\":" << s.frustumCulledMeshletCount
+				<< ",\"backface_culled_meshlets\":" << s.backfaceCulledMeshletCount << ",\"triangles\":" << s.triangleCount << ",\"visible_triangles\":" << s.visibleTriangleCount
+				<< ",\"occlusion_tested\":" << s.occlusionTestedCount << ",\"occluded\":" << s.occludedCount << ",\"occlusion_raster_ms\":" << s.occlusionRasterTime << "}";
+		}
+		file << "\n]}\n";
+
+		return file.good();
+	}
+
+	void Log(const std::vector<FrameSample>& samples)
+	{
+		const Percentiles cpu = GetPercentiles(Gather(samples, &FrameSample::cpuTime));
+		const Percentiles gpu = GetPercentiles(GatherGPUTimes(samples));
+		const Percentiles draws = GetPercentiles(Gather(samples, &FrameSample::drawCount));
+		const Percentiles stateChanges = GetPercentiles(Gather(samples, &FrameSample::stateChangeCount));
+		const Percentiles uploadedBytes = GetPercentiles(Gather(samples, &FrameSample::uploadedBytes));
+		GDX11_LOG_INFO("Benchmark: {0} frames, cpu p50 {1:.3f} p95 {2:.3f} p99 {3:.3f} ms, gpu p50 {4:.3f} p95 {5:.3f} p99 {6:.3f} ms",
+			samples.size(), cpu.p50, cpu.p95, cpu.p99, gpu.p50, gpu.p95, gpu.p99);
+		GDX11_LOG_INFO("Benchmark: {0:.0f} draws, {1:.0f} state changes, {2:.1f} KB uploaded per frame on average",
+			draws.mean, stateChanges.mean, uploadedBytes.mean / 1024.0f);
+		const Percentiles meshlets = GetPercentiles(Gather(samples, &FrameSample::meshletCount));
+		const Percentiles visibleMeshlets = GetPercentiles(Gather(samples, &FrameSample::visibleMeshletCount));
+		const Percentiles triangles = GetPercentiles(Gather(samples, &FrameSample::triangleCount));
+		const Percentiles visibleTriangles = GetPercentiles(Gather(samples, &FrameSample::visibleTriangleCount));
+		const Percentiles tested = GetPercentiles(Gather(samples, &FrameSample::occlusionTestedCount));
+		const Percentiles occluded = GetPercentiles(Gather(samples, &FrameSample::occludedCount));
+		GDX11_LOG_INFO("Benchmark: {0:.0f} / {1:.0f} meshlets, {2:.0f} / {3:.0f} triangles visible, {4:.0f} / {5:.0f} objects occluded per frame on average",
+			visibleMeshlets.mean, meshlets.mean, visibleTriangles.mean, triangles.mean, occluded.mean, tested.mean);
+	}
+}
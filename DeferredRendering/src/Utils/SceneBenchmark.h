@@ -0,0 +1,101 @@
+#pragma once
+#include "Camera.h"
+#include "CBufs.h"
+#include "MaterialTable.h"
+#include "Scene.h"
+
+#include <string>
+#include <vector>
+
+namespace DRUtils::SceneBenchmark
+{
+	enum class Layout
+	{
+		Grid, Random
+	};
+
+	struct Desc
+	{
+		uint32_t objectCount = 1024;
+		uint32_t pointLightCount = 64;
+		uint32_t spotLightCount = 16;
+		Layout layout = Layout::Grid;
+		uint32_t seed = 1;
+		float spacing = 3.0f;		  // between grid cells, the random layout scatters over the same square
+		float dynamicFraction = 0.1f; // objects that spin and are redrawn into the cached shadows every frame
+		uint32_t materialCount = 8;	  // tints of the base material
+
+		uint32_t warmupFrames = 60; // rendered but not recorded
+		uint32_t frameCount = 600;	// recorded
+		// s per frame. the scene and camera advance by this whatever the frame took, so every run renders the same frames
+		float timeStep = 1.0f / 60.0f;
+		float cameraLoopTime = 20.0f; // s per camera path loop
+	};
+
+	// a horizontal circle, the light is at center + radius * (cos, 0, sin)(phase + speed * t)
+	struct LightPath
+	{
+		DirectX::XMFLOAT3 center;
+		float radius;
+		float speed; // rad/s, negative goes the other way
+		float phase;
+	};
+
+	struct Scene
+	{
+		using PointLight = CBuf::PS::deferred_lighting::SystemCBuf::PointLight;
+		using SpotLight = CBuf::PS::deferred_lighting::SystemCBuf::SpotLight;
+
+		std::vector<SceneObject> objects; // ground plane first. material indexes materials
+		std::vector<Material> materials;
+		std::vector<PointLight> pointLights;
+		std::vector<SpotLight> spotLights;
+		std::vector<LightPath> pointLightPaths; // one per light
+		std::vector<LightPath> spotLightPaths;
+		float extent; // half size of the square the objects are in, centered on the origin
+	};
+
+	// same desc, same scene. materials are baseMaterial with a diffuse tint each
+	Scene Generate(const Desc& desc, const Material& baseMaterial);
+	// lights to where their paths are at time s
+	void Animate(Scene& scene, float time);
+	// a closed loop that circles the scene and dips into it, looking at the middle
+	void UpdateCamera(const Scene& scene, const Desc& desc, float time, Camera& camera);
+
+	struct FrameSample
+	{
+		float cpuTime; // ms, frame start to present returning
+		float gpuTime; // ms, newest frame the gpu finished, 0 without gpu timings or when none finished since the last sample
+		uint64_t drawCount;
+		uint64_t indexCount;
+		uint64_t stateChangeCount;
+		uint64_t skippedStateChangeCount;
+		uint64_t uploadedBytes;
+		uint32_t visibleObjectCount;
+		uint32_t visibleLightCount;
+		// MeshletCullStats of the frame
+		uint32_t meshletCount;
+		uint32_t visibleMeshletCount;
+		uint32_t frustumCulledMeshletCount;
+		uint32_t backfaceCulledMeshletCount;
+		uint32_t triangleCount;
+		uint32_t visibleTriangleCount;
+		// OcclusionCullStats of the frame
+		uint32_t occlusionTestedCount;
+		uint32_t occludedCount;
+		float occlusionRasterTime; // ms
+	};
+
+	struct Percentiles
+	{
+		float mean, min, p50, p95, p99, max;
+	};
+
+	// nearest rank, zeros without values
+	Percentiles GetPercentiles(std::vector<float> values);
+
+	// desc, device, cpu and gpu percentiles, count and cull percentiles and every frame. false if the file can't be written
+	bool WriteJSON(const std::string& filepath, const Desc& desc, const std::string& device, const std::vector<FrameSample>& samples);
+	// percentiles and counts to the client log
+	void Log(const std::vector<FrameSample>& samples);
+}
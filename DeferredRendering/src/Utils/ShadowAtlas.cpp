@@ -0,0 +1,361 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	namespace
+	{
+		uint32_t FloorPow2(uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result * 2 <= value)
+				result *= 2;
+			return result;
+		}
+
+		uint32_t Log2(uint32_t value)
+		{
+			uint32_t result = 0;
+			while (value > 1)
+			{
+				value >>= 1;
+				result++;
+			}
+			return result;
+		}
+
+		uint32_t Pack(uint32_t x, uint32_t y) { return y << 16 | x; }
+	}
+
+	ShadowAtlas::ShadowAtlas(const ShadowAtlasDesc& desc)
+	{
+		Set(desc);
+	}
+
+	void ShadowAtlas::Set(const ShadowAtlasDesc& desc)
+	{
+		// power of two squares so the quadtree splits evenly, 16 bits per packed coordinate
+		m_desc = desc;
+		m_desc.size = FloorPow2(std::clamp(m_desc.size, 16u, 32768u));
+		m_desc.maxTileSize = FloorPow2(std::clamp(m_desc.maxTileSize, 1u, m_desc.size));
+		m_desc.minTileSize = FloorPow2(std::clamp(m_desc.minTileSize, 1u, m_desc.maxTileSize));
+
+		m_levelCount = Log2(m_desc.size / m_desc.minTileSize) + 1;
+		m_freeLists.assign(m_levelCount, {});
+		m_freeLists[0].push_back(Pack(0, 0));
+		m_lights.clear();
+	}
+
+	void ShadowAtlas::Update(const std::vector<ShadowLight>& lights, const std::vector<XMFLOAT4>& movedCasters)
+	{
+		m_frame++;
+		m_stats = {};
+		m_stats.lightCount = (uint32_t)lights.size();
+		m_frameLights = lights;
+
+		for (const auto& light : lights)
+		{
+			LightState& state = m_lights[light.id];
+			const ShadowLight& last = state.light;
+			const bool changed = light.type != last.type ||
+				light.position.x != last.position.x || light.position.y != last.position.y || light.position.z != last.position.z ||
+				light.range != last.range ||
+				(light.type == ShadowLightType::Spot && (light.direction.x != last.direction.x || light.direction.y != last.direction.y ||
+					light.direction.z != last.direction.z || light.outerCutOffAngleCos != last.outerCutOffAngleCos));
+			if (changed)
+			{
+				for (auto& tile : state.tiles)
+					tile.dirty = true;
+			}
+
+			state.light = light;
+			state.frame = m_frame;
+		}
+
+		for (auto it = m_lights.begin(); it != m_lights.end();)
+		{
+			if (it->second.frame != m_frame)
+			{
+				FreeTiles(it->second);
+				it = m_lights.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		// the important lights pick their tile size first
+		std::vector<uint32_t> order(lights.size());
+		for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return lights[a].importance > lights[b].importance; });
+
+		for (uint32_t i : order)
+		{
+			LightState& state = m_lights[lights[i].id];
+			const uint32_t viewCount = GetViewCount(state.light.type);
+
+			// tile edge follows the light's extent on screen
+			const float ideal = m_desc.maxTileSize * std::sqrt(std::clamp(state.light.importance, 0.0f, 1.0f));
+			uint32_t target = m_desc.minTileSize;
+			while (target < ideal && target < m_desc.maxTileSize)
+				target *= 2;
+
+			if (state.tileSize && (state.tiles.size() != viewCount || (target < state.tileSize && ideal < state.tileSize * m_desc.shrinkThreshold)))
+				FreeTiles(state);
+
+			if (target > state.tileSize)
+			{
+				// a smaller size when the atlas is full, growing keeps the old tiles if there's no room for bigger ones
+				std::vector<Tile> tiles;
+				for (uint32_t size = target; size >= m_desc.minTileSize && size > state.tileSize; size /= 2)
+				{
+					if (AllocateTiles(viewCount, size, tiles))
+					{
+						FreeTiles(state);
+						state.tiles = std::move(tiles);
+						state.tileSize = size;
+						break;
+					}
+				}
+
+				if (!state.tileSize)
+					m_stats.allocationFailures++;
+			}
+		}
+
+		// views of this frame's lights, in light order
+		m_views.clear();
+		m_firstViews.assign(lights.size(), -1);
+		std::vector<Tile*> viewTiles;
+		for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+		{
+			LightState& state = m_lights[lights[i].id];
+			if (!state.tiles.empty())
+				m_firstViews[i] = (int32_t)m_views.size();
+			for (uint32_t face = 0; face < (uint32_t)state.tiles.size(); face++)
+			{
+				Tile& tile = state.tiles[face];
+				if (!tile.dirty)
+				{
+					for (const auto& caster : movedCasters)
+					{
+						if (IsSphereInView(state.light, face, XMLoadFloat4(&caster), caster.w))
+						{
+							tile.dirty = true;
+							break;
+						}
+					}
+				}
+
+				ShadowAtlasView view;
+				XMStoreFloat4x4(&view.viewProjection, GetViewProjection(state.light, face, m_desc.nearPlane));
+				view.atlasRect = {
+					(float)state.tileSize / m_desc.size, (float)state.tileSize / m_desc.size,
+					(float)tile.x / m_desc.size, (float)tile.y / m_desc.size };
+				view.x = tile.x;
+				view.y = tile.y;
+				view.size = state.tileSize;
+				view.light = i;
+				view.face = face;
+				m_views.push_back(view);
+				viewTiles.push_back(&tile);
+			}
+			m_stats.allocatedTexels += (uint64_t)state.tileSize * state.tileSize * state.tiles.size();
+		}
+
+		// views without contents first, the light has no shadow until all of them are rendered
+		std::vector<std::pair<float, uint32_t>> candidates;
+		for (uint32_t i = 0; i < (uint32_t)m_views.size(); i++)
+		{
+			const Tile& tile = *viewTiles[i];
+			if (!tile.dirty)
+				continue;
+
+			const float priority = (tile.valid ? 0.0f : 1e6f) + lights[m_views[i].light].importance + tile.wait * m_desc.agingRate;
+			candidates.emplace_back(priority, i);
+		}
+		std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		m_stats.dirtyViewCount = (uint32_t)candidates.size();
+		m_renderViews.clear();
+		for (const auto& [priority, view] : candidates)
+		{
+			Tile& tile = *viewTiles[view];
+			if (m_renderViews.size() < m_desc.viewBudget)
+			{
+				tile.dirty = false;
+				tile.valid = true;
+				tile.wait = 0;
+				m_renderViews.push_back(view);
+			}
+			else
+			{
+				tile.wait++;
+				m_stats.maxWait = std::max(m_stats.maxWait, tile.wait);
+			}
+		}
+		m_stats.renderedViewCount = (uint32_t)m_renderViews.size();
+
+		for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+		{
+			const LightState& state = m_lights[lights[i].id];
+			bool valid = !state.tiles.empty();
+			for (const auto& tile : state.tiles)
+				valid &= tile.valid;
+
+			if (valid)
+				m_stats.shadowedLightCount++;
+			else
+				m_firstViews[i] = -1;
+		}
+	}
+
+	bool ShadowAtlas::IsCasterVisible(uint32_t view, const XMFLOAT3& center, float radius) const
+	{
+		const ShadowAtlasView& v = m_views[view];
+		return IsSphereInView(m_frameLights[v.light], v.face, XMLoadFloat3(&center), radius);
+	}
+
+	bool ShadowAtlas::Allocate(uint32_t size, uint32_t& x, uint32_t& y)
+	{
+		const uint32_t level = Log2(m_desc.size / size);
+		int32_t source = (int32_t)level;
+		while (source >= 0 && m_freeLists[source].empty())
+			source--;
+		if (source < 0)
+			return false;
+
+		const uint32_t packed = m_freeLists[source].back();
+		m_freeLists[source].pop_back();
+		x = packed & 0xffff;
+		y = packed >> 16;
+
+		// split down to the size, keeping the top left quarter
+		for (uint32_t l = (uint32_t)source + 1; l <= level; l++)
+		{
+			const uint32_t half = m_desc.size >> l;
+			m_freeLists[l].push_back(Pack(x + half, y));
+			m_freeLists[l].push_back(Pack(x, y + half));
+			m_freeLists[l].push_back(Pack(x + half, y + half));
+		}
+
+		return true;
+	}
+
+	void ShadowAtlas::Free(uint32_t x, uint32_t y, uint32_t size)
+	{
+		uint32_t level = Log2(m_desc.size / size);
+		while (level > 0)
+		{
+			// merge with the 3 siblings when they're all free
+			const uint32_t half = m_desc.size >> level;
+			const uint32_t parentX = x & ~(2 * half - 1);
+			const uint32_t parentY = y & ~(2 * half - 1);
+			auto& freeList = m_freeLists[level];
+			uint32_t siblings[3];
+			uint32_t siblingCount = 0;
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				const uint32_t packed = Pack(parentX + (i & 1) * half, parentY + (i >> 1) * half);
+				if (packed != Pack(x, y))
+					siblings[siblingCount++] = packed;
+			}
+
+			bool allFree = true;
+			for (uint32_t sibling : siblings)
+				allFree &= std::find(freeList.begin(), freeList.end(), sibling) != freeList.end();
+			if (!allFree)
+				break;
+
+			for (uint32_t sibling : siblings)
+				freeList.erase(std::find(freeList.begin(), freeList.end(), sibling));
+			x = parentX;
+			y = parentY;
+			level--;
+		}
+
+		m_freeLists[level].push_back(Pack(x, y));
+	}
+
+	bool ShadowAtlas::AllocateTiles(uint32_t count, uint32_t size, std::vector<Tile>& tiles)
+	{
+		tiles.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Tile tile;
+			if (!Allocate(size, tile.x, tile.y))
+			{
+				for (const auto& allocated : tiles)
+					Free(allocated.x, allocated.y, size);
+				tiles.clear();
+				return false;
+			}
+			tiles.push_back(tile);
+		}
+
+		return true;
+	}
+
+	void ShadowAtlas::FreeTiles(LightState& state)
+	{
+		for (const auto& tile : state.tiles)
+			Free(tile.x, tile.y, state.tileSize);
+		state.tiles.clear();
+		state.tileSize = 0;
+	}
+
+	bool ShadowAtlas::IsSphereInView(const ShadowLight& light, uint32_t face, FXMVECTOR center, float radius)
+	{
+		const XMVECTOR toCenter = XMVectorSubtract(center, XMLoadFloat3(&light.position));
+		const float distance = XMVectorGetX(XMVector3Length(toCenter));
+		if (distance > light.range + radius)
+			return false;
+
+		if (light.type == ShadowLightType::Point)
+		{
+			// the face's pyramid, |other axes| <= its axis, planes tilted 45 degrees
+			XMFLOAT3 v;
+			XMStoreFloat3(&v, toCenter);
+			const float axes[3] = { v.x, v.y, v.z };
+			const uint32_t axis = face / 2;
+			const float along = (face & 1) ? -axes[axis] : axes[axis];
+			const float slack = radius * 1.41421356f;
+			return along - std::abs(axes[(axis + 1) % 3]) >= -slack && along - std::abs(axes[(axis + 2) % 3]) >= -slack;
+		}
+
+		// distance to the cone's surface
+		const float along = XMVectorGetX(XMVector3Dot(toCenter, XMVector3Normalize(XMLoadFloat3(&light.direction))));
+		if (along < -radius)
+			return false;
+		const float cosAngle = light.outerCutOffAngleCos;
+		const float sinAngle = std::sqrt(std::max(1.0f - cosAngle * cosAngle, 0.0f));
+		const float perpendicular = std::sqrt(std::max(distance * distance - along * along, 0.0f));
+		return perpendicular * cosAngle - along * sinAngle <= radius;
+	}
+
+	XMMATRIX ShadowAtlas::GetViewProjection(const ShadowLight& light, uint32_t face, float nearPlane)
+	{
+		const XMVECTOR position = XMLoadFloat3(&light.position);
+		if (light.type == ShadowLightType::Point)
+		{
+			// cube map face order and up vectors
+			static const XMFLOAT3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+			static const XMFLOAT3 ups[6] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+			return XMMatrixLookToLH(position, XMLoadFloat3(&directions[face]), XMLoadFloat3(&ups[face])) *
+				XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, nearPlane, light.range);
+		}
+
+		// wide cones get a narrower shadow frustum, perspective can't reach 180 degrees
+		const XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&light.direction));
+		const XMVECTOR up = std::abs(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		const float halfAngle = std::min(std::acos(std::clamp(light.outerCutOffAngleCos, -1.0f, 1.0f)), XMConvertToRadians(80.0f));
+		return XMMatrixLookToLH(position, direction, up) *
+			XMMatrixPerspectiveFovLH(2.0f * halfAngle, 1.0f, nearPlane, light.range);
+	}
+}
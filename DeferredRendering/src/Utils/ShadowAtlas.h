@@ -0,0 +1,132 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace DRUtils
+{
+	struct ShadowAtlasDesc
+	{
+		uint32_t size = 4096; // atlas width and height
+		uint32_t maxTileSize = 1024; // per view, a point light has 6
+		uint32_t minTileSize = 64;
+		// views rendered per frame at most, the rest keep last frame's contents and wait
+		uint32_t viewBudget = 8;
+		// importance a frame of waiting is worth, keeps the unimportant views from starving
+		float agingRate = 0.1f;
+		float nearPlane = 0.1f;
+		// a tile only shrinks once its ideal size is below this fraction of the current one, so lights on the edge of a size don't keep reallocating
+		float shrinkThreshold = 0.4f;
+	};
+
+	enum class ShadowLightType
+	{
+		Point, Spot
+	};
+
+	struct ShadowLight
+	{
+		uint32_t id = 0; // stable across frames, the atlas keeps the light's tiles under it
+		ShadowLightType type = ShadowLightType::Point;
+		DirectX::XMFLOAT3 position = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 direction = { 0.0f, -1.0f, 0.0f }; // spot only
+		float range = 10.0f; // far plane
+		float outerCutOffAngleCos = 0.9f; // spot only
+		float importance = 0.0f; // [0, 1], screen coverage. sizes the tiles and orders the updates
+	};
+
+	struct ShadowAtlasView
+	{
+		DirectX::XMFLOAT4X4 viewProjection; // world to light clip space
+		DirectX::XMFLOAT4 atlasRect; // tile uv scale xy and offset zw in the atlas
+		uint32_t x, y, size; // tile, atlas pixels
+		uint32_t light; // index into this frame's lights
+		uint32_t face; // +x, -x, +y, -y, +z, -z for point lights
+	};
+
+	struct ShadowAtlasStats
+	{
+		uint32_t lightCount = 0;
+		uint32_t shadowedLightCount = 0; // every view has current contents
+		uint32_t allocationFailures = 0; // lights without room in the atlas even at the smallest tile size
+		uint32_t dirtyViewCount = 0; // before this frame's renders
+		uint32_t renderedViewCount = 0;
+		uint32_t maxWait = 0; // frames the longest waiting dirty view has waited
+		uint64_t allocatedTexels = 0;
+	};
+
+	// point and spot light shadows packed into one depth atlas. tiles are sized by the light's importance and
+	// handed out by a quadtree buddy allocator. a view is only rendered again when its light changed or a caster
+	// inside it moved, and at most viewBudget views are rendered per frame. views without contents go first, the
+	// rest by importance plus the frames they've waited, so the unimportant ones still get their turn. no gpu dependency
+	class ShadowAtlas
+	{
+	public:
+		ShadowAtlas(const ShadowAtlasDesc& desc = ShadowAtlasDesc());
+		~ShadowAtlas() = default;
+
+		// frees every tile
+		void Set(const ShadowAtlasDesc& desc);
+		void SetViewBudget(uint32_t viewBudget) { m_desc.viewBudget = viewBudget; }
+
+		// once per frame. lights missing from the list lose their tiles. movedCasters are world spheres (xyz center,
+		// w radius) of the casters that moved since the last call, where they were and where they are now.
+		// the views returned by GetRenderViews have to be rendered this frame, they count as up to date from here on
+		void Update(const std::vector<ShadowLight>& lights, const std::vector<DirectX::XMFLOAT4>& movedCasters);
+
+		// every view of this frame's lights
+		const std::vector<ShadowAtlasView>& GetViews() const { return m_views; }
+		// indices into GetViews to render this frame, most important first
+		const std::vector<uint32_t>& GetRenderViews() const { return m_renderViews; }
+		// index of the light's first view (6 in a row for a point light), -1 when some of its views have no contents yet
+		int32_t GetFirstView(uint32_t light) const { return m_firstViews[light]; }
+		// world space bounding sphere against the view's volume
+		bool IsCasterVisible(uint32_t view, const DirectX::XMFLOAT3& center, float radius) const;
+
+		const ShadowAtlasDesc& GetDesc() const { return m_desc; }
+		const ShadowAtlasStats& GetStats() const { return m_stats; }
+
+	private:
+		struct Tile
+		{
+			uint32_t x = 0, y = 0;
+			bool dirty = true;
+			bool valid = false; // rendered since the tile was allocated
+			uint32_t wait = 0; // frames dirty
+		};
+
+		struct LightState
+		{
+			ShadowLight light;
+			uint32_t tileSize = 0; // 0 without tiles
+			std::vector<Tile> tiles;
+			uint64_t frame = 0; // last Update the light was in
+		};
+
+		// x, y of a free square of the size, false when the atlas is full
+		bool Allocate(uint32_t size, uint32_t& x, uint32_t& y);
+		void Free(uint32_t x, uint32_t y, uint32_t size);
+		// all or nothing
+		bool AllocateTiles(uint32_t count, uint32_t size, std::vector<Tile>& tiles);
+		void FreeTiles(LightState& state);
+		static uint32_t GetViewCount(ShadowLightType type) { return type == ShadowLightType::Point ? 6 : 1; }
+		static bool IsSphereInView(const ShadowLight& light, uint32_t face, DirectX::FXMVECTOR center, float radius);
+		static DirectX::XMMATRIX GetViewProjection(const ShadowLight& light, uint32_t face, float nearPlane);
+
+		ShadowAtlasDesc m_desc;
+		uint32_t m_levelCount = 0;
+		// free squares per level, level 0 is the whole atlas. packed as y << 16 | x
+		std::vector<std::vector<uint32_t>> m_freeLists;
+
+		std::unordered_map<uint32_t, LightState> m_lights;
+		uint64_t m_frame = 0;
+
+		std::vector<ShadowLight> m_frameLights;
+		std::vector<ShadowAtlasView> m_views;
+		std::vector<uint32_t> m_renderViews;
+		std::vector<int32_t> m_firstViews;
+		ShadowAtlasStats m_stats;
+	};
+}
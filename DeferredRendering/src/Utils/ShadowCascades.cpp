@@ -0,0 +1,126 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	ShadowCascades::ShadowCascades(const ShadowCascadesDesc& desc)
+	{
+		XMStoreFloat4x4(&m_lightView, XMMatrixIdentity());
+		Set(desc);
+	}
+
+	void ShadowCascades::Set(const ShadowCascadesDesc& desc)
+	{
+		m_desc = desc;
+		m_desc.cascadeCount = std::clamp(m_desc.cascadeCount, 1u, s_maxCascades);
+		m_desc.resolution = std::max(m_desc.resolution, 16u);
+		m_staticValid = false;
+	}
+
+	void ShadowCascades::Update(const Camera& camera, const XMFLOAT3& lightDirection)
+	{
+		// the light view is fixed at the origin so texel snapping lines up with the same world grid every frame
+		const XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+		if (!XMVector3Equal(direction, XMLoadFloat3(&m_lightDirection)))
+		{
+			const XMVECTOR up = std::abs(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			XMStoreFloat4x4(&m_lightView, XMMatrixLookToLH(XMVectorZero(), direction, up));
+			XMStoreFloat3(&m_lightDirection, direction);
+			m_staticValid = false;
+		}
+
+		const CameraDesc& cameraDesc = camera.GetDesc();
+		const float nearPlane = cameraDesc.nearPlane;
+		const float farPlane = std::max(std::min(m_desc.maxDistance, cameraDesc.farPlane), nearPlane * 2.0f);
+
+		// corners of a slice at view depth d are d * k away from the view axis
+		const float tanHalfFov = std::tan(cameraDesc.fov * 0.5f);
+		const float k2 = tanHalfFov * tanHalfFov * (1.0f + cameraDesc.aspect * cameraDesc.aspect);
+		const XMMATRIX invView = XMMatrixInverse(nullptr, camera.GetViewMatrix());
+		const XMMATRIX lightView = XMLoadFloat4x4(&m_lightView);
+
+		float splitNear = nearPlane;
+		for (uint32_t i = 0; i < m_desc.cascadeCount; i++)
+		{
+			// practical split scheme, a blend of logarithmic and uniform
+			const float t = (float)(i + 1) / m_desc.cascadeCount;
+			const float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+			const float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+			const float splitFar = m_desc.splitLambda * logSplit + (1.0f - m_desc.splitLambda) * uniformSplit;
+
+			// smallest sphere around the slice has its center on the view axis, equally far from the near and far corners.
+			// past the far plane the far corners alone decide it
+			const float z = std::min(0.5f * (splitNear + splitFar) * (1.0f + k2), splitFar);
+			float radius = std::sqrt(std::max((splitFar - z) * (splitFar - z) + splitFar * splitFar * k2, (z - splitNear) * (z - splitNear) + splitNear * splitNear * k2));
+			// rounded so float noise doesn't change the texel size
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+			const XMVECTOR sliceCenter = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, z, 1.0f), invView);
+
+			ShadowCascade& cascade = m_cascades[i];
+			cascade.splitNear = splitNear;
+			cascade.splitFar = splitFar;
+			cascade.cached = i >= m_desc.cachedCascadeStart;
+			cascade.staticDirty = false;
+			if (!cascade.cached)
+			{
+				Fit(cascade, sliceCenter, radius);
+			}
+			else
+			{
+				// refit only once the slice leaves the cached box
+				XMFLOAT3 center;
+				XMStoreFloat3(&center, XMVector3TransformCoord(sliceCenter, lightView));
+				const bool inside = m_staticValid &&
+					std::abs(center.x - cascade.center.x) + radius <= cascade.extent &&
+					std::abs(center.y - cascade.center.y) + radius <= cascade.extent &&
+					std::abs(center.z - cascade.center.z) + radius <= cascade.extent;
+				if (!inside)
+				{
+					Fit(cascade, sliceCenter, radius * (1.0f + m_desc.cacheMargin));
+					cascade.staticDirty = true;
+					m_staticRenderCount++;
+				}
+			}
+
+			splitNear = splitFar;
+		}
+
+		m_staticValid = true;
+	}
+
+	void ShadowCascades::Fit(ShadowCascade& cascade, FXMVECTOR sliceCenter, float extent)
+	{
+		// one texel of border on each side, snapping moves the box by less than that
+		const float texelSize = 2.0f * extent / (m_desc.resolution - 2);
+		const float halfSize = texelSize * m_desc.resolution * 0.5f;
+
+		const XMMATRIX lightView = XMLoadFloat4x4(&m_lightView);
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3TransformCoord(sliceCenter, lightView));
+		center.x = std::floor(center.x / texelSize) * texelSize;
+		center.y = std::floor(center.y / texelSize) * texelSize;
+
+		const XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+			center.x - halfSize, center.x + halfSize,
+			center.y - halfSize, center.y + halfSize,
+			center.z - halfSize, center.z + halfSize);
+		XMStoreFloat4x4(&cascade.viewProjection, lightView * projection);
+		cascade.center = center;
+		cascade.extent = halfSize;
+		cascade.texelSize = texelSize;
+	}
+
+	bool ShadowCascades::IsCasterVisible(uint32_t cascade, const XMFLOAT3& center, float radius) const
+	{
+		const ShadowCascade& c = m_cascades[cascade];
+		XMFLOAT3 lightCenter;
+		XMStoreFloat3(&lightCenter, XMVector3TransformCoord(XMLoadFloat3(&center), XMLoadFloat4x4(&m_lightView)));
+		return std::abs(lightCenter.x - c.center.x) <= c.extent + radius &&
+			std::abs(lightCenter.y - c.center.y) <= c.extent + radius &&
+			lightCenter.z - radius <= c.center.z + c.extent;
+	}
+}
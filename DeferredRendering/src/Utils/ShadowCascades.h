@@ -0,0 +1,73 @@
+#pragma once
+#include "Camera.h"
+
+#include <cstdint>
+
+namespace DRUtils
+{
+	struct ShadowCascadesDesc
+	{
+		uint32_t cascadeCount = 4; // up to ShadowCascades::s_maxCascades
+		uint32_t resolution = 2048; // per cascade
+		float maxDistance = 60.0f;  // view depth the last cascade ends at
+		float splitLambda = 0.75f;  // 0 = uniform splits, 1 = logarithmic
+
+		// cascades from this one on keep their static casters between frames and only redraw the dynamic ones
+		uint32_t cachedCascadeStart = 2;
+		// cached cascades cover this much more than their slice (relative) so camera movement doesn't refit them every frame
+		float cacheMargin = 0.25f;
+	};
+
+	struct ShadowCascade
+	{
+		DirectX::XMFLOAT4X4 viewProjection; // world to light clip space
+		float splitNear = 0.0f; // view depth
+		float splitFar = 0.0f;
+		DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f }; // light view space, snapped to texels
+		float extent = 0.0f;	  // half size of the ortho box
+		float texelSize = 0.0f; // world units
+
+		bool cached = false;
+		// the cached static casters are out of date, render them into the cache again this frame
+		bool staticDirty = false;
+	};
+
+	// directional light cascades fitted to the camera frustum. each cascade is an ortho box around the bounding sphere
+	// of its frustum slice, so its size doesn't change as the camera rotates, and its position snaps to whole texels so
+	// the shadow edges don't shimmer while it moves. no gpu dependency, feed it cameras and directions to test it
+	class ShadowCascades
+	{
+	public:
+		static constexpr uint32_t s_maxCascades = 4;
+
+		ShadowCascades(const ShadowCascadesDesc& desc = ShadowCascadesDesc());
+		~ShadowCascades() = default;
+
+		// invalidates the cached cascades
+		void Set(const ShadowCascadesDesc& desc);
+
+		// once per frame before the shadow pass. lightDirection points away from the light
+		void Update(const Camera& camera, const DirectX::XMFLOAT3& lightDirection);
+		// static geometry changed, cached cascades render their static casters again on the next Update
+		void InvalidateStatic() { m_staticValid = false; }
+
+		// world space bounding sphere. casters in front of the box still count, the shadow pass clamps them onto its near plane
+		bool IsCasterVisible(uint32_t cascade, const DirectX::XMFLOAT3& center, float radius) const;
+
+		uint32_t GetCascadeCount() const { return m_desc.cascadeCount; }
+		const ShadowCascade& GetCascade(uint32_t cascade) const { return m_cascades[cascade]; }
+		const ShadowCascadesDesc& GetDesc() const { return m_desc; }
+		// times a cached cascade had to render its static casters again
+		uint64_t GetStaticRenderCount() const { return m_staticRenderCount; }
+
+	private:
+		void Fit(ShadowCascade& cascade, DirectX::FXMVECTOR sliceCenter, float extent);
+
+		ShadowCascadesDesc m_desc;
+		ShadowCascade m_cascades[s_maxCascades];
+		DirectX::XMFLOAT4X4 m_lightView;
+		DirectX::XMFLOAT3 m_lightDirection = { 0.0f, 0.0f, 0.0f };
+		bool m_staticValid = false;
+		uint64_t m_staticRenderCount = 0;
+	};
+}
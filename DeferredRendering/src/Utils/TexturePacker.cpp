@@ -0,0 +1,221 @@
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace DRUtils
+{
+	namespace
+	{
+		uint32_t CeilPow2(uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result < value)
+				result *= 2;
+			return result;
+		}
+
+		uint32_t Log2(uint32_t value)
+		{
+			uint32_t result = 0;
+			while (value > 1)
+			{
+				value >>= 1;
+				result++;
+			}
+			return result;
+		}
+
+		uint32_t AlignUp(uint32_t value, uint32_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+	}
+
+	TexturePacker::TexturePacker(const TexturePackerDesc& desc)
+	{
+		Set(desc);
+	}
+
+	void TexturePacker::Set(const TexturePackerDesc& desc)
+	{
+		m_desc = desc;
+		m_desc.atlasPadding = CeilPow2(std::max(m_desc.atlasPadding, 1u));
+		m_desc.atlasSize = AlignUp(std::max(m_desc.atlasSize, 4 * m_desc.atlasPadding), m_desc.atlasPadding);
+		// a padded rect always fits on an empty page
+		m_desc.atlasMaxTextureSize = std::min(m_desc.atlasMaxTextureSize, m_desc.atlasSize - 2 * m_desc.atlasPadding);
+		m_textures.clear();
+		m_indices.clear();
+		m_arrays.clear();
+		m_atlasOccupancy = 0.0f;
+	}
+
+	void TexturePacker::Add(const std::string& name, uint32_t width, uint32_t height, uint32_t format)
+	{
+		if (Exist(name))
+			return;
+
+		m_indices[name] = (uint32_t)m_textures.size();
+		Texture texture;
+		texture.name = name;
+		texture.width = width;
+		texture.height = height;
+		texture.format = format;
+		m_textures.push_back(texture);
+	}
+
+	bool TexturePacker::Pack()
+	{
+		m_arrays.clear();
+		m_atlasOccupancy = 0.0f;
+
+		// slices first, one array per size and format in the order they were added
+		std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> sliceArrays;
+		std::vector<uint32_t> atlasTextures;
+		for (uint32_t i = 0; i < (uint32_t)m_textures.size(); i++)
+		{
+			Texture& texture = m_textures[i];
+			if (texture.width <= m_desc.atlasMaxTextureSize && texture.height <= m_desc.atlasMaxTextureSize)
+			{
+				atlasTextures.push_back(i);
+				continue;
+			}
+
+			const auto key = std::make_tuple(texture.width, texture.height, texture.format);
+			auto it = sliceArrays.find(key);
+			if (it == sliceArrays.end())
+			{
+				TextureArrayLayout layout;
+				layout.width = texture.width;
+				layout.height = texture.height;
+				layout.format = texture.format;
+				it = sliceArrays.emplace(key, (uint32_t)m_arrays.size()).first;
+				m_arrays.push_back(layout);
+			}
+
+			TextureArrayLayout& layout = m_arrays[it->second];
+			texture.placement = { it->second, layout.sliceCount, 0, 0, texture.width, texture.height };
+			texture.ref.rect = { 1.0f, 1.0f, 0.0f, 0.0f };
+			texture.ref.array = it->second;
+			texture.ref.slice = layout.sliceCount++;
+		}
+
+		// tallest first packs the skyline tightest
+		std::stable_sort(atlasTextures.begin(), atlasTextures.end(), [this](uint32_t a, uint32_t b)
+		{
+			const Texture& ta = m_textures[a];
+			const Texture& tb = m_textures[b];
+			return ta.format != tb.format ? ta.format < tb.format : ta.height != tb.height ? ta.height > tb.height : ta.width > tb.width;
+		});
+
+		const uint32_t padding = m_desc.atlasPadding;
+		const float atlasSize = (float)m_desc.atlasSize;
+		std::vector<std::vector<SkylineSegment>> pages;
+		uint32_t atlasArray = UINT32_MAX;
+		uint64_t atlasTexels = 0;
+		uint64_t pageTexels = 0;
+		for (uint32_t index : atlasTextures)
+		{
+			Texture& texture = m_textures[index];
+			if (atlasArray == UINT32_MAX || m_arrays[atlasArray].format != texture.format)
+			{
+				TextureArrayLayout layout;
+				layout.width = m_desc.atlasSize;
+				layout.height = m_desc.atlasSize;
+				layout.format = texture.format;
+				layout.mipLevels = Log2(padding) + 1;
+				layout.atlas = true;
+				atlasArray = (uint32_t)m_arrays.size();
+				m_arrays.push_back(layout);
+				pages.clear();
+			}
+
+			const uint32_t paddedWidth = AlignUp(texture.width + 2 * padding, padding);
+			const uint32_t paddedHeight = AlignUp(texture.height + 2 * padding, padding);
+			uint32_t page = 0, x = 0, y = 0;
+			while (page < (uint32_t)pages.size() && !Insert(pages[page], paddedWidth, paddedHeight, x, y))
+				page++;
+			if (page == (uint32_t)pages.size())
+			{
+				pages.push_back({ { 0, 0, m_desc.atlasSize } });
+				Insert(pages[page], paddedWidth, paddedHeight, x, y);
+				m_arrays[atlasArray].sliceCount++;
+				pageTexels += (uint64_t)m_desc.atlasSize * m_desc.atlasSize;
+			}
+
+			texture.placement = { atlasArray, page, x + padding, y + padding, texture.width, texture.height };
+			texture.ref.rect = { texture.width / atlasSize, texture.height / atlasSize, (x + padding) / atlasSize, (y + padding) / atlasSize };
+			texture.ref.array = atlasArray;
+			texture.ref.slice = page;
+			atlasTexels += (uint64_t)texture.width * texture.height;
+		}
+
+		m_atlasOccupancy = pageTexels ? (float)((double)atlasTexels / pageTexels) : 0.0f;
+		return m_arrays.size() <= m_desc.maxArrays;
+	}
+
+	bool TexturePacker::Insert(std::vector<SkylineSegment>& skyline, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y) const
+	{
+		// lowest top edge, leftmost on ties
+		size_t best = SIZE_MAX;
+		uint32_t bestY = UINT32_MAX;
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			const uint32_t left = skyline[i].x;
+			if (left + width > m_desc.atlasSize)
+				break;
+
+			uint32_t top = 0;
+			for (size_t j = i; j < skyline.size() && skyline[j].x < left + width; j++)
+				top = std::max(top, skyline[j].y);
+
+			if (top + height <= m_desc.atlasSize && top < bestY)
+			{
+				best = i;
+				bestY = top;
+			}
+		}
+
+		if (best == SIZE_MAX)
+			return false;
+
+		x = skyline[best].x;
+		y = bestY;
+
+		// the new segment replaces what it covers, a partly covered segment keeps its right part
+		const uint32_t right = x + width;
+		size_t end = best;
+		while (end < skyline.size() && skyline[end].x + skyline[end].width <= right)
+			end++;
+		if (end < skyline.size() && skyline[end].x < right)
+		{
+			skyline[end].width -= right - skyline[end].x;
+			skyline[end].x = right;
+		}
+		skyline.erase(skyline.begin() + best, skyline.begin() + end);
+		skyline.insert(skyline.begin() + best, { x, y + height, width });
+
+		for (size_t i = 0; i + 1 < skyline.size();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+			{
+				i++;
+			}
+		}
+		return true;
+	}
+
+	void TexturePacker::BlitWrapped(uint32_t* page, uint32_t pageWidth, const uint32_t* image, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint32_t padding)
+	{
+		for (uint32_t row = 0; row < height + 2 * padding; row++)
+		{
+			const uint32_t sourceRow = (row + height - padding % height) % height;
+			uint32_t* destination = page + (size_t)(y - padding + row) * pageWidth + (x - padding);
+			for (uint32_t column = 0; column < width + 2 * padding; column++)
+				destination[column] = image[(size_t)sourceRow * width + (column + width - padding % width) % width];
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DRUtils
+{
+	struct TexturePackerDesc
+	{
+		uint32_t atlasSize = 2048;
+		// textures this size or smaller in both dimensions go into the atlas, the rest get array slices
+		uint32_t atlasMaxTextureSize = 256;
+		// texels of wrapped border around each atlas rect, rounded up to a power of two. rects are aligned to it
+		// and the atlas keeps log2(padding) + 1 mips, so no mip of a rect reads its neighbour
+		uint32_t atlasPadding = 8;
+		// g_buffer.ps has this many Texture2DArray slots
+		uint32_t maxArrays = 4;
+	};
+
+	// where a texture ended up, what the material table uploads
+	struct TextureRef
+	{
+		DirectX::XMFLOAT4 rect = { 1.0f, 1.0f, 0.0f, 0.0f }; // uv scale xy, offset zw in the slice
+		uint32_t array = 0;
+		uint32_t slice = 0;
+	};
+
+	struct TextureArrayLayout
+	{
+		uint32_t width = 0, height = 0;
+		uint32_t format = 0; // DXGI_FORMAT, only compared
+		uint32_t sliceCount = 0;
+		uint32_t mipLevels = 0; // 0 for the full chain
+		bool atlas = false;
+	};
+
+	struct TexturePlacement
+	{
+		uint32_t array = 0, slice = 0;
+		uint32_t x = 0, y = 0; // texels, the image's corner inside the padding. 0 for array slices
+		uint32_t width = 0, height = 0;
+	};
+
+	// plans the texture arrays the g-buffer pass binds once instead of a texture per material. textures with the
+	// same size and format share a Texture2DArray, small ones are packed into atlas pages (skyline, bottom left)
+	// that make one more array per format. no gpu dependency, the caller creates the arrays and copies the texels
+	class TexturePacker
+	{
+	public:
+		TexturePacker(const TexturePackerDesc& desc = TexturePackerDesc());
+		~TexturePacker() = default;
+
+		// drops every texture
+		void Set(const TexturePackerDesc& desc);
+		// names are unique, adding one again is ignored
+		void Add(const std::string& name, uint32_t width, uint32_t height, uint32_t format);
+		// places every texture added so far, false when they need more than maxArrays arrays
+		bool Pack();
+
+		const std::vector<TextureArrayLayout>& GetArrays() const { return m_arrays; }
+		// in Add order
+		uint32_t GetTextureCount() const { return (uint32_t)m_textures.size(); }
+		const std::string& GetName(uint32_t texture) const { return m_textures[texture].name; }
+		const TexturePlacement& GetPlacement(uint32_t texture) const { return m_textures[texture].placement; }
+		const TextureRef& GetRef(const std::string& name) const { return m_textures[m_indices.at(name)].ref; }
+		bool Exist(const std::string& name) const { return m_indices.find(name) != m_indices.end(); }
+		// texels of atlas textures over atlas page texels
+		float GetAtlasOccupancy() const { return m_atlasOccupancy; }
+		const TexturePackerDesc& GetDesc() const { return m_desc; }
+
+		// 4 bytes per texel image into an atlas page at x, y, the padding around it filled with the texels the image
+		// wraps to so tiled materials filter across the rect's edge
+		static void BlitWrapped(uint32_t* page, uint32_t pageWidth, const uint32_t* image, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint32_t padding);
+
+	private:
+		struct Texture
+		{
+			std::string name;
+			uint32_t width, height, format;
+			TexturePlacement placement;
+			TextureRef ref;
+		};
+
+		struct SkylineSegment
+		{
+			uint32_t x, y, width;
+		};
+
+		// x, y of the padded rect's corner, false when the page is full
+		bool Insert(std::vector<SkylineSegment>& skyline, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y) const;
+
+		TexturePackerDesc m_desc;
+		std::vector<Texture> m_textures;
+		std::unordered_map<std::string, uint32_t> m_indices;
+		std::vector<TextureArrayLayout> m_arrays;
+		float m_atlasOccupancy = 0.0f;
+	};
+}
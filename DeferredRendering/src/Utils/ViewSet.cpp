@@ -0,0 +1,157 @@
+#include "ViewSet.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace DRUtils
+{
+	ViewSet::ViewSet()
+	{
+		for (uint32_t view = 0; view < s_maxViewCount; view++)
+		{
+			XMStoreFloat4x4(&m_viewMatrices[view], XMMatrixIdentity());
+			XMStoreFloat4x4(&m_projectionMatrices[view], XMMatrixIdentity());
+		}
+	}
+
+	void ViewSet::SetViewCount(uint32_t count)
+	{
+		m_viewCount = std::min(count, s_maxViewCount);
+	}
+
+	void ViewSet::SetViewMatrix(uint32_t view, FXMMATRIX viewMatrix)
+	{
+		XMStoreFloat4x4(&m_viewMatrices[view], viewMatrix);
+		m_dirty |= 1ull << view;
+	}
+
+	void ViewSet::SetProjectionMatrix(uint32_t view, FXMMATRIX projection)
+	{
+		XMStoreFloat4x4(&m_projectionMatrices[view], projection);
+		m_dirty |= 1ull << view;
+	}
+
+	void ViewSet::SetCamera(uint32_t view, const Camera& camera)
+	{
+		SetViewMatrix(view, camera.GetViewMatrix());
+		SetProjectionMatrix(view, camera.GetProjectionMatrix());
+	}
+
+	void ViewSet::SetViewProjection(uint32_t view, FXMMATRIX viewProjection)
+	{
+		SetViewMatrix(view, XMMatrixIdentity());
+		SetProjectionMatrix(view, viewProjection);
+	}
+
+	void ViewSet::SetNearPlaneCulling(uint32_t view, bool enabled)
+	{
+		if (enabled)
+			m_nearPlaneCulling |= 1ull << view;
+		else
+			m_nearPlaneCulling &= ~(1ull << view);
+		m_dirty |= 1ull << view;
+	}
+
+	XMMATRIX ViewSet::GetViewProjection(uint32_t view) const
+	{
+		Update(view);
+		return XMLoadFloat4x4(&m_viewProjections[view]);
+	}
+
+	void ViewSet::GetFrustumPlanes(uint32_t view, XMFLOAT4 planes[6]) const
+	{
+		Update(view);
+		for (int i = 0; i < 6; i++)
+			planes[i] = { m_planes[i][0][view], m_planes[i][1][view], m_planes[i][2][view], m_planes[i][3][view] };
+	}
+
+	void ViewSet::Cull(const XMFLOAT4* spheres, uint32_t count, uint64_t* masks) const
+	{
+		Update();
+
+		const uint32_t groupCount = (m_viewCount + 3) / 4;
+		const uint64_t viewMask = m_viewCount == s_maxViewCount ? ~0ull : (1ull << m_viewCount) - 1;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const XMVECTOR sphere = XMLoadFloat4(&spheres[i]);
+			const XMVECTOR cx = XMVectorSplatX(sphere);
+			const XMVECTOR cy = XMVectorSplatY(sphere);
+			const XMVECTOR cz = XMVectorSplatZ(sphere);
+			const XMVECTOR cr = XMVectorNegate(XMVectorSplatW(sphere));
+
+			uint64_t mask = 0;
+			for (uint32_t group = 0; group < groupCount; group++)
+			{
+				const uint32_t first = group * 4;
+				XMVECTOR inside = XMVectorTrueInt();
+				for (int p = 0; p < 6; p++)
+				{
+					const XMVECTOR px = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_planes[p][0][first]));
+					const XMVECTOR py = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_planes[p][1][first]));
+					const XMVECTOR pz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_planes[p][2][first]));
+					const XMVECTOR pw = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_planes[p][3][first]));
+					const XMVECTOR d = XMVectorMultiplyAdd(cx, px, XMVectorMultiplyAdd(cy, py, XMVectorMultiplyAdd(cz, pz, pw)));
+					inside = XMVectorAndInt(inside, XMVectorGreater(d, cr));
+				}
+
+				XMUINT4 insideMask;
+				XMStoreUInt4(&insideMask, inside);
+				const uint64_t bits = (insideMask.x & 1) | (insideMask.y & 2) | (insideMask.z & 4) | (insideMask.w & 8);
+				mask |= bits << first;
+			}
+
+			// the lanes past the view count test stale or zero planes
+			masks[i] = mask & viewMask;
+		}
+	}
+
+	void ViewSet::Update(uint32_t view) const
+	{
+		if (!(m_dirty & (1ull << view)))
+			return;
+
+		const XMMATRIX viewProjection = XMLoadFloat4x4(&m_viewMatrices[view]) * XMLoadFloat4x4(&m_projectionMatrices[view]);
+		XMStoreFloat4x4(&m_viewProjections[view], viewProjection);
+
+		// rows of the transposed view projection are its columns
+		const XMMATRIX vp = XMMatrixTranspose(viewProjection);
+		XMVECTOR planes[6] =
+		{
+			vp.r[3] + vp.r[0],
+			vp.r[3] - vp.r[0],
+			vp.r[3] + vp.r[1],
+			vp.r[3] - vp.r[1],
+			vp.r[2],
+			vp.r[3] - vp.r[2],
+		};
+
+		for (int i = 0; i < 6; i++)
+		{
+			XMFLOAT4 plane;
+			XMStoreFloat4(&plane, XMPlaneNormalize(planes[i]));
+			m_planes[i][0][view] = plane.x;
+			m_planes[i][1][view] = plane.y;
+			m_planes[i][2][view] = plane.z;
+			m_planes[i][3][view] = plane.w;
+		}
+
+		// a plane every sphere is in front of
+		if (!(m_nearPlaneCulling & (1ull << view)))
+		{
+			m_planes[4][0][view] = 0.0f;
+			m_planes[4][1][view] = 0.0f;
+			m_planes[4][2][view] = 0.0f;
+			m_planes[4][3][view] = FLT_MAX;
+		}
+
+		m_dirty &= ~(1ull << view);
+	}
+
+	void ViewSet::Update() const
+	{
+		for (uint32_t view = 0; view < m_viewCount; view++)
+			Update(view);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Camera.h"
+
+#include <cstdint>
+
+namespace DRUtils
+{
+	// up to s_maxViewCount views culled together, shadow cascades, atlas tiles, the camera. view and projection
+	// matrices are set per view, the view projections and frustum planes are only rebuilt for views whose
+	// matrices changed and only when something asks for them. the planes are kept as structure of arrays
+	// (plane, component, view), so Cull tests a bounding sphere against 4 views at a time and K views cost one
+	// pass over the objects with K / 4 plane tests each, instead of K passes
+	class ViewSet
+	{
+	public:
+		// a view mask is a uint64_t
+		static constexpr uint32_t s_maxViewCount = 64;
+
+		ViewSet();
+		~ViewSet() = default;
+
+		// views [0, count) take part in Cull, the others keep their matrices. identity until set
+		void SetViewCount(uint32_t count);
+		uint32_t GetViewCount() const { return m_viewCount; }
+
+		void SetViewMatrix(uint32_t view, DirectX::FXMMATRIX viewMatrix);
+		void SetProjectionMatrix(uint32_t view, DirectX::FXMMATRIX projection);
+		void SetCamera(uint32_t view, const Camera& camera);
+		// for views that only have the product, shadow views. the view matrix is identity
+		void SetViewProjection(uint32_t view, DirectX::FXMMATRIX viewProjection);
+		// off: spheres in front of the near plane still count, for shadow passes that clamp casters onto it. on by default
+		void SetNearPlaneCulling(uint32_t view, bool enabled);
+
+		DirectX::XMMATRIX GetViewMatrix(uint32_t view) const { return DirectX::XMLoadFloat4x4(&m_viewMatrices[view]); }
+		DirectX::XMMATRIX GetProjectionMatrix(uint32_t view) const { return DirectX::XMLoadFloat4x4(&m_projectionMatrices[view]); }
+		DirectX::XMMATRIX GetViewProjection(uint32_t view) const;
+		// normalized, pointing inward. left, right, bottom, top, near, far
+		void GetFrustumPlanes(uint32_t view, DirectX::XMFLOAT4 planes[6]) const;
+
+		// spheres are world space, xyz center and w radius. bit v of masks[i] is set when sphere i touches view v
+		void Cull(const DirectX::XMFLOAT4* spheres, uint32_t count, uint64_t* masks) const;
+
+	private:
+		void Update(uint32_t view) const;
+		// rebuilds the dirty views
+		void Update() const;
+
+		uint32_t m_viewCount = 0;
+
+		DirectX::XMFLOAT4X4 m_viewMatrices[s_maxViewCount];
+		DirectX::XMFLOAT4X4 m_projectionMatrices[s_maxViewCount];
+		uint64_t m_nearPlaneCulling = ~0ull;
+
+		// derived, rebuilt lazily from the set matrices
+		mutable uint64_t m_dirty = ~0ull;
+		mutable DirectX::XMFLOAT4X4 m_viewProjections[s_maxViewCount];
+		// [plane][x, y, z, w][view]
+		alignas(16) mutable float m_planes[6][4][s_maxViewCount] = {};
+	};
+}
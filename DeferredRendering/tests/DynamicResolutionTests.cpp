@@ -0,0 +1,94 @@
+#include "Test.h"
+
+#include <GDX11/Core/DynamicResolution.h>
+
+#include <cmath>
+
+using namespace GDX11;
+
+// gpu time of a frame that costs baseTime at full resolution, linear in the pixel count
+static float FrameTime(float baseTime, float scale)
+{
+	return baseTime * scale * scale;
+}
+
+DR_TEST(DynamicResolutionStaysAtMaxWithinBudget)
+{
+	DynamicResolution resolution;
+	for (int i = 0; i < 200; i++)
+		DR_CHECK_EQUAL(resolution.Update(10.0f), 1.0f);
+}
+
+DR_TEST(DynamicResolutionConvergesOnTheBudget)
+{
+	DynamicResolutionDesc desc;
+	desc.targetFrameTime = 16.0f;
+	DynamicResolution resolution(desc);
+
+	// 25 ms at full resolution needs about sqrt(16 / 25) = 0.8 per axis
+	float scale = 1.0f;
+	for (int i = 0; i < 400; i++)
+		scale = resolution.Update(FrameTime(25.0f, scale));
+
+	DR_CHECK(scale < 1.0f);
+	DR_CHECK(FrameTime(25.0f, scale) <= desc.targetFrameTime * 1.05f);
+	// scaled down no further than the step and the band under the target allow
+	DR_CHECK(FrameTime(25.0f, scale + 2.0f * desc.scaleStep) > desc.targetFrameTime * (1.0f - desc.deadband));
+}
+
+DR_TEST(DynamicResolutionReportsQuantizedScales)
+{
+	DynamicResolution resolution;
+
+	// a slowly varying load, every scale the render graph sees is a multiple of the step or a range end
+	const float step = resolution.GetDesc().scaleStep;
+	float scale = 1.0f;
+	uint32_t changes = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		const float load = 20.0f + 10.0f * std::sin(i * 0.01f);
+		const float next = resolution.Update(FrameTime(load, scale));
+		changes += next != scale ? 1 : 0;
+		scale = next;
+
+		const float steps = scale / step;
+		DR_CHECK(std::abs(steps - std::round(steps)) < 1e-3f || scale == resolution.GetDesc().minScale || scale == resolution.GetDesc().maxScale);
+	}
+
+	// hysteresis, the scale moves far less often than it's updated
+	DR_CHECK(changes > 0);
+	DR_CHECK(changes < 200);
+}
+
+DR_TEST(DynamicResolutionClampsToTheRange)
+{
+	DynamicResolutionDesc desc;
+	desc.minScale = 0.6f;
+	DynamicResolution resolution(desc);
+
+	float scale = 1.0f;
+	for (int i = 0; i < 400; i++)
+		scale = resolution.Update(100.0f);
+	DR_CHECK_EQUAL(scale, 0.6f);
+
+	for (int i = 0; i < 2000; i++)
+		scale = resolution.Update(1.0f);
+	DR_CHECK_EQUAL(scale, 1.0f);
+}
+
+DR_TEST(DynamicResolutionIgnoresMissingSamples)
+{
+	DynamicResolution resolution;
+	for (int i = 0; i < 50; i++)
+		resolution.Update(40.0f);
+
+	const float scale = resolution.GetScale();
+	const float smoothed = resolution.GetSmoothedFrameTime();
+	for (int i = 0; i < 50; i++)
+		DR_CHECK_EQUAL(resolution.Update(0.0f), scale);
+	DR_CHECK_EQUAL(resolution.GetSmoothedFrameTime(), smoothed);
+
+	resolution.Reset();
+	DR_CHECK_EQUAL(resolution.GetScale(), 1.0f);
+	DR_CHECK_EQUAL(resolution.GetSmoothedFrameTime(), 0.0f);
+}
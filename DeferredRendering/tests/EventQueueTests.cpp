@@ -0,0 +1,155 @@
+#include "Test.h"
+
+#include <GDX11/Event/EventQueue.h>
+
+#include <thread>
+#include <vector>
+
+using namespace GDX11;
+
+DR_TEST(EventQueueKeepsEveryProducersOrder)
+{
+	constexpr uint32_t producerCount = 4;
+	constexpr int eventCount = 20000;
+
+	// small enough to fill up, a producer retries until its record fits
+	EventQueue queue(256);
+	std::vector<std::thread> producers;
+	for (uint32_t producer = 0; producer < producerCount; producer++)
+	{
+		producers.emplace_back([&queue, producer]()
+		{
+			for (int i = 0; i < eventCount; i++)
+			{
+				while (!queue.Post(EventRecord::KeyPressed((KeyCode)producer, i)))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	// the next repeat count expected from every producer
+	std::vector<int> next(producerCount, 0);
+	uint32_t received = 0;
+	uint32_t outOfOrder = 0;
+	uint32_t wrongType = 0;
+	while (received < producerCount * eventCount)
+	{
+		queue.Dispatch([&](const EventRecord& record)
+		{
+			received++;
+			if (record.type != EventType::KeyPressed || record.key.keyCode >= producerCount)
+			{
+				wrongType++;
+				return;
+			}
+			if (record.key.repeatCount != next[record.key.keyCode]++)
+				outOfOrder++;
+		});
+		DR_CHECK_EQUAL(queue.GetStats().coalescedCount, 0u);
+	}
+
+	for (auto& producer : producers)
+		producer.join();
+
+	DR_CHECK_EQUAL(received, producerCount * eventCount);
+	DR_CHECK_EQUAL(wrongType, 0u);
+	DR_CHECK_EQUAL(outOfOrder, 0u);
+	for (uint32_t producer = 0; producer < producerCount; producer++)
+		DR_CHECK_EQUAL(next[producer], eventCount);
+
+	// nothing left over
+	received = 0;
+	queue.Dispatch([&](const EventRecord&) { received++; });
+	DR_CHECK_EQUAL(received, 0u);
+}
+
+DR_TEST(EventQueueCoalescesConsecutiveMovesAndResizes)
+{
+	EventQueue queue(16);
+	queue.Post(EventRecord::MouseMoved(1, 1));
+	queue.Post(EventRecord::MouseMoved(2, 2));
+	queue.Post(EventRecord::WindowResize(10, 10));
+	queue.Post(EventRecord::WindowResize(20, 20));
+	queue.Post(EventRecord::MouseMoved(3, 3));
+	queue.Post(EventRecord::KeyPressed(65, 0));
+	queue.Post(EventRecord::KeyPressed(65, 1));
+	queue.Post(EventRecord::MouseMoved(4, 4));
+	queue.Post(EventRecord::MouseMoved(5, 5));
+
+	std::vector<EventRecord> records;
+	queue.Dispatch([&](const EventRecord& record) { records.push_back(record); });
+
+	// only the last of a run, a different type in between starts a new one. key presses never merge
+	DR_CHECK_EQUAL(records.size(), (size_t)6);
+	DR_CHECK_EQUAL(queue.GetStats().dispatchedCount, 6u);
+	DR_CHECK_EQUAL(queue.GetStats().coalescedCount, 3u);
+	if (records.size() != 6)
+		return;
+
+	DR_CHECK(records[0].type == EventType::MouseMoved && records[0].mouseMove.x == 2);
+	DR_CHECK(records[1].type == EventType::WindowResize && records[1].resize.width == 20);
+	DR_CHECK(records[2].type == EventType::MouseMoved && records[2].mouseMove.x == 3);
+	DR_CHECK(records[3].type == EventType::KeyPressed && records[3].key.repeatCount == 0);
+	DR_CHECK(records[4].type == EventType::KeyPressed && records[4].key.repeatCount == 1);
+	DR_CHECK(records[5].type == EventType::MouseMoved && records[5].mouseMove.x == 5);
+
+	// alternating types don't merge at all
+	queue.Post(EventRecord::MouseMoved(1, 1));
+	queue.Post(EventRecord::WindowResize(1, 1));
+	queue.Post(EventRecord::MouseMoved(2, 2));
+	records.clear();
+	queue.Dispatch([&](const EventRecord& record) { records.push_back(record); });
+	DR_CHECK_EQUAL(records.size(), (size_t)3);
+	DR_CHECK_EQUAL(queue.GetStats().coalescedCount, 0u);
+}
+
+DR_TEST(EventQueueDropsWhenFull)
+{
+	EventQueue queue(4);
+	for (int i = 0; i < 4; i++)
+		DR_CHECK(queue.Post(EventRecord::KeyPressed(65, i)));
+	DR_CHECK(!queue.Post(EventRecord::KeyPressed(65, 4)));
+	DR_CHECK(!queue.Post(EventRecord::KeyPressed(65, 5)));
+
+	std::vector<int> repeats;
+	queue.Dispatch([&](const EventRecord& record) { repeats.push_back(record.key.repeatCount); });
+	DR_CHECK(repeats == std::vector<int>({ 0, 1, 2, 3 }));
+	DR_CHECK_EQUAL(queue.GetStats().droppedCount, (uint64_t)2);
+
+	// room again, the dropped count is a running total
+	DR_CHECK(queue.Post(EventRecord::KeyPressed(65, 6)));
+	repeats.clear();
+	queue.Dispatch([&](const EventRecord& record) { repeats.push_back(record.key.repeatCount); });
+	DR_CHECK(repeats == std::vector<int>({ 6 }));
+	DR_CHECK_EQUAL(queue.GetStats().droppedCount, (uint64_t)2);
+}
+
+DR_TEST(EventQueueDefersRecordsPostedWhileDispatching)
+{
+	EventQueue queue(16);
+	queue.Post(EventRecord::KeyPressed(65, 0));
+	queue.Post(EventRecord::KeyPressed(66, 0));
+
+	// every press posts a typed key, they belong to the next frame
+	std::vector<EventRecord> records;
+	auto fn = [&](const EventRecord& record)
+	{
+		records.push_back(record);
+		if (record.type == EventType::KeyPressed)
+			queue.Post(EventRecord::KeyTyped(record.key.keyCode));
+	};
+
+	queue.Dispatch(fn);
+	DR_CHECK_EQUAL(records.size(), (size_t)2);
+	DR_CHECK(records.size() == 2 && records[0].type == EventType::KeyPressed && records[1].type == EventType::KeyPressed);
+
+	records.clear();
+	queue.Dispatch(fn);
+	DR_CHECK_EQUAL(records.size(), (size_t)2);
+	DR_CHECK(records.size() == 2 && records[0].type == EventType::KeyTyped && records[0].key.keyCode == 65);
+	DR_CHECK(records.size() == 2 && records[1].type == EventType::KeyTyped && records[1].key.keyCode == 66);
+
+	records.clear();
+	queue.Dispatch(fn);
+	DR_CHECK_EQUAL(records.size(), (size_t)0);
+}
@@ -0,0 +1,87 @@
+#include "Test.h"
+
+#include <GDX11/Core/FrameLimiter.h>
+
+using namespace GDX11;
+
+static constexpr uint64_t s_ms = 1'000'000;
+
+DR_TEST(FrameLimiterUnlimitedMeasuresOnly)
+{
+	ManualClock clock(5 * s_ms);
+	FrameLimiter limiter(&clock);
+
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 0ull); // nothing to measure against yet
+	clock.Advance(3 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 3 * s_ms);
+	DR_CHECK_EQUAL(clock.Now(), 8 * s_ms); // never slept
+	clock.Advance(7 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 7 * s_ms);
+	DR_CHECK_EQUAL(limiter.GetFrameTime(), 7 * s_ms);
+}
+
+DR_TEST(FrameLimiterSleepsFastFramesToThePeriod)
+{
+	ManualClock clock;
+	FrameLimiter limiter(&clock, { 100.0f });
+
+	limiter.WaitForNextFrame();
+	for (int i = 0; i < 10; i++)
+	{
+		clock.Advance(2 * s_ms);
+		DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 10 * s_ms);
+	}
+	DR_CHECK_EQUAL(clock.Now(), 100 * s_ms);
+}
+
+DR_TEST(FrameLimiterKeepsTheScheduleThroughJitter)
+{
+	ManualClock clock;
+	FrameLimiter limiter(&clock, { 100.0f });
+
+	// a frame that's late by less than a period is made up by the next one, slots stay on the 10 ms grid
+	limiter.WaitForNextFrame();
+	clock.Advance(14 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 14 * s_ms);
+	clock.Advance(1 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 6 * s_ms);
+	DR_CHECK_EQUAL(clock.Now(), 20 * s_ms);
+}
+
+DR_TEST(FrameLimiterDoesntBurstAfterALongFrame)
+{
+	ManualClock clock;
+	FrameLimiter limiter(&clock, { 100.0f });
+
+	limiter.WaitForNextFrame();
+	clock.Advance(55 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 55 * s_ms);
+
+	// the missed slots are dropped, the next frame is a whole period after the late one
+	clock.Advance(1 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 10 * s_ms);
+	DR_CHECK_EQUAL(clock.Now(), 65 * s_ms);
+}
+
+DR_TEST(FrameLimiterRestartsTheScheduleOnRateChange)
+{
+	ManualClock clock;
+	FrameLimiter limiter(&clock, { 100.0f });
+
+	limiter.WaitForNextFrame();
+	clock.Advance(1 * s_ms);
+	limiter.WaitForNextFrame();
+	DR_CHECK_EQUAL(clock.Now(), 10 * s_ms);
+
+	// the new period starts from the next call rather than the old slot
+	limiter.SetMaxFrameRate(50.0f);
+	clock.Advance(3 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 3 * s_ms);
+	clock.Advance(1 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 20 * s_ms);
+	DR_CHECK_EQUAL(clock.Now(), 33 * s_ms);
+
+	limiter.SetMaxFrameRate(0.0f);
+	clock.Advance(1 * s_ms);
+	DR_CHECK_EQUAL(limiter.WaitForNextFrame(), 1 * s_ms);
+}
@@ -0,0 +1,248 @@
+#include "Test.h"
+
+#include <GDX11/Core/JobSystem.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace GDX11;
+
+// the checks aren't thread safe, jobs only count and the test checks the counts afterwards
+using Counts = std::unique_ptr<std::atomic<uint32_t>[]>;
+
+static Counts MakeCounts(size_t count)
+{
+	Counts counts(new std::atomic<uint32_t>[count]);
+	for (size_t i = 0; i < count; i++)
+		counts[i].store(0);
+	return counts;
+}
+
+static bool AllOnce(const Counts& counts, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (counts[i].load() != 1)
+			return false;
+	}
+	return true;
+}
+
+DR_TEST(JobSystemRunsEveryJobOnce)
+{
+	constexpr uint32_t threadCount = 4;
+	constexpr uint32_t jobCount = 5000;
+
+	// a small queue, a full one runs the job inline
+	JobSystemDesc desc;
+	desc.threadCount = threadCount;
+	desc.queueCapacity = 16;
+	JobSystem jobs(desc);
+	DR_CHECK_EQUAL(jobs.GetThreadCount(), threadCount);
+
+	// the creating thread and outside threads that go through the external queue
+	const Counts slots = MakeCounts((threadCount + 1) * jobCount);
+	auto submit = [&](uint32_t thread)
+	{
+		JobCounter counter;
+		for (uint32_t i = 0; i < jobCount; i++)
+		{
+			std::atomic<uint32_t>* slot = &slots[thread * jobCount + i];
+			jobs.Run([slot]() { slot->fetch_add(1); }, &counter);
+		}
+		jobs.Wait(counter);
+	};
+
+	std::vector<std::thread> producers;
+	for (uint32_t thread = 1; thread <= threadCount; thread++)
+		producers.emplace_back(submit, thread);
+	submit(0);
+	for (auto& producer : producers)
+		producer.join();
+
+	DR_CHECK(AllOnce(slots, (threadCount + 1) * jobCount));
+}
+
+DR_TEST(JobSystemWaitsOnNestedJobs)
+{
+	JobSystemDesc desc;
+	desc.threadCount = 4;
+	JobSystem jobs(desc);
+
+	constexpr uint32_t outerCount = 16;
+	constexpr uint32_t innerCount = 64;
+	const Counts slots = MakeCounts(outerCount * innerCount);
+	std::atomic<uint32_t> finishedEarly{ 0 };
+
+	// every job runs its own children and waits for them, a worker's Wait has to run other jobs
+	JobCounter outer;
+	for (uint32_t o = 0; o < outerCount; o++)
+	{
+		jobs.Run([&, o]()
+		{
+			JobCounter inner;
+			for (uint32_t i = 0; i < innerCount; i++)
+			{
+				std::atomic<uint32_t>* slot = &slots[o * innerCount + i];
+				jobs.Run([slot]() { slot->fetch_add(1); }, &inner);
+			}
+			jobs.Wait(inner);
+
+			for (uint32_t i = 0; i < innerCount; i++)
+			{
+				if (slots[o * innerCount + i].load() != 1)
+					finishedEarly.fetch_add(1);
+			}
+		}, &outer);
+	}
+	jobs.Wait(outer);
+
+	DR_CHECK(outer.IsDone());
+	DR_CHECK_EQUAL(finishedEarly.load(), 0u);
+	DR_CHECK(AllOnce(slots, outerCount * innerCount));
+
+	// ParallelFor inside ParallelFor
+	const Counts cells = MakeCounts(37 * 41);
+	jobs.ParallelFor(37, [&](uint32_t rowBegin, uint32_t rowEnd)
+	{
+		for (uint32_t row = rowBegin; row < rowEnd; row++)
+		{
+			jobs.ParallelFor(41, [&, row](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t column = begin; column < end; column++)
+					cells[row * 41 + column].fetch_add(1);
+			}, 3);
+		}
+	});
+	DR_CHECK(AllOnce(cells, 37 * 41));
+}
+
+DR_TEST(JobSystemParallelForCoversTheRangeOnce)
+{
+	JobSystemDesc desc;
+	desc.threadCount = 8;
+	JobSystem jobs(desc);
+
+	// empty, one, a prime that no grain divides, fewer than the thread count
+	for (uint32_t count : { 0u, 1u, 1009u, 5u })
+	{
+		for (uint32_t grainSize : { 0u, 1u, 7u, 2000u })
+		{
+			const Counts hits = MakeCounts(count);
+			std::atomic<uint32_t> badRanges{ 0 };
+			std::atomic<uint32_t> calls{ 0 };
+			jobs.ParallelFor(count, [&](uint32_t begin, uint32_t end)
+			{
+				calls.fetch_add(1);
+				if (begin >= end || end > count)
+				{
+					badRanges.fetch_add(1);
+					return;
+				}
+				for (uint32_t i = begin; i < end; i++)
+					hits[i].fetch_add(1);
+			}, grainSize);
+
+			DR_CHECK_EQUAL(badRanges.load(), 0u);
+			DR_CHECK(AllOnce(hits, count));
+
+			const uint32_t grain = grainSize ? grainSize : jobs.GetGrainSize(count);
+			DR_CHECK_EQUAL(calls.load(), (count + grain - 1) / grain);
+		}
+	}
+}
+
+DR_TEST(WorkStealingDequeIsLifoForTheOwnerAndFifoForThieves)
+{
+	WorkStealingDeque<int> deque(4);
+	int items[5] = { 0, 1, 2, 3, 4 };
+	DR_CHECK(deque.Empty());
+	DR_CHECK(deque.Pop() == nullptr);
+	DR_CHECK(deque.Steal() == nullptr);
+
+	for (int i = 0; i < 4; i++)
+		DR_CHECK(deque.Push(&items[i]));
+	DR_CHECK(!deque.Push(&items[4]));
+
+	DR_CHECK(deque.Pop() == &items[3]);
+	DR_CHECK(deque.Steal() == &items[0]);
+	DR_CHECK(deque.Steal() == &items[1]);
+	DR_CHECK(deque.Pop() == &items[2]);
+	DR_CHECK(deque.Empty());
+	DR_CHECK(deque.Pop() == nullptr);
+
+	// wraps around the ring
+	for (int round = 0; round < 3; round++)
+	{
+		for (int i = 0; i < 3; i++)
+			DR_CHECK(deque.Push(&items[i]));
+		DR_CHECK(deque.Steal() == &items[0]);
+		DR_CHECK(deque.Pop() == &items[2]);
+		DR_CHECK(deque.Pop() == &items[1]);
+	}
+	DR_CHECK(deque.Empty());
+}
+
+DR_TEST(WorkStealingDequeLosesAndDuplicatesNothingUnderContention)
+{
+	constexpr uint32_t itemCount = 200000;
+	constexpr uint32_t thiefCount = 3;
+
+	std::vector<uint32_t> items(itemCount);
+	for (uint32_t i = 0; i < itemCount; i++)
+		items[i] = i;
+	const Counts taken = MakeCounts(itemCount);
+
+	// small so the owner keeps racing the thieves for the last items
+	WorkStealingDeque<uint32_t> deque(64);
+	std::atomic<bool> done{ false };
+
+	std::vector<std::thread> thieves;
+	for (uint32_t t = 0; t < thiefCount; t++)
+	{
+		thieves.emplace_back([&]()
+		{
+			while (!done.load())
+			{
+				if (uint32_t* item = deque.Steal())
+					taken[*item].fetch_add(1);
+			}
+		});
+	}
+
+	// push in bursts and pop some back, a full deque pops instead
+	uint32_t next = 0;
+	uint32_t burst = 1;
+	while (next < itemCount)
+	{
+		for (uint32_t i = 0; i < burst && next < itemCount; i++)
+		{
+			if (deque.Push(&items[next]))
+				next++;
+			else if (uint32_t* item = deque.Pop())
+				taken[*item].fetch_add(1);
+		}
+
+		for (uint32_t i = 0; i < burst / 2; i++)
+		{
+			if (uint32_t* item = deque.Pop())
+				taken[*item].fetch_add(1);
+		}
+		burst = burst % 13 + 1;
+	}
+
+	// Pop can lose the last item to a thief, nullptr only means empty once it's empty
+	while (!deque.Empty())
+	{
+		if (uint32_t* item = deque.Pop())
+			taken[*item].fetch_add(1);
+	}
+
+	done.store(true);
+	for (auto& thief : thieves)
+		thief.join();
+
+	DR_CHECK(AllOnce(taken, itemCount));
+}
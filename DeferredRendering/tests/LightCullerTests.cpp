@@ -0,0 +1,186 @@
+#include "Test.h"
+
+#include "Utils/LightCuller.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+using namespace DRUtils;
+
+using PointLight = LightCuller::PointLight;
+using SpotLight = LightCuller::SpotLight;
+
+// at the origin looking down +z, 60 degrees both ways, far plane at 100
+static Camera TestCamera()
+{
+	CameraDesc desc;
+	desc.fov = XMConvertToRadians(60.0f);
+	desc.aspect = 1.0f;
+	desc.nearPlane = 0.1f;
+	desc.farPlane = 100.0f;
+	return Camera(desc);
+}
+
+// luminance 2 and 1 / (1 + quadratic d^2) against a threshold of 1/8 ends at sqrt(15 / quadratic)
+static LightCullerDesc TestDesc()
+{
+	LightCullerDesc desc;
+	desc.luminanceThreshold = 0.125f;
+	return desc;
+}
+
+static PointLight TestPointLight(XMFLOAT3 position, float quadratic = 1.0f)
+{
+	PointLight light;
+	light.position = position;
+	light.constant = 1.0f;
+	light.linear = 0.0f;
+	light.quadratic = quadratic;
+	light.ambient = { 0.0f, 0.0f, 0.0f };
+	light.diffuse = { 1.0f, 1.0f, 1.0f };
+	light.specular = { 1.0f, 1.0f, 1.0f };
+	return light;
+}
+
+static SpotLight TestSpotLight(XMFLOAT3 position, XMFLOAT3 direction, float quadratic = 1.0f)
+{
+	SpotLight light;
+	light.position = position;
+	light.direction = direction;
+	light.constant = 1.0f;
+	light.linear = 0.0f;
+	light.quadratic = quadratic;
+	light.ambient = { 0.0f, 0.0f, 0.0f };
+	light.diffuse = { 1.0f, 1.0f, 1.0f };
+	light.specular = { 1.0f, 1.0f, 1.0f };
+	return light;
+}
+
+static bool Contains(const std::vector<VisibleLight>& lights, uint32_t index)
+{
+	for (const VisibleLight& light : lights)
+	{
+		if (light.index == index)
+			return true;
+	}
+	return false;
+}
+
+DR_TEST(LightCullerInfluenceRadiusMatchesTheClosedForm)
+{
+	struct Case { float constant, linear, quadratic, luminance, threshold; };
+	for (Case c : { Case{ 1.0f, 0.14f, 0.07f, 2.0f, 1.0f / 256.0f }, Case{ 1.0f, 0.7f, 1.8f, 1.0f, 0.01f }, Case{ 0.5f, 0.0f, 0.25f, 3.0f, 0.1f }, Case{ 1.0f, 0.09f, 0.032f, 0.2f, 0.001f } })
+	{
+		const float radius = LightCuller::GetInfluenceRadius(c.constant, c.linear, c.quadratic, c.luminance, c.threshold);
+		const double k = (double)c.constant - (double)c.luminance / c.threshold;
+		const double expected = (-c.linear + std::sqrt((double)c.linear * c.linear - 4.0 * c.quadratic * k)) / (2.0 * c.quadratic);
+		DR_CHECK_NEAR(radius, (float)expected, 1e-4f * (float)expected);
+
+		// the attenuated luminance is the threshold right there
+		const float attenuated = c.luminance / (c.constant + c.linear * radius + c.quadratic * radius * radius);
+		DR_CHECK_NEAR(attenuated, c.threshold, 1e-3f * c.threshold);
+	}
+
+	// only linear, none at all, and a light that never gets above the threshold
+	DR_CHECK_NEAR(LightCuller::GetInfluenceRadius(1.0f, 0.5f, 0.0f, 2.0f, 0.25f), 14.0f, 1e-4f);
+	DR_CHECK_EQUAL(LightCuller::GetInfluenceRadius(1.0f, 0.0f, 0.0f, 2.0f, 0.25f), FLT_MAX);
+	DR_CHECK_EQUAL(LightCuller::GetInfluenceRadius(1.0f, 0.14f, 0.07f, 0.001f, 0.01f), 0.0f);
+}
+
+DR_TEST(LightCullerCullsLightsOutsideTheFrustum)
+{
+	LightCuller culler(TestDesc());
+	culler.Update(TestCamera());
+
+	// radius sqrt(15) ~ 3.87
+	const PointLight pointLights[] =
+	{
+		TestPointLight({ 0.0f, 0.0f, 10.0f }),   // 0 straight ahead
+		TestPointLight({ 0.0f, 0.0f, -10.0f }),  // 1 behind
+		TestPointLight({ 0.0f, 0.0f, -3.0f }),   // 2 behind, reaches past the near plane
+		TestPointLight({ 12.0f, 0.0f, 10.0f }),  // 3 5.3 outside the right plane
+		TestPointLight({ 8.0f, 0.0f, 10.0f }),   // 4 1.9 outside it, reaches in
+		TestPointLight({ 0.0f, -12.0f, 10.0f }), // 5 below
+		TestPointLight({ 0.0f, 0.0f, 110.0f }),  // 6 past the far plane
+	};
+
+	// radius sqrt(60) ~ 7.75, 1 and 2 are 3.7 outside the right plane with the cone pointing in or out
+	const SpotLight spotLights[] =
+	{
+		TestSpotLight({ 0.0f, 0.0f, 10.0f }, { 0.0f, -1.0f, 0.0f }),         // 0 ahead
+		TestSpotLight({ 10.0f, 0.0f, 10.0f }, { -1.0f, 0.0f, 0.0f }, 0.25f), // 1 into the frustum
+		TestSpotLight({ 10.0f, 0.0f, 10.0f }, { 1.0f, 0.0f, 0.0f }, 0.25f),  // 2 away, its sphere would reach in
+		TestSpotLight({ 0.0f, 0.0f, -2.0f }, { 0.0f, 0.0f, 1.0f }),          // 3 behind, shining past the near plane
+		TestSpotLight({ 0.0f, 0.0f, -2.0f }, { 0.0f, 0.0f, -1.0f }),         // 4 behind, shining away
+	};
+
+	culler.Cull(pointLights, 7, spotLights, 5);
+	const std::vector<VisibleLight>& points = culler.GetPointLights();
+	const std::vector<VisibleLight>& spots = culler.GetSpotLights();
+
+	DR_CHECK(Contains(points, 0) && Contains(points, 2) && Contains(points, 4));
+	DR_CHECK(!Contains(points, 1) && !Contains(points, 3) && !Contains(points, 5) && !Contains(points, 6));
+	DR_CHECK(Contains(spots, 0) && Contains(spots, 1) && Contains(spots, 3));
+	DR_CHECK(!Contains(spots, 2) && !Contains(spots, 4));
+
+	const LightCullStats& stats = culler.GetStats();
+	DR_CHECK_EQUAL(stats.lightCount, 12u);
+	DR_CHECK_EQUAL(stats.frustumCulledCount, 6u);
+	DR_CHECK_EQUAL(stats.visibleCount, 6u);
+	DR_CHECK_EQUAL(stats.budgetCulledCount, 0u);
+
+	for (const VisibleLight& light : points)
+	{
+		DR_CHECK_NEAR(light.radius, std::sqrt(15.0f), 1e-4f);
+		DR_CHECK(light.coverage > 0.0f && light.coverage <= 1.0f);
+	}
+	// the camera is inside light 2
+	DR_CHECK(points.size() == 3 && points[0].index == 2 && points[0].coverage == 1.0f);
+}
+
+DR_TEST(LightCullerKeepsTheMostContributingLightsInIndexOrder)
+{
+	LightCullerDesc desc = TestDesc();
+	desc.maxPointLights = 5;
+	desc.maxSpotLights = 2;
+	LightCuller culler(desc);
+	culler.Update(TestCamera());
+
+	// the camera is inside every one of them, the contribution is the luminance
+	const float scales[10] = { 1.0f, 1.0f, 3.0f, 1.0f, 1.0f, 2.0f, 1.0f, 4.0f, 1.0f, 1.0f };
+	std::vector<PointLight> pointLights;
+	std::vector<SpotLight> spotLights;
+	for (float scale : scales)
+	{
+		PointLight point = TestPointLight({ 0.0f, 0.0f, 1.0f });
+		point.diffuse = { scale, scale, scale };
+		point.specular = { scale, scale, scale };
+		pointLights.push_back(point);
+
+		SpotLight spot = TestSpotLight({ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f });
+		spot.outerCutOffAngleCos = 0.0f;
+		spot.diffuse = { 1.0f, 1.0f, 1.0f };
+		spot.specular = { 1.0f, 1.0f, 1.0f };
+		spotLights.push_back(spot);
+	}
+
+	culler.Cull(pointLights.data(), 10, spotLights.data(), 10);
+
+	// highest first, ties by index
+	const uint32_t expected[5] = { 7, 2, 5, 0, 1 };
+	const std::vector<VisibleLight>& points = culler.GetPointLights();
+	DR_CHECK_EQUAL(points.size(), (size_t)5);
+	for (size_t i = 0; i < points.size() && i < 5; i++)
+	{
+		DR_CHECK_EQUAL(points[i].index, expected[i]);
+		DR_CHECK_NEAR(points[i].contribution, 2.0f * scales[expected[i]], 1e-5f);
+	}
+
+	// all equal, the first ones stay
+	const std::vector<VisibleLight>& spots = culler.GetSpotLights();
+	DR_CHECK_EQUAL(spots.size(), (size_t)2);
+	DR_CHECK(spots.size() == 2 && spots[0].index == 0 && spots[1].index == 1);
+
+	DR_CHECK_EQUAL(culler.GetStats().budgetCulledCount, 13u);
+	DR_CHECK_EQUAL(culler.GetStats().visibleCount, 7u);
+}
@@ -0,0 +1,46 @@
+#include "Test.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace DRTests
+{
+	static uint32_t s_failures = 0;
+
+	std::vector<TestCase>& GetTests()
+	{
+		static std::vector<TestCase> tests;
+		return tests;
+	}
+
+	void Fail(const char* file, int line, const std::string& message)
+	{
+		std::cerr << file << '(' << line << "): " << message << '\n';
+		s_failures++;
+	}
+}
+
+// [filter], runs the tests whose name contains it
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	uint32_t runCount = 0;
+	uint32_t failedCount = 0;
+	for (const auto& test : DRTests::GetTests())
+	{
+		if (!std::strstr(test.name, filter))
+			continue;
+
+		const uint32_t failures = DRTests::s_failures;
+		test.function();
+		runCount++;
+
+		const bool failed = DRTests::s_failures != failures;
+		failedCount += failed ? 1 : 0;
+		std::cout << (failed ? "FAILED " : "passed ") << test.name << '\n';
+	}
+
+	std::cout << runCount - failedCount << " / " << runCount << " tests passed" << std::endl;
+	return failedCount == 0 && runCount > 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "Test.h"
+
+#include <GDX11/Renderer/MemoryCounter.h>
+
+#include <utility>
+#include <vector>
+
+using namespace GDX11;
+
+static TextureLayout Layout(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t blockSize, uint32_t bitsPerPixel = 0)
+{
+	TextureLayout layout;
+	layout.width = width;
+	layout.height = height;
+	layout.mipLevels = mipLevels;
+	layout.blockSize = blockSize;
+	layout.bitsPerPixel = bitsPerPixel;
+	return layout;
+}
+
+DR_TEST(MemoryCounterSizesTextures)
+{
+	// r8g8b8a8, one mip, the full chain of a square and of a 8 x 2 (8 x 2, 4 x 1, 2 x 1, 1 x 1)
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(256, 256, 1, 0, 32)), (uint64_t)256 * 256 * 4);
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(256, 256, 0, 0, 32)), (uint64_t)4 * (65536 + 16384 + 4096 + 1024 + 256 + 64 + 16 + 4 + 1));
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(8, 2, 0, 0, 32)), (uint64_t)4 * (16 + 4 + 2 + 1));
+	// rows round up to whole bytes
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(10, 3, 1, 0, 1)), (uint64_t)2 * 3);
+
+	// bc1, 8 byte blocks. the last three mips are smaller than a block and still take one
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(256, 256, 1, 8)), (uint64_t)64 * 64 * 8);
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(256, 256, 0, 8)), (uint64_t)8 * (4096 + 1024 + 256 + 64 + 16 + 4 + 1 + 1 + 1));
+	// bc7, 16 byte blocks, sizes that aren't a multiple of 4
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(100, 60, 1, 16)), (uint64_t)25 * 15 * 16);
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(Layout(6, 6, 2, 16)), (uint64_t)(4 + 1) * 16);
+
+	// a cube's 6 faces of r16g16b16a16 with their mips
+	TextureLayout cube = Layout(128, 128, 0, 0, 64);
+	cube.arraySize = 6;
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(cube), 6 * MemoryCounter::GetTextureSize(Layout(128, 128, 0, 0, 64)));
+
+	// a 4x msaa d24s8 depth buffer
+	TextureLayout depth = Layout(1920, 1080, 1, 0, 32);
+	depth.sampleCount = 4;
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(depth), (uint64_t)1920 * 1080 * 4 * 4);
+
+	// 0 array slices and samples count as 1
+	TextureLayout zero = Layout(16, 16, 1, 0, 32);
+	zero.arraySize = 0;
+	zero.sampleCount = 0;
+	DR_CHECK_EQUAL(MemoryCounter::GetTextureSize(zero), (uint64_t)16 * 16 * 4);
+}
+
+DR_TEST(MemoryCounterCallsBackOncePerBudgetCrossing)
+{
+	const MemoryCategory category = MemoryCategory::Staging;
+	const uint64_t bytesBefore = MemoryCounter::GetStats(category).bytes;
+	const uint64_t totalBefore = MemoryCounter::GetStats(MemoryCategory::Count).bytes;
+
+	struct Call { MemoryCategory category; uint64_t bytes, budget; };
+	std::vector<Call> calls;
+	uint64_t freeOnCall = 0;
+	const MemoryCounter::CallbackID id = MemoryCounter::AddBudgetCallback([&](MemoryCategory crossed, uint64_t bytes, uint64_t budget)
+	{
+		calls.push_back({ crossed, bytes, budget });
+		// called outside the lock, freeing from in here doesn't deadlock
+		if (freeOnCall)
+			MemoryCounter::Free(crossed, freeOnCall);
+	});
+
+	MemoryCounter::SetBudget(category, bytesBefore + 100);
+	MemoryCounter::Allocate(category, 60);
+	MemoryCounter::Allocate(category, 40);
+	// right at the budget isn't over it
+	DR_CHECK_EQUAL(calls.size(), (size_t)0);
+
+	MemoryCounter::Allocate(category, 10);
+	DR_CHECK_EQUAL(calls.size(), (size_t)1);
+	DR_CHECK(calls.size() == 1 && calls[0].category == category && calls[0].bytes == bytesBefore + 110 && calls[0].budget == bytesBefore + 100);
+
+	// still over, no new crossing
+	MemoryCounter::Allocate(category, 10);
+	DR_CHECK_EQUAL(calls.size(), (size_t)1);
+
+	// back under and over again
+	MemoryCounter::Free(category, 50);
+	DR_CHECK_EQUAL(calls.size(), (size_t)1);
+	MemoryCounter::Allocate(category, 50);
+	DR_CHECK_EQUAL(calls.size(), (size_t)2);
+
+	// the callback frees its way back under, the next crossing calls back again
+	MemoryCounter::Free(category, 30);
+	freeOnCall = 40;
+	MemoryCounter::Allocate(category, 20);
+	DR_CHECK_EQUAL(calls.size(), (size_t)3);
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(category).bytes, bytesBefore + 70);
+	MemoryCounter::Allocate(category, 40);
+	DR_CHECK_EQUAL(calls.size(), (size_t)4);
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(category).bytes, bytesBefore + 70);
+	freeOnCall = 0;
+
+	// the total crosses along with the category
+	MemoryCounter::SetBudget(MemoryCategory::Count, totalBefore + 100);
+	MemoryCounter::Allocate(category, 40);
+	DR_CHECK_EQUAL(calls.size(), (size_t)6);
+	DR_CHECK(calls.size() == 6 && calls[4].category == category && calls[5].category == MemoryCategory::Count);
+	DR_CHECK(calls.size() == 6 && calls[5].bytes == totalBefore + 110);
+	MemoryCounter::SetBudget(MemoryCategory::Count, 0);
+
+	// a budget set below what's there calls back right away
+	MemoryCounter::Free(category, 40);
+	MemoryCounter::SetBudget(category, bytesBefore + 10);
+	DR_CHECK_EQUAL(calls.size(), (size_t)7);
+
+	// no budget, no callback
+	MemoryCounter::SetBudget(category, 0);
+	MemoryCounter::Allocate(category, 1000);
+	MemoryCounter::Free(category, 1000);
+	DR_CHECK_EQUAL(calls.size(), (size_t)7);
+
+	// removed, no callback
+	MemoryCounter::RemoveBudgetCallback(id);
+	MemoryCounter::SetBudget(category, bytesBefore + 10);
+	DR_CHECK_EQUAL(calls.size(), (size_t)7);
+	MemoryCounter::SetBudget(category, 0);
+
+	MemoryCounter::Free(category, 70);
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(category).bytes, bytesBefore);
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Count).bytes, totalBefore);
+}
+
+DR_TEST(MemoryCounterPairsAllocationsWithFrees)
+{
+	const MemoryStats before = MemoryCounter::GetStats(MemoryCategory::Geometry);
+	{
+		MemoryAllocation a(MemoryCategory::Geometry, 1000);
+		MemoryAllocation b(MemoryCategory::Geometry, 500);
+		DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Geometry).bytes, before.bytes + 1500);
+		DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Geometry).resourceCount, before.resourceCount + 2);
+
+		// moved from is empty, the replaced one is freed
+		b = std::move(a);
+		DR_CHECK_EQUAL(a.GetSize(), (uint64_t)0);
+		DR_CHECK_EQUAL(b.GetSize(), (uint64_t)1000);
+		DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Geometry).bytes, before.bytes + 1000);
+		DR_CHECK(MemoryCounter::GetStats(MemoryCategory::Geometry).peakBytes >= before.bytes + 1500);
+	}
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Geometry).bytes, before.bytes);
+	DR_CHECK_EQUAL(MemoryCounter::GetStats(MemoryCategory::Geometry).resourceCount, before.resourceCount);
+}
@@ -0,0 +1,223 @@
+#include "Test.h"
+
+#include "Utils/MeshSimplifier.h"
+
+#include <map>
+#include <set>
+
+using namespace DirectX;
+using namespace DRUtils;
+
+// position, uv, normal like the app's meshes
+struct TestMesh
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+
+	MeshSimplifier::MeshDesc GetDesc() const
+	{
+		MeshSimplifier::MeshDesc desc;
+		desc.vertices = vertices.data();
+		desc.vertexCount = (uint32_t)vertices.size() / 8;
+		desc.vertexStride = 8;
+		desc.attributeOffset = 5; // the normal, a uv that's linear over the face would cost every collapse
+		desc.attributeCount = 3;
+		desc.indices = indices.data();
+		desc.indexCount = (uint32_t)indices.size();
+		return desc;
+	}
+
+	XMFLOAT3 GetPosition(uint32_t vertex) const { return { vertices[vertex * 8], vertices[vertex * 8 + 1], vertices[vertex * 8 + 2] }; }
+	XMFLOAT3 GetNormal(uint32_t vertex) const { return { vertices[vertex * 8 + 5], vertices[vertex * 8 + 6], vertices[vertex * 8 + 7] }; }
+};
+
+// unit cube, every face its own segments x segments grid, so the cube edges are normal seams
+static TestMesh TessellatedCube(uint32_t segments)
+{
+	TestMesh mesh;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (float sign : { 1.0f, -1.0f })
+		{
+			// u x v points out
+			uint32_t u = (axis + 1) % 3;
+			uint32_t v = (axis + 2) % 3;
+			if (sign < 0.0f)
+				std::swap(u, v);
+
+			const uint32_t first = (uint32_t)mesh.vertices.size() / 8;
+			for (uint32_t y = 0; y <= segments; y++)
+			{
+				for (uint32_t x = 0; x <= segments; x++)
+				{
+					float position[3];
+					float normal[3] = { 0.0f, 0.0f, 0.0f };
+					position[axis] = 0.5f * sign;
+					position[u] = (float)x / segments - 0.5f;
+					position[v] = (float)y / segments - 0.5f;
+					normal[axis] = sign;
+					mesh.vertices.insert(mesh.vertices.end(), { position[0], position[1], position[2], (float)x / segments, (float)y / segments, normal[0], normal[1], normal[2] });
+				}
+			}
+
+			for (uint32_t y = 0; y < segments; y++)
+			{
+				for (uint32_t x = 0; x < segments; x++)
+				{
+					const uint32_t i = first + y * (segments + 1) + x;
+					mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + segments + 2, i, i + segments + 2, i + segments + 1 });
+				}
+			}
+		}
+	}
+	return mesh;
+}
+
+// radius 0.5, a uv seam where u wraps around
+static TestMesh UVSphere(uint32_t rings, uint32_t sectors)
+{
+	TestMesh mesh;
+	for (uint32_t r = 0; r <= rings; r++)
+	{
+		// sin(pi) isn't quite 0, the poles have to be one position
+		const float theta = XM_PI * r / rings;
+		const float sinTheta = r == 0 || r == rings ? 0.0f : std::sin(theta);
+		for (uint32_t s = 0; s <= sectors; s++)
+		{
+			// the last column has the first one's positions bit for bit
+			const float phi = XM_2PI * (s % sectors) / sectors;
+			const float n[3] = { sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi) };
+			mesh.vertices.insert(mesh.vertices.end(), { 0.5f * n[0], 0.5f * n[1], 0.5f * n[2], (float)s / sectors, (float)r / rings, n[0], n[1], n[2] });
+		}
+	}
+
+	for (uint32_t r = 0; r < rings; r++)
+	{
+		for (uint32_t s = 0; s < sectors; s++)
+		{
+			const uint32_t i = r * (sectors + 1) + s;
+			const uint32_t below = i + sectors + 1;
+			if (r > 0)
+				mesh.indices.insert(mesh.indices.end(), { i, i + 1, below });
+			if (r < rings - 1)
+				mesh.indices.insert(mesh.indices.end(), { i + 1, below + 1, below });
+		}
+	}
+	return mesh;
+}
+
+// every edge, by position, has exactly one triangle on each side
+static bool IsClosed(const TestMesh& mesh, const std::vector<uint32_t>& indices)
+{
+	auto key = [&](uint32_t vertex)
+	{
+		XMFLOAT3 p = mesh.GetPosition(vertex);
+		return std::make_tuple(p.x, p.y, p.z);
+	};
+
+	std::map<std::pair<std::tuple<float, float, float>, std::tuple<float, float, float>>, int> halfEdges;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int e = 0; e < 3; e++)
+			halfEdges[{ key(indices[i + e]), key(indices[i + (e + 1) % 3]) }]++;
+	}
+
+	for (const auto& [edge, count] : halfEdges)
+	{
+		auto opposite = halfEdges.find({ edge.second, edge.first });
+		if (count != 1 || opposite == halfEdges.end() || opposite->second != 1)
+			return false;
+	}
+	return true;
+}
+
+DR_TEST(MeshSimplifierCollapsesAlongSeams)
+{
+	const TestMesh cube = TessellatedCube(8);
+	MeshSimplifier::SimplifyDesc desc;
+	desc.targetIndexCount = 36;
+	desc.maxError = 0.001f;
+	const auto result = MeshSimplifier::Simplify(cube.GetDesc(), desc);
+
+	// flat faces and straight edges, only the corners are left
+	DR_CHECK_EQUAL(result.indices.size(), (size_t)36);
+	DR_CHECK_NEAR(result.error, 0.0f, 1e-5f);
+	DR_CHECK(IsClosed(cube, result.indices));
+
+	// a triangle never takes wedges from two sides of a seam
+	for (size_t i = 0; i < result.indices.size(); i += 3)
+	{
+		const XMFLOAT3 n = cube.GetNormal(result.indices[i]);
+		for (int k = 1; k < 3; k++)
+		{
+			const XMFLOAT3 other = cube.GetNormal(result.indices[i + k]);
+			DR_CHECK(n.x == other.x && n.y == other.y && n.z == other.z);
+		}
+	}
+}
+
+DR_TEST(MeshSimplifierStaysWithinTheErrorBound)
+{
+	const TestMesh sphere = UVSphere(24, 48);
+	const uint32_t triangleCount = (uint32_t)sphere.indices.size() / 3;
+	DR_CHECK(IsClosed(sphere, sphere.indices));
+
+	MeshSimplifier::SimplifyDesc desc;
+	desc.targetIndexCount = 0;
+	desc.attributeWeight = 0.0f;
+
+	size_t previous = 0;
+	for (float maxError : { 0.002f, 0.01f, 0.05f })
+	{
+		desc.maxError = maxError;
+		const auto result = MeshSimplifier::Simplify(sphere.GetDesc(), desc);
+		const size_t count = result.indices.size() / 3;
+
+		DR_CHECK(result.error <= maxError);
+		DR_CHECK(count < triangleCount);
+		DR_CHECK(IsClosed(sphere, result.indices));
+		// a looser bound removes more
+		if (previous > 0)
+			DR_CHECK(count < previous);
+		previous = count;
+
+		// vertices stay on the sphere, the triangles between them can't sag much further in than the bound
+		for (size_t i = 0; i < result.indices.size(); i += 3)
+		{
+			XMVECTOR centroid = XMVectorZero();
+			for (int k = 0; k < 3; k++)
+			{
+				const XMFLOAT3 p = sphere.GetPosition(result.indices[i + k]);
+				centroid += XMLoadFloat3(&p);
+			}
+			const float sag = 0.5f - XMVectorGetX(XMVector3Length(centroid * (1.0f / 3.0f)));
+			DR_CHECK(sag <= 4.0f * maxError);
+		}
+	}
+
+	// an unreachable target stops at the bound instead
+	desc.maxError = 0.002f;
+	const auto tight = MeshSimplifier::Simplify(sphere.GetDesc(), desc);
+	DR_CHECK(tight.indices.size() / 3 > triangleCount / 2);
+}
+
+DR_TEST(MeshSimplifierBuildsLODChainsOfTessellatedMeshes)
+{
+	const TestMesh cube = TessellatedCube(8);
+	MeshSimplifier::LODChainDesc desc;
+	desc.maxLevels = 4;
+	const auto chain = MeshSimplifier::GenerateLODChain(cube.GetDesc(), desc);
+
+	DR_CHECK_EQUAL(chain.levels.size(), (size_t)4);
+	DR_CHECK_EQUAL(chain.levels[0].indexCount, (uint32_t)cube.indices.size());
+	for (size_t i = 1; i < chain.levels.size(); i++)
+	{
+		DR_CHECK(chain.levels[i].indexCount <= chain.levels[i - 1].indexCount * 0.9f);
+		DR_CHECK(chain.levels[i].error >= chain.levels[i - 1].error);
+		DR_CHECK_EQUAL(chain.levels[i].indexOffset, chain.levels[i - 1].indexOffset + chain.levels[i - 1].indexCount);
+
+		const std::vector<uint32_t> level(chain.indices.begin() + chain.levels[i].indexOffset, chain.indices.begin() + chain.levels[i].indexOffset + chain.levels[i].indexCount);
+		DR_CHECK(IsClosed(cube, level));
+	}
+	DR_CHECK_NEAR(chain.radius, std::sqrt(0.75f), 1e-4f);
+}
@@ -0,0 +1,229 @@
+#include "Test.h"
+
+#include "Utils/MeshletCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <set>
+
+using namespace DirectX;
+using namespace DRUtils;
+
+struct TestGrid
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+
+	// segments x segments quads over [-1, 1] at depth z. front faces -z, clockwise seen from there, or +z
+	void AddPlane(uint32_t segments, float z, bool facesNegativeZ)
+	{
+		const uint32_t first = (uint32_t)vertices.size() / 3;
+		for (uint32_t y = 0; y <= segments; y++)
+		{
+			for (uint32_t x = 0; x <= segments; x++)
+				vertices.insert(vertices.end(), { 2.0f * x / segments - 1.0f, 2.0f * y / segments - 1.0f, z });
+		}
+
+		for (uint32_t y = 0; y < segments; y++)
+		{
+			for (uint32_t x = 0; x < segments; x++)
+			{
+				const uint32_t i = first + y * (segments + 1) + x;
+				const uint32_t up = i + segments + 1;
+				if (facesNegativeZ)
+					indices.insert(indices.end(), { i, up, up + 1, i, up + 1, i + 1 });
+				else
+					indices.insert(indices.end(), { i, up + 1, up, i, i + 1, up + 1 });
+			}
+		}
+	}
+
+	MeshSimplifier::MeshDesc GetDesc() const
+	{
+		MeshSimplifier::MeshDesc desc;
+		desc.vertices = vertices.data();
+		desc.vertexCount = (uint32_t)vertices.size() / 3;
+		desc.indices = indices.data();
+		desc.indexCount = (uint32_t)indices.size();
+		return desc;
+	}
+};
+
+// rotated so the smallest index comes first, the winding stays
+static std::vector<std::array<uint32_t, 3>> CanonicalTriangles(const uint32_t* indices, size_t indexCount)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+		while (t[0] != std::min({ t[0], t[1], t[2] }))
+			t = { t[1], t[2], t[0] };
+		triangles.push_back(t);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// at (0, 0, z) looking down +z, or down -z when turned around
+static Camera TestCamera(float z, bool turned)
+{
+	CameraDesc desc;
+	desc.fov = XMConvertToRadians(60.0f);
+	desc.aspect = 1.0f;
+	desc.yaw = turned ? XM_PI : 0.0f;
+	desc.position = { 0.0f, 0.0f, z };
+	return Camera(desc);
+}
+
+static bool StatsAddUp(const MeshletCullStats& stats)
+{
+	return stats.meshletCount == stats.visibleMeshletCount + stats.frustumCulledCount + stats.backfaceCulledCount &&
+		stats.visibleTriangleCount <= stats.triangleCount;
+}
+
+DR_TEST(MeshletsStayWithinTheLimitsAndKeepEveryTriangle)
+{
+	TestGrid grid;
+	grid.AddPlane(40, 0.0f, true);
+	grid.AddPlane(7, 0.5f, false);
+
+	struct Limits { uint32_t vertices, triangles; };
+	for (Limits limits : { Limits{ Meshlets::s_maxVertices, Meshlets::s_maxTriangles }, Limits{ 16, 20 }, Limits{ 64, 8 } })
+	{
+		const Meshlets::MeshletMesh mesh = Meshlets::Build(grid.GetDesc(), limits.vertices, limits.triangles);
+		DR_CHECK(!mesh.meshlets.empty());
+
+		uint32_t nextOffset = 0;
+		for (size_t m = 0; m < mesh.meshlets.size(); m++)
+		{
+			const Meshlets::Meshlet& meshlet = mesh.meshlets[m];
+			DR_CHECK(meshlet.triangleCount >= 1 && meshlet.triangleCount <= limits.triangles);
+			DR_CHECK(meshlet.vertexCount <= limits.vertices);
+			DR_CHECK_EQUAL(meshlet.indexOffset, nextOffset);
+			nextOffset += meshlet.triangleCount * 3;
+
+			const std::set<uint32_t> vertices(mesh.indices.begin() + meshlet.indexOffset, mesh.indices.begin() + meshlet.indexOffset + meshlet.triangleCount * 3);
+			DR_CHECK_EQUAL((uint32_t)vertices.size(), meshlet.vertexCount);
+
+			// the sphere holds every vertex
+			const XMVECTOR center = XMVectorSet(mesh.bounds.centerX[m], mesh.bounds.centerY[m], mesh.bounds.centerZ[m], 0.0f);
+			for (uint32_t v : vertices)
+			{
+				const XMVECTOR p = XMLoadFloat3((const XMFLOAT3*)&grid.vertices[v * 3]);
+				DR_CHECK(XMVectorGetX(XMVector3Length(p - center)) <= mesh.bounds.radius[m] + 1e-5f);
+			}
+		}
+		DR_CHECK_EQUAL(nextOffset, (uint32_t)mesh.indices.size());
+
+		// the same triangles with the same winding, only reordered
+		DR_CHECK(CanonicalTriangles(mesh.indices.data(), mesh.indices.size()) == CanonicalTriangles(grid.indices.data(), grid.indices.size()));
+
+		// padded for the 4 wide culler
+		DR_CHECK_EQUAL(mesh.bounds.radius.size() % 4, (size_t)0);
+		DR_CHECK(mesh.bounds.radius.size() >= mesh.meshlets.size() && mesh.bounds.radius.size() < mesh.meshlets.size() + 4);
+		DR_CHECK_EQUAL(mesh.bounds.coneCutoff.size(), mesh.bounds.radius.size());
+	}
+}
+
+DR_TEST(MeshletCullerCullsClustersFacingAway)
+{
+	TestGrid grid;
+	grid.AddPlane(16, 0.0f, true);
+	const Meshlets::MeshletMesh mesh = Meshlets::Build(grid.GetDesc());
+	const uint32_t meshletCount = (uint32_t)mesh.meshlets.size();
+	DR_CHECK(meshletCount > 1);
+
+	// in front, every meshlet is kept and the ranges merge into one
+	MeshletCuller culler;
+	std::vector<MeshletDrawRange> ranges;
+	culler.Update(TestCamera(-5.0f, false));
+	culler.Cull(mesh, XMMatrixIdentity(), 100, ranges);
+	DR_CHECK_EQUAL(culler.GetStats().visibleMeshletCount, meshletCount);
+	DR_CHECK_EQUAL(culler.GetStats().backfaceCulledCount, 0u);
+	DR_CHECK_EQUAL(ranges.size(), (size_t)1);
+	if (ranges.size() == 1)
+	{
+		DR_CHECK_EQUAL(ranges[0].indexOffset, 100u);
+		DR_CHECK_EQUAL(ranges[0].indexCount, (uint32_t)mesh.indices.size());
+	}
+
+	// behind the plane every cluster faces away
+	culler.ResetStats();
+	ranges.clear();
+	culler.Update(TestCamera(5.0f, true));
+	culler.Cull(mesh, XMMatrixIdentity(), 0, ranges);
+	DR_CHECK_EQUAL(culler.GetStats().backfaceCulledCount, meshletCount);
+	DR_CHECK_EQUAL(culler.GetStats().frustumCulledCount, 0u);
+	DR_CHECK(ranges.empty());
+
+	// turned around by the world matrix instead, facing the camera again
+	culler.ResetStats();
+	culler.Cull(mesh, XMMatrixRotationY(XM_PI), 0, ranges);
+	DR_CHECK_EQUAL(culler.GetStats().visibleMeshletCount, meshletCount);
+}
+
+DR_TEST(MeshletCullerEmitsNothingForClustersOutsideTheFrustum)
+{
+	TestGrid grid;
+	grid.AddPlane(16, 0.0f, true);
+	const Meshlets::MeshletMesh mesh = Meshlets::Build(grid.GetDesc());
+	const uint32_t meshletCount = (uint32_t)mesh.meshlets.size();
+
+	MeshletCuller culler;
+	std::vector<MeshletDrawRange> ranges;
+
+	// looking away
+	culler.Update(TestCamera(-5.0f, true));
+	culler.Cull(mesh, XMMatrixIdentity(), 0, ranges);
+	DR_CHECK(ranges.empty());
+	DR_CHECK_EQUAL(culler.GetStats().frustumCulledCount, meshletCount);
+
+	// off to the side, and past the far plane
+	culler.ResetStats();
+	culler.Update(TestCamera(-5.0f, false));
+	culler.Cull(mesh, XMMatrixTranslation(50.0f, 0.0f, 0.0f), 0, ranges);
+	culler.Cull(mesh, XMMatrixTranslation(0.0f, 0.0f, 2000.0f), 0, ranges);
+	DR_CHECK(ranges.empty());
+	DR_CHECK_EQUAL(culler.GetStats().frustumCulledCount, 2 * meshletCount);
+	DR_CHECK_EQUAL(culler.GetStats().visibleMeshletCount, 0u);
+}
+
+DR_TEST(MeshletCullerStatsAddUp)
+{
+	// a plane facing the camera in front of one facing away
+	TestGrid grid;
+	grid.AddPlane(16, 0.0f, true);
+	grid.AddPlane(16, 0.5f, false);
+	const Meshlets::MeshletMesh mesh = Meshlets::Build(grid.GetDesc());
+	const uint32_t meshletCount = (uint32_t)mesh.meshlets.size();
+
+	MeshletCuller culler;
+	std::vector<MeshletDrawRange> ranges;
+	culler.Update(TestCamera(-5.0f, false));
+	culler.Cull(mesh, XMMatrixIdentity(), 0, ranges);
+	culler.Cull(mesh, XMMatrixTranslation(50.0f, 0.0f, 0.0f), (uint32_t)mesh.indices.size(), ranges);
+
+	const MeshletCullStats& stats = culler.GetStats();
+	DR_CHECK_EQUAL(stats.meshletCount, 2 * meshletCount);
+	DR_CHECK_EQUAL(stats.triangleCount, (uint32_t)mesh.indices.size() * 2 / 3);
+	DR_CHECK(stats.visibleMeshletCount > 0 && stats.backfaceCulledCount > 0 && stats.frustumCulledCount >= meshletCount);
+	DR_CHECK(StatsAddUp(stats));
+
+	// the ranges hold exactly the visible triangles
+	uint32_t rangeIndexCount = 0;
+	for (const MeshletDrawRange& range : ranges)
+		rangeIndexCount += range.indexCount;
+	DR_CHECK_EQUAL(rangeIndexCount, stats.visibleTriangleCount * 3);
+
+	// folding in another culler's stats
+	MeshletCuller other;
+	other.Update(TestCamera(5.0f, true));
+	other.Cull(mesh, XMMatrixIdentity(), 0, ranges);
+	DR_CHECK(StatsAddUp(other.GetStats()));
+
+	const MeshletCullStats before = stats;
+	culler.AddStats(other.GetStats());
+	DR_CHECK_EQUAL(culler.GetStats().meshletCount, before.meshletCount + other.GetStats().meshletCount);
+	DR_CHECK_EQUAL(culler.GetStats().visibleTriangleCount, before.visibleTriangleCount + other.GetStats().visibleTriangleCount);
+	DR_CHECK(StatsAddUp(culler.GetStats()));
+}
@@ -0,0 +1,187 @@
+#include "Test.h"
+
+#include "Utils/OcclusionCuller.h"
+
+#include <GDX11/Core/JobSystem.h>
+
+#include <cmath>
+
+using namespace DirectX;
+using namespace DRUtils;
+
+// 64 x 64 pixels, 90 degrees, at the origin looking down +z. a point (x, y, z) lands on pixel (32 + 32 x / z, 32 - 32 y / z)
+static Camera TestCamera()
+{
+	CameraDesc desc;
+	desc.fov = XM_PIDIV2;
+	desc.aspect = 1.0f;
+	desc.nearPlane = 0.1f;
+	desc.farPlane = 1000.0f;
+	return Camera(desc);
+}
+
+static OcclusionCullerDesc TestDesc()
+{
+	OcclusionCullerDesc desc;
+	desc.width = 64;
+	desc.height = 64;
+	desc.binCountX = 2;
+	desc.binCountY = 2;
+	return desc;
+}
+
+// facing the camera at depth z, the diagonal from (x0, y0) to (x1, y1) is the shared edge
+static void AddQuad(OcclusionCuller& culler, float x0, float x1, float y0, float y1, float z)
+{
+	const float vertices[] = { x0, y0, z, x0, y1, z, x1, y1, z, x1, y0, z };
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	culler.AddOccluder(vertices, 4, 3, indices, 6, XMMatrixIdentity());
+}
+
+static bool IsBoxVisible(OcclusionCuller& culler, XMFLOAT3 center, float halfSize)
+{
+	return culler.IsVisible({ center.x - halfSize, center.y - halfSize, center.z - halfSize }, { center.x + halfSize, center.y + halfSize, center.z + halfSize }, XMMatrixIdentity());
+}
+
+// the same numbers on every platform
+static float Random(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1u << 24);
+}
+
+DR_TEST(OcclusionCullerHidesBoxesBehindOccluders)
+{
+	for (bool avx2 : { false, true })
+	{
+		OcclusionCuller culler(TestDesc());
+		culler.SetAVX2(avx2);
+
+		// covers the screen at depth 10
+		culler.Begin(TestCamera());
+		AddQuad(culler, -20.0f, 20.0f, -20.0f, 20.0f, 10.0f);
+		culler.Rasterize();
+		DR_CHECK_EQUAL(culler.GetStats().rasterizedTriangleCount, 2u);
+
+		DR_CHECK(!IsBoxVisible(culler, { 6.0f, -4.0f, 20.0f }, 0.5f));
+		DR_CHECK(IsBoxVisible(culler, { 1.5f, -1.0f, 5.0f }, 0.25f));
+		// the pixels along the diagonal are left empty
+		DR_CHECK(IsBoxVisible(culler, { 0.0f, 0.0f, 20.0f }, 0.5f));
+		// from behind the camera to behind the quad
+		DR_CHECK(culler.IsVisible({ 5.0f, -5.0f, -1.0f }, { 7.0f, -3.0f, 30.0f }, XMMatrixIdentity()));
+		DR_CHECK_EQUAL(culler.GetStats().testedCount, 4u);
+		DR_CHECK_EQUAL(culler.GetStats().occludedCount, 1u);
+
+		// only the left half
+		culler.Begin(TestCamera());
+		AddQuad(culler, -20.0f, 0.0f, -20.0f, 20.0f, 10.0f);
+		culler.Rasterize();
+		DR_CHECK(!IsBoxVisible(culler, { -6.0f, -4.0f, 20.0f }, 0.5f));
+		DR_CHECK(IsBoxVisible(culler, { 6.0f, -4.0f, 20.0f }, 0.5f));
+
+		// facing away
+		culler.Begin(TestCamera());
+		AddQuad(culler, 20.0f, -20.0f, -20.0f, 20.0f, 10.0f);
+		culler.Rasterize();
+		DR_CHECK_EQUAL(culler.GetStats().rasterizedTriangleCount, 0u);
+		DR_CHECK(IsBoxVisible(culler, { 6.0f, -4.0f, 20.0f }, 0.5f));
+	}
+}
+
+DR_TEST(OcclusionCullerOnlyWritesFullyCoveredPixels)
+{
+	for (bool avx2 : { false, true })
+	{
+		OcclusionCuller culler(TestDesc());
+		culler.SetAVX2(avx2);
+		culler.Begin(TestCamera());
+
+		// edges at pixels 24.64, 43.84 across and 23.68, 38.08 down
+		AddQuad(culler, -2.3f, 3.7f, -1.9f, 2.6f, 10.0f);
+		culler.Rasterize();
+
+		uint32_t written = 0;
+		const std::vector<float>& depth = culler.GetDepth();
+		for (uint32_t y = 0; y < culler.GetHeight(); y++)
+		{
+			for (uint32_t x = 0; x < culler.GetWidth(); x++)
+			{
+				const float z = depth[y * culler.GetWidth() + x];
+				if (z == 0.0f)
+					continue;
+
+				written++;
+				DR_CHECK(x >= 25 && x + 1 <= 43 && y >= 24 && y + 1 <= 38);
+				// pushed back to the farthest point, never nearer than the quad
+				DR_CHECK(z <= 0.1f);
+			}
+		}
+		DR_CHECK(written > 200);
+
+		// behind the quad, but only under the pixels its left edge partly covers
+		DR_CHECK(culler.IsVisible({ -4.55f, 1.15f, 19.9f }, { -4.42f, 1.35f, 20.1f }, XMMatrixIdentity()));
+		// one pixel further in is fully covered
+		DR_CHECK(!culler.IsVisible({ -4.0f, 1.15f, 19.9f }, { -3.9f, 1.35f, 20.1f }, XMMatrixIdentity()));
+	}
+}
+
+DR_TEST(OcclusionCullerGivesTheSameDepthOnEveryPath)
+{
+	// clockwise and counter clockwise, some through the near plane and off screen
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t state = 12345;
+	for (uint32_t i = 0; i < 400; i++)
+	{
+		const float cx = Random(state) * 40.0f - 20.0f;
+		const float cy = Random(state) * 40.0f - 20.0f;
+		const float cz = Random(state) * 40.0f - 1.0f;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			vertices.insert(vertices.end(), { cx + Random(state) * 20.0f - 10.0f, cy + Random(state) * 20.0f - 10.0f, cz + Random(state) * 8.0f - 4.0f });
+			indices.push_back((uint32_t)indices.size());
+		}
+	}
+
+	GDX11::JobSystemDesc jobDesc;
+	jobDesc.threadCount = 4;
+	GDX11::JobSystem jobs(jobDesc);
+
+	OcclusionCuller reference(TestDesc());
+	reference.SetAVX2(false);
+	reference.Begin(TestCamera());
+	reference.AddOccluder(vertices.data(), (uint32_t)vertices.size() / 3, 3, indices.data(), (uint32_t)indices.size(), XMMatrixIdentity());
+	reference.Rasterize();
+	DR_CHECK(reference.GetStats().rasterizedTriangleCount > 50);
+
+	// center and half size, on screen and mostly behind the triangles
+	std::vector<XMFLOAT4> boxes;
+	std::vector<bool> visible;
+	for (uint32_t i = 0; i < 500; i++)
+	{
+		const float z = Random(state) * 40.0f + 20.0f;
+		boxes.push_back({ (Random(state) * 1.6f - 0.8f) * z, (Random(state) * 1.6f - 0.8f) * z, z, Random(state) * 2.0f });
+		visible.push_back(IsBoxVisible(reference, { boxes[i].x, boxes[i].y, boxes[i].z }, boxes[i].w));
+	}
+	// something to tell apart
+	DR_CHECK(reference.GetStats().occludedCount > 50);
+	DR_CHECK(reference.GetStats().occludedCount < 450);
+
+	// avx2 falls back to scalar where the cpu doesn't have it, the comparison still holds
+	for (bool avx2 : { false, true })
+	{
+		for (GDX11::JobSystem* jobSystem : { (GDX11::JobSystem*)nullptr, &jobs })
+		{
+			OcclusionCuller culler(TestDesc());
+			culler.SetAVX2(avx2);
+			culler.Begin(TestCamera());
+			culler.AddOccluder(vertices.data(), (uint32_t)vertices.size() / 3, 3, indices.data(), (uint32_t)indices.size(), XMMatrixIdentity());
+			culler.Rasterize(jobSystem);
+
+			// bit for bit
+			DR_CHECK(culler.GetDepth() == reference.GetDepth());
+			for (size_t i = 0; i < boxes.size(); i++)
+				DR_CHECK(IsBoxVisible(culler, { boxes[i].x, boxes[i].y, boxes[i].z }, boxes[i].w) == visible[i]);
+		}
+	}
+}
@@ -0,0 +1,155 @@
+#include "Test.h"
+
+#include <GDX11/Renderer/ParameterData.h>
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace GDX11;
+
+using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+static Ranges GetRanges(const ParameterData& data)
+{
+	Ranges ranges;
+	for (const ParameterData::Range& range : data.GetDirtyRanges())
+		ranges.push_back({ range.begin, range.end });
+	return ranges;
+}
+
+// laid out like the reflection reports cbuffer TestCBuf { float4x4 viewProjection; float4 color; float time; float3 lights[4];
+// float weights[2]; } with s0 to s3 one per register after it
+static ParameterData TestData()
+{
+	ParameterData data("TestCBuf", 256);
+	data.AddVariable("viewProjection", 0, 64, 0);
+	data.AddVariable("color", 64, 16, 0);
+	const float time = 1.0f;
+	data.AddVariable("time", 80, 4, 0, &time);
+	data.AddVariable("lights", 96, 3 * 16 + 12, 4);
+	data.AddVariable("weights", 160, 16 + 4, 2);
+	for (uint32_t i = 0; i < 4; i++)
+		data.AddVariable("s" + std::to_string(i), 192 + i * 16, 4, 0);
+	return data;
+}
+
+DR_TEST(ParameterDataChecksTheElementSizeAgainstTheLayout)
+{
+	const ParameterData data = TestData();
+	DR_CHECK_EQUAL(data.GetVariableID("viewProjection", 64), 0u);
+	DR_CHECK_EQUAL(data.GetVariableID("time", 4), 2u);
+	// float3s, every element but the last padded to a register
+	DR_CHECK_EQUAL(data.GetVariableID("lights", 12), 3u);
+	DR_CHECK_EQUAL(data.GetVariableID("weights", 4), 4u);
+	DR_CHECK(data.HasVariable("s3") && !data.HasVariable("s4"));
+
+	// a float4 mirror of the float3 array, a float2 mirror of a float, a matrix that lost a row, an unknown name
+	struct Case { const char* name; uint32_t elementSize; };
+	for (Case c : { Case{ "lights", 16 }, Case{ "weights", 8 }, Case{ "viewProjection", 48 }, Case{ "missing", 4 } })
+	{
+		bool thrown = false;
+		try
+		{
+			data.GetVariableID(c.name, c.elementSize);
+		}
+		catch (const ParameterData::Exception& e)
+		{
+			thrown = e.GetErrorInfo().find(c.name) != std::string::npos;
+		}
+		DR_CHECK(thrown);
+	}
+}
+
+DR_TEST(ParameterDataMarksOnlyTheRegistersThatChanged)
+{
+	ParameterData data = TestData();
+	DR_CHECK_EQUAL(data.GetSize(), 256u);
+	DR_CHECK(data.GetDirtyRanges().empty());
+
+	// the initializer is already there, the same value is no change
+	const float time = 1.0f;
+	data.Set(data.GetVariableID("time", 4), &time, 4);
+	DR_CHECK(data.GetDirtyRanges().empty());
+
+	// the third light starts on the third register of the array
+	const float light[3] = { 0.0f, 2.0f, 0.0f };
+	data.Set(data.GetVariableID("lights", 12), light, 12, 2);
+	DR_CHECK(GetRanges(data) == Ranges({ { 128, 144 } }));
+	float written = 0.0f;
+	memcpy(&written, data.GetData() + 128 + 4, 4);
+	DR_CHECK_EQUAL(written, 2.0f);
+
+	data.ClearDirty();
+	data.Set(data.GetVariableID("lights", 12), light, 12, 2);
+	DR_CHECK(data.GetDirtyRanges().empty());
+
+	// one float in the middle of the matrix only dirties its row
+	float matrix[16] = {};
+	matrix[9] = 1.0f;
+	data.Set(data.GetVariableID("viewProjection", 64), matrix, 64);
+	DR_CHECK(GetRanges(data) == Ranges({ { 32, 48 } }));
+	data.ClearDirty();
+
+	// the first and the last byte that differ bound the range, the unchanged row between them goes along
+	matrix[0] = 1.0f;
+	matrix[9] = 2.0f;
+	data.Set(data.GetVariableID("viewProjection", 64), matrix, 64);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 48 } }));
+}
+
+DR_TEST(ParameterDataMergesRangesThatOverlapOrTouch)
+{
+	ParameterData data = TestData();
+
+	// rounded out to registers
+	data.MarkDirty(20, 40);
+	DR_CHECK(GetRanges(data) == Ranges({ { 16, 48 } }));
+
+	// touching on either side
+	data.MarkDirty(48, 52);
+	data.MarkDirty(0, 16);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 64 } }));
+
+	// apart, then bridged
+	data.MarkDirty(96, 100);
+	data.MarkDirty(160, 176);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 64 }, { 96, 112 }, { 160, 176 } }));
+	data.MarkDirty(100, 170);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 64 }, { 96, 176 } }));
+
+	// inside one that's already dirty
+	data.MarkDirty(8, 12);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 64 }, { 96, 176 } }));
+}
+
+DR_TEST(ParameterDataKeepsAtMostFourRanges)
+{
+	static_assert(ParameterData::s_maxDirtyRanges == 4, "the ranges below are laid out for 4");
+	ParameterData data = TestData();
+
+	// gaps of 16, 64, 16, 80, the first of the two closest merges
+	data.MarkDirty(0, 16);
+	data.MarkDirty(32, 48);
+	data.MarkDirty(112, 128);
+	data.MarkDirty(144, 160);
+	DR_CHECK_EQUAL(data.GetDirtyRanges().size(), (size_t)4);
+	data.MarkDirty(240, 256);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 48 }, { 112, 128 }, { 144, 160 }, { 240, 256 } }));
+
+	// gaps of 64, 16, 32, 32 now
+	data.MarkDirty(192, 208);
+	DR_CHECK(GetRanges(data) == Ranges({ { 0, 48 }, { 112, 160 }, { 192, 208 }, { 240, 256 } }));
+
+	// every byte that was marked is still covered
+	for (uint32_t byte : { 0u, 40u, 112u, 150u, 192u, 255u })
+	{
+		bool covered = false;
+		for (const ParameterData::Range& range : data.GetDirtyRanges())
+			covered = covered || (range.begin <= byte && byte < range.end);
+		DR_CHECK(covered);
+	}
+
+	data.ClearDirty();
+	DR_CHECK(data.GetDirtyRanges().empty());
+}
@@ -0,0 +1,192 @@
+#include "Test.h"
+
+#include "Utils/ShadowAtlas.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+using namespace DRUtils;
+
+static ShadowLight PointLight(uint32_t id, float importance, XMFLOAT3 position = { 0.0f, 2.0f, 0.0f })
+{
+	ShadowLight light;
+	light.id = id;
+	light.type = ShadowLightType::Point;
+	light.position = position;
+	light.importance = importance;
+	return light;
+}
+
+static ShadowLight SpotLight(uint32_t id, float importance, XMFLOAT3 position = { 0.0f, 5.0f, 0.0f })
+{
+	ShadowLight light;
+	light.id = id;
+	light.type = ShadowLightType::Spot;
+	light.position = position;
+	light.direction = { 0.0f, -1.0f, 0.0f };
+	light.importance = importance;
+	return light;
+}
+
+static bool Overlap(const ShadowAtlasView& a, const ShadowAtlasView& b)
+{
+	return a.x < b.x + b.size && b.x < a.x + a.size && a.y < b.y + b.size && b.y < a.y + a.size;
+}
+
+DR_TEST(ShadowAtlasSizesTilesByImportanceWithoutOverlap)
+{
+	ShadowAtlasDesc desc;
+	desc.size = 2048;
+	desc.maxTileSize = 512;
+	desc.minTileSize = 64;
+	ShadowAtlas atlas(desc);
+
+	atlas.Update({ PointLight(1, 1.0f), PointLight(2, 0.1f), SpotLight(3, 0.02f) }, {});
+	const auto& views = atlas.GetViews();
+	DR_CHECK_EQUAL(views.size(), (size_t)13);
+	DR_CHECK_EQUAL(atlas.GetStats().allocationFailures, 0u);
+
+	// sqrt(importance) of the max, rounded up to a power of two
+	DR_CHECK_EQUAL(views[0].size, 512u);
+	DR_CHECK_EQUAL(views[6].size, 256u);
+	DR_CHECK_EQUAL(views[12].size, 128u);
+
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		DR_CHECK(views[i].x + views[i].size <= desc.size && views[i].y + views[i].size <= desc.size);
+		DR_CHECK(views[i].x % views[i].size == 0 && views[i].y % views[i].size == 0);
+		for (size_t j = i + 1; j < views.size(); j++)
+			DR_CHECK(!Overlap(views[i], views[j]));
+	}
+}
+
+DR_TEST(ShadowAtlasRendersWithinTheBudget)
+{
+	ShadowAtlasDesc desc;
+	desc.viewBudget = 4;
+	ShadowAtlas atlas(desc);
+
+	const std::vector<ShadowLight> lights = { PointLight(1, 0.5f), PointLight(2, 0.5f), PointLight(3, 0.5f) };
+	uint32_t rendered = 0;
+	for (uint32_t frame = 0; frame < 5; frame++)
+	{
+		atlas.Update(lights, {});
+		DR_CHECK(atlas.GetRenderViews().size() <= desc.viewBudget);
+		rendered += (uint32_t)atlas.GetRenderViews().size();
+	}
+
+	// 18 views, 4 a frame
+	DR_CHECK_EQUAL(rendered, 18u);
+	DR_CHECK_EQUAL(atlas.GetStats().shadowedLightCount, 3u);
+	for (uint32_t i = 0; i < 3; i++)
+		DR_CHECK(atlas.GetFirstView(i) >= 0);
+
+	// nothing changed, nothing to render
+	atlas.Update(lights, {});
+	DR_CHECK(atlas.GetRenderViews().empty());
+}
+
+DR_TEST(ShadowAtlasHasNoShadowUntilEveryFaceRendered)
+{
+	ShadowAtlasDesc desc;
+	desc.viewBudget = 4;
+	ShadowAtlas atlas(desc);
+
+	atlas.Update({ PointLight(1, 0.5f) }, {});
+	DR_CHECK_EQUAL(atlas.GetFirstView(0), -1);
+	DR_CHECK_EQUAL(atlas.GetStats().shadowedLightCount, 0u);
+
+	atlas.Update({ PointLight(1, 0.5f) }, {});
+	DR_CHECK_EQUAL(atlas.GetFirstView(0), 0);
+}
+
+DR_TEST(ShadowAtlasRerendersOnlyViewsAMovedCasterTouches)
+{
+	ShadowAtlas atlas;
+	const std::vector<ShadowLight> lights = { SpotLight(1, 0.5f, { 0.0f, 5.0f, 0.0f }), SpotLight(2, 0.5f, { 100.0f, 5.0f, 0.0f }) };
+	atlas.Update(lights, {});
+	atlas.Update(lights, {});
+	DR_CHECK(atlas.GetRenderViews().empty());
+
+	// under the first light, out of the second's range
+	atlas.Update(lights, { { 0.0f, 0.0f, 0.0f, 0.5f } });
+	DR_CHECK_EQUAL(atlas.GetRenderViews().size(), (size_t)1);
+	DR_CHECK_EQUAL(atlas.GetViews()[atlas.GetRenderViews()[0]].light, 0u);
+
+	// a changed light renders again by itself
+	std::vector<ShadowLight> moved = lights;
+	moved[1].position.x += 1.0f;
+	atlas.Update(moved, {});
+	DR_CHECK_EQUAL(atlas.GetRenderViews().size(), (size_t)1);
+	DR_CHECK_EQUAL(atlas.GetViews()[atlas.GetRenderViews()[0]].light, 1u);
+}
+
+DR_TEST(ShadowAtlasAgingKeepsUnimportantViewsFromStarving)
+{
+	ShadowAtlasDesc desc;
+	desc.viewBudget = 1;
+	desc.agingRate = 0.1f;
+	ShadowAtlas atlas(desc);
+
+	std::vector<ShadowLight> lights = { SpotLight(1, 1.0f, { 0.0f, 5.0f, 0.0f }), SpotLight(2, 0.1f, { 50.0f, 5.0f, 0.0f }) };
+	atlas.Update(lights, {});
+	atlas.Update(lights, {});
+
+	// the important light changes every frame, the other one only got dirty once
+	uint32_t waited = 0;
+	bool renderedUnimportant = false;
+	for (uint32_t frame = 0; frame < 30 && !renderedUnimportant; frame++)
+	{
+		lights[0].position.x += 0.1f;
+		atlas.Update(lights, { { 50.0f, 0.0f, 0.0f, 0.5f } });
+		for (uint32_t view : atlas.GetRenderViews())
+			renderedUnimportant |= atlas.GetViews()[view].light == 1;
+		waited = std::max(waited, atlas.GetStats().maxWait);
+	}
+
+	DR_CHECK(renderedUnimportant);
+	// importance 1 against 0.1, aging 0.1 a frame catches up in about 9
+	DR_CHECK(waited <= 10);
+}
+
+DR_TEST(ShadowAtlasGivesRemovedLightsTilesToOthers)
+{
+	ShadowAtlasDesc desc;
+	desc.size = 1024;
+	desc.maxTileSize = 1024;
+	desc.minTileSize = 512;
+	ShadowAtlas atlas(desc);
+
+	atlas.Update({ SpotLight(1, 1.0f) }, {});
+	DR_CHECK_EQUAL(atlas.GetViews()[0].size, 1024u);
+
+	// full, the smallest tile doesn't fit either
+	atlas.Update({ SpotLight(1, 1.0f), SpotLight(2, 1.0f) }, {});
+	DR_CHECK_EQUAL(atlas.GetStats().allocationFailures, 1u);
+	DR_CHECK_EQUAL(atlas.GetViews().size(), (size_t)1);
+	DR_CHECK_EQUAL(atlas.GetFirstView(1), -1);
+
+	// the freed quarters merge back into the whole atlas
+	atlas.Update({ SpotLight(2, 1.0f) }, {});
+	DR_CHECK_EQUAL(atlas.GetStats().allocationFailures, 0u);
+	DR_CHECK_EQUAL(atlas.GetViews().size(), (size_t)1);
+	DR_CHECK_EQUAL(atlas.GetViews()[0].size, 1024u);
+}
+
+DR_TEST(ShadowAtlasTestsCastersAgainstTheViewVolume)
+{
+	ShadowAtlas atlas;
+	atlas.Update({ SpotLight(1, 0.5f, { 0.0f, 5.0f, 0.0f }), PointLight(2, 0.5f, { 20.0f, 0.0f, 0.0f }) }, {});
+
+	// the spot points down
+	DR_CHECK(atlas.IsCasterVisible(0, { 0.0f, 0.0f, 0.0f }, 0.5f));
+	DR_CHECK(!atlas.IsCasterVisible(0, { 0.0f, 8.0f, 0.0f }, 0.5f));
+	DR_CHECK(!atlas.IsCasterVisible(0, { 9.0f, 4.0f, 0.0f }, 0.5f));
+
+	// +x face of the point light, then -x
+	DR_CHECK(atlas.IsCasterVisible(1, { 25.0f, 0.0f, 0.0f }, 0.5f));
+	DR_CHECK(!atlas.IsCasterVisible(1, { 15.0f, 0.0f, 0.0f }, 0.5f));
+	DR_CHECK(atlas.IsCasterVisible(2, { 15.0f, 0.0f, 0.0f }, 0.5f));
+	// out of range
+	DR_CHECK(!atlas.IsCasterVisible(1, { 40.0f, 0.0f, 0.0f }, 0.5f));
+}
@@ -0,0 +1,193 @@
+#include "Test.h"
+
+#include "Utils/ShadowCascades.h"
+
+using namespace DirectX;
+using namespace DRUtils;
+
+static CameraDesc TestCamera(XMFLOAT3 position = { 0.0f, 2.0f, 0.0f }, float yaw = 0.0f)
+{
+	CameraDesc desc;
+	desc.fov = XMConvertToRadians(60.0f);
+	desc.aspect = 16.0f / 9.0f;
+	desc.nearPlane = 0.1f;
+	desc.farPlane = 1000.0f;
+	desc.yaw = yaw;
+	desc.position = position;
+	return desc;
+}
+
+static XMFLOAT3 LightDirection(float x, float y, float z)
+{
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return direction;
+}
+
+// the corners of the cascade's frustum slice have to land inside its light clip space box
+static bool CoversSlice(const Camera& camera, const ShadowCascade& cascade)
+{
+	const CameraDesc& desc = camera.GetDesc();
+	const float tanHalfFov = std::tan(desc.fov * 0.5f);
+	const XMMATRIX toLight = XMMatrixInverse(nullptr, camera.GetViewMatrix()) * XMLoadFloat4x4(&cascade.viewProjection);
+	for (float depth : { cascade.splitNear, cascade.splitFar })
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			const float x = (i & 1 ? 1.0f : -1.0f) * depth * tanHalfFov * desc.aspect;
+			const float y = (i & 2 ? 1.0f : -1.0f) * depth * tanHalfFov;
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMVectorSet(x, y, depth, 1.0f), toLight));
+			if (std::abs(p.x) > 1.0f || std::abs(p.y) > 1.0f || p.z < 0.0f || p.z > 1.0f)
+				return false;
+		}
+	}
+	return true;
+}
+
+DR_TEST(ShadowCascadesSplitTheViewInOrder)
+{
+	ShadowCascadesDesc desc;
+	desc.maxDistance = 60.0f;
+	ShadowCascades cascades(desc);
+	Camera camera(TestCamera());
+	cascades.Update(camera, LightDirection(0.3f, -1.0f, 0.2f));
+
+	DR_CHECK_EQUAL(cascades.GetCascadeCount(), 4u);
+	DR_CHECK_NEAR(cascades.GetCascade(0).splitNear, 0.1f, 1e-6f);
+	DR_CHECK_NEAR(cascades.GetCascade(3).splitFar, 60.0f, 1e-3f);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		const ShadowCascade& cascade = cascades.GetCascade(i);
+		DR_CHECK(cascade.splitFar > cascade.splitNear);
+		if (i > 0)
+			DR_CHECK_EQUAL(cascade.splitNear, cascades.GetCascade(i - 1).splitFar);
+	}
+
+	// lambda 0 is uniform, and a camera closer than maxDistance ends the last cascade at its far plane
+	desc.splitLambda = 0.0f;
+	cascades.Set(desc);
+	CameraDesc shortCamera = TestCamera();
+	shortCamera.nearPlane = 1.0f;
+	shortCamera.farPlane = 41.0f;
+	cascades.Update(Camera(shortCamera), LightDirection(0.3f, -1.0f, 0.2f));
+	for (uint32_t i = 0; i < 4; i++)
+		DR_CHECK_NEAR(cascades.GetCascade(i).splitFar, 1.0f + 10.0f * (i + 1), 1e-4f);
+}
+
+DR_TEST(ShadowCascadesCoverTheirSliceSnappedToTexels)
+{
+	ShadowCascades cascades;
+	for (float yaw : { 0.0f, 0.7f, 2.5f })
+	{
+		Camera camera(TestCamera({ 3.3f, 1.7f, -5.1f }, yaw));
+		cascades.InvalidateStatic();
+		cascades.Update(camera, LightDirection(0.3f, -1.0f, 0.2f));
+		for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(i);
+			DR_CHECK(CoversSlice(camera, cascade));
+
+			const float x = cascade.center.x / cascade.texelSize;
+			const float y = cascade.center.y / cascade.texelSize;
+			DR_CHECK_NEAR(x, std::round(x), 1e-3f);
+			DR_CHECK_NEAR(y, std::round(y), 1e-3f);
+			DR_CHECK_NEAR(cascade.texelSize * cascades.GetDesc().resolution, 2.0f * cascade.extent, 1e-3f);
+		}
+	}
+}
+
+DR_TEST(ShadowCascadesKeepTheirSizeAsTheCameraRotates)
+{
+	ShadowCascadesDesc desc;
+	desc.cachedCascadeStart = desc.cascadeCount;
+	ShadowCascades cascades(desc);
+
+	cascades.Update(Camera(TestCamera()), LightDirection(0.3f, -1.0f, 0.2f));
+	float texelSizes[ShadowCascades::s_maxCascades];
+	for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+		texelSizes[i] = cascades.GetCascade(i).texelSize;
+
+	for (float yaw : { 0.3f, 1.2f, 2.9f, 4.4f })
+	{
+		CameraDesc rotated = TestCamera();
+		rotated.yaw = yaw;
+		rotated.pitch = -0.4f;
+		cascades.Update(Camera(rotated), LightDirection(0.3f, -1.0f, 0.2f));
+		for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+			DR_CHECK_EQUAL(cascades.GetCascade(i).texelSize, texelSizes[i]);
+	}
+}
+
+DR_TEST(ShadowCascadesCacheStaticCastersUntilTheSliceLeaves)
+{
+	ShadowCascades cascades;
+	const XMFLOAT3 light = LightDirection(0.3f, -1.0f, 0.2f);
+
+	// the first update fills both cached cascades
+	cascades.Update(Camera(TestCamera()), light);
+	DR_CHECK(!cascades.GetCascade(0).cached && !cascades.GetCascade(1).cached);
+	DR_CHECK(cascades.GetCascade(2).cached && cascades.GetCascade(3).cached);
+	DR_CHECK(cascades.GetCascade(2).staticDirty && cascades.GetCascade(3).staticDirty);
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)2);
+
+	// small moves stay inside the margin, the uncached cascades still follow
+	const XMFLOAT3 center = cascades.GetCascade(0).center;
+	for (uint32_t frame = 1; frame <= 5; frame++)
+	{
+		Camera camera(TestCamera({ 0.1f * frame, 2.0f, 0.05f * frame }));
+		cascades.Update(camera, light);
+		DR_CHECK(!cascades.GetCascade(2).staticDirty && !cascades.GetCascade(3).staticDirty);
+		DR_CHECK(CoversSlice(camera, cascades.GetCascade(3)));
+	}
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)2);
+	DR_CHECK(cascades.GetCascade(0).center.x != center.x || cascades.GetCascade(0).center.y != center.y);
+
+	// far enough to leave both boxes
+	Camera moved(TestCamera({ 80.0f, 2.0f, 0.0f }));
+	cascades.Update(moved, light);
+	DR_CHECK(cascades.GetCascade(2).staticDirty && cascades.GetCascade(3).staticDirty);
+	DR_CHECK(CoversSlice(moved, cascades.GetCascade(2)) && CoversSlice(moved, cascades.GetCascade(3)));
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)4);
+
+	cascades.Update(moved, light);
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)4);
+
+	// static geometry changed
+	cascades.InvalidateStatic();
+	cascades.Update(moved, light);
+	DR_CHECK(cascades.GetCascade(2).staticDirty && cascades.GetCascade(3).staticDirty);
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)6);
+
+	// and the light turned
+	cascades.Update(moved, LightDirection(-0.5f, -1.0f, 0.1f));
+	DR_CHECK(cascades.GetCascade(2).staticDirty && cascades.GetCascade(3).staticDirty);
+	DR_CHECK_EQUAL(cascades.GetStaticRenderCount(), (uint64_t)8);
+}
+
+DR_TEST(ShadowCascadesTestCastersAgainstTheLightBox)
+{
+	ShadowCascades cascades;
+	const XMFLOAT3 light = LightDirection(0.3f, -1.0f, 0.2f);
+	cascades.Update(Camera(TestCamera({ 0.0f, 2.0f, 0.0f })), light);
+
+	// on the view axis in the middle of the first slice
+	const ShadowCascade& first = cascades.GetCascade(0);
+	const float depth = 0.5f * (first.splitNear + first.splitFar);
+	DR_CHECK(cascades.IsCasterVisible(0, { 0.0f, 2.0f, depth }, 0.1f));
+
+	// off to the side
+	DR_CHECK(!cascades.IsCasterVisible(0, { 50.0f, 2.0f, depth }, 0.1f));
+	DR_CHECK(cascades.IsCasterVisible(3, { 20.0f, 2.0f, 30.0f }, 0.1f));
+
+	// between the light and the box it still casts, behind the box it doesn't
+	const XMVECTOR p = XMVectorSet(0.0f, 2.0f, depth, 1.0f);
+	const XMVECTOR direction = XMLoadFloat3(&light);
+	XMFLOAT3 towardsLight, awayFromLight;
+	XMStoreFloat3(&towardsLight, p - direction * 100.0f);
+	XMStoreFloat3(&awayFromLight, p + direction * 100.0f);
+	DR_CHECK(cascades.IsCasterVisible(0, towardsLight, 0.1f));
+	DR_CHECK(!cascades.IsCasterVisible(0, awayFromLight, 0.1f));
+	// a big enough caster reaches into it from behind
+	DR_CHECK(cascades.IsCasterVisible(0, awayFromLight, 100.0f));
+}
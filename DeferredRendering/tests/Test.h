@@ -0,0 +1,36 @@
+#pragma once
+#include <cmath>
+#include <string>
+#include <vector>
+
+// just enough of a test framework for the cpu side: DR_TEST registers a function before main runs,
+// the checks record a failure and let the test carry on
+namespace DRTests
+{
+	using TestFunction = void(*)();
+
+	struct TestCase
+	{
+		const char* name;
+		TestFunction function;
+	};
+
+	std::vector<TestCase>& GetTests();
+	void Fail(const char* file, int line, const std::string& message);
+
+	struct Registrar
+	{
+		Registrar(const char* name, TestFunction function) { GetTests().push_back({ name, function }); }
+	};
+}
+
+#define DR_TEST(name) \
+	static void name(); \
+	static DRTests::Registrar name##Registrar(#name, name); \
+	static void name()
+
+#define DR_CHECK(x) do { if (!(x)) DRTests::Fail(__FILE__, __LINE__, #x); } while (0)
+
+#define DR_CHECK_EQUAL(a, b) do { if (!((a) == (b))) DRTests::Fail(__FILE__, __LINE__, #a " == " #b ", " + std::to_string(a) + " != " + std::to_string(b)); } while (0)
+
+#define DR_CHECK_NEAR(a, b, epsilon) do { if (!(std::abs((a) - (b)) <= (epsilon))) DRTests::Fail(__FILE__, __LINE__, #a " ~= " #b ", " + std::to_string(a) + " vs " + std::to_string(b)); } while (0)
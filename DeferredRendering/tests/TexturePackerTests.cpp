@@ -0,0 +1,180 @@
+#include "Test.h"
+
+#include "Utils/MaterialTable.h"
+
+using namespace DRUtils;
+
+// DXGI_FORMAT_R8G8B8A8_UNORM and DXGI_FORMAT_B8G8R8A8_UNORM, the packer only compares them
+static constexpr uint32_t s_rgba = 28;
+static constexpr uint32_t s_bgra = 87;
+
+// the same numbers on every platform
+static uint32_t Random(uint32_t& state, uint32_t max)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) % max;
+}
+
+DR_TEST(TexturePackerPacksAtlasRectsWithoutOverlap)
+{
+	TexturePackerDesc desc;
+	desc.atlasSize = 512;
+	desc.atlasMaxTextureSize = 128;
+	desc.atlasPadding = 6; // rounded up to 8
+	TexturePacker packer(desc);
+	DR_CHECK_EQUAL(packer.GetDesc().atlasPadding, 8u);
+
+	uint32_t state = 7;
+	for (uint32_t i = 0; i < 80; i++)
+		packer.Add("small" + std::to_string(i), 1 + Random(state, 128), 1 + Random(state, 128), i % 5 == 0 ? s_bgra : s_rgba);
+	DR_CHECK(packer.Pack());
+
+	// one atlas per format, more than a page each
+	const std::vector<TextureArrayLayout>& arrays = packer.GetArrays();
+	DR_CHECK_EQUAL(arrays.size(), (size_t)2);
+	for (const TextureArrayLayout& layout : arrays)
+	{
+		DR_CHECK(layout.atlas);
+		DR_CHECK_EQUAL(layout.width, 512u);
+		DR_CHECK_EQUAL(layout.mipLevels, 4u);
+	}
+	DR_CHECK(arrays.size() == 2 && arrays[0].sliceCount > 1);
+
+	const uint32_t padding = 8;
+	for (uint32_t i = 0; i < packer.GetTextureCount(); i++)
+	{
+		const TexturePlacement& a = packer.GetPlacement(i);
+		DR_CHECK(a.array < arrays.size() && a.slice < arrays[a.array].sliceCount);
+		DR_CHECK(arrays[a.array].format == (i % 5 == 0 ? s_bgra : s_rgba));
+
+		// aligned, and the padding stays on the page
+		DR_CHECK_EQUAL(a.x % padding, 0u);
+		DR_CHECK_EQUAL(a.y % padding, 0u);
+		DR_CHECK(a.x >= padding && a.y >= padding && a.x + a.width + padding <= 512 && a.y + a.height + padding <= 512);
+
+		const TextureRef& ref = packer.GetRef(packer.GetName(i));
+		DR_CHECK(ref.array == a.array && ref.slice == a.slice);
+		DR_CHECK_EQUAL(ref.rect.x, a.width / 512.0f);
+		DR_CHECK_EQUAL(ref.rect.z, a.x / 512.0f);
+
+		// padded rects don't touch
+		for (uint32_t j = i + 1; j < packer.GetTextureCount(); j++)
+		{
+			const TexturePlacement& b = packer.GetPlacement(j);
+			if (a.array != b.array || a.slice != b.slice)
+				continue;
+
+			const bool apart = a.x + a.width + padding <= b.x - padding || b.x + b.width + padding <= a.x - padding ||
+				a.y + a.height + padding <= b.y - padding || b.y + b.height + padding <= a.y - padding;
+			DR_CHECK(apart);
+		}
+	}
+
+	DR_CHECK(packer.GetAtlasOccupancy() > 0.3f && packer.GetAtlasOccupancy() <= 1.0f);
+}
+
+DR_TEST(TexturePackerGroupsSameSizeAndFormatIntoArrays)
+{
+	TexturePackerDesc desc;
+	desc.maxArrays = 4;
+	TexturePacker packer(desc);
+	packer.Add("a0", 512, 512, s_rgba);
+	packer.Add("b0", 1024, 512, s_rgba);
+	packer.Add("a1", 512, 512, s_rgba);
+	packer.Add("c0", 512, 512, s_bgra);
+	packer.Add("a2", 512, 512, s_rgba);
+	packer.Add("b1", 1024, 512, s_rgba);
+	packer.Add("small", 64, 64, s_rgba);
+	// again, ignored
+	packer.Add("a0", 256, 256, s_bgra);
+	DR_CHECK_EQUAL(packer.GetTextureCount(), 7u);
+	DR_CHECK(packer.Pack());
+
+	// in Add order, the atlas last
+	const std::vector<TextureArrayLayout>& arrays = packer.GetArrays();
+	DR_CHECK_EQUAL(arrays.size(), (size_t)4);
+	if (arrays.size() != 4)
+		return;
+	DR_CHECK(arrays[0].width == 512 && arrays[0].height == 512 && arrays[0].format == s_rgba && arrays[0].sliceCount == 3 && !arrays[0].atlas);
+	DR_CHECK(arrays[1].width == 1024 && arrays[1].height == 512 && arrays[1].sliceCount == 2);
+	DR_CHECK(arrays[2].format == s_bgra && arrays[2].sliceCount == 1);
+	DR_CHECK(arrays[3].atlas && arrays[3].sliceCount == 1);
+
+	const char* names[] = { "a0", "a1", "a2" };
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const TextureRef& ref = packer.GetRef(names[i]);
+		DR_CHECK_EQUAL(ref.array, 0u);
+		DR_CHECK_EQUAL(ref.slice, i);
+		DR_CHECK(ref.rect.x == 1.0f && ref.rect.y == 1.0f && ref.rect.z == 0.0f && ref.rect.w == 0.0f);
+	}
+	DR_CHECK(packer.GetRef("b1").array == 1 && packer.GetRef("b1").slice == 1);
+	DR_CHECK(packer.GetRef("small").array == 3);
+
+	// one more size is one array too many
+	packer.Add("d0", 2048, 2048, s_rgba);
+	DR_CHECK(!packer.Pack());
+	DR_CHECK_EQUAL(packer.GetArrays().size(), (size_t)5);
+}
+
+DR_TEST(TexturePackerWrapsThePadding)
+{
+	// 2 x 2 image at 2, 2 on a 6 x 6 page with 1 texel of padding
+	const uint32_t image[4] = { 1, 2, 3, 4 };
+	uint32_t page[36] = {};
+	TexturePacker::BlitWrapped(page, 6, image, 2, 2, 2, 2, 1);
+
+	DR_CHECK_EQUAL(page[2 * 6 + 2], 1u);
+	DR_CHECK_EQUAL(page[3 * 6 + 3], 4u);
+	// the corners take the opposite corner, the sides the opposite side
+	DR_CHECK_EQUAL(page[1 * 6 + 1], 4u);
+	DR_CHECK_EQUAL(page[4 * 6 + 4], 1u);
+	DR_CHECK_EQUAL(page[1 * 6 + 2], 3u);
+	DR_CHECK_EQUAL(page[2 * 6 + 4], 1u);
+	DR_CHECK_EQUAL(page[0], 0u);
+}
+
+DR_TEST(MaterialTableDeduplicatesMaterials)
+{
+	MaterialTable table;
+	Material brick;
+	brick.diffuseMap = "brick";
+	brick.specularMap = "brick_spec";
+	Material tiled = brick;
+	tiled.tiling = { 4.0f, 4.0f };
+	Material white;
+	white.diffuseMap = "white";
+	white.specularMap = "white";
+
+	DR_CHECK_EQUAL(table.Add(brick), 0u);
+	DR_CHECK_EQUAL(table.Add(tiled), 1u);
+	DR_CHECK_EQUAL(table.Add(white), 2u);
+	DR_CHECK_EQUAL(table.Add(brick), 0u);
+	DR_CHECK_EQUAL(table.Add(tiled), 1u);
+	DR_CHECK_EQUAL(table.GetCount(), 3u);
+
+	TexturePacker packer;
+	packer.Add("brick", 1024, 1024, s_rgba);
+	packer.Add("brick_spec", 1024, 1024, s_rgba);
+	packer.Add("white", 4, 4, s_rgba);
+	DR_CHECK(packer.Pack());
+
+	DR_CHECK(table.IsDirty());
+	MaterialTable::MaterialCBuf cbuf;
+	table.Fill(cbuf, packer);
+	DR_CHECK(!table.IsDirty());
+
+	DR_CHECK_EQUAL(cbuf.materials[1].tiling.x, 4.0f);
+	DR_CHECK(cbuf.materials[0].diffuseMap.array == 0 && cbuf.materials[0].diffuseMap.slice == 0);
+	DR_CHECK(cbuf.materials[0].specularMap.array == 0 && cbuf.materials[0].specularMap.slice == 1);
+	DR_CHECK(cbuf.materials[2].diffuseMap.array == packer.GetRef("white").array);
+	DR_CHECK_EQUAL(cbuf.materials[2].diffuseMap.rect.z, packer.GetRef("white").rect.z);
+
+	// adding an existing material changes nothing, a new one has to be uploaded
+	table.Add(white);
+	DR_CHECK(!table.IsDirty());
+	Material red = white;
+	red.diffuseCol = { 1.0f, 0.0f, 0.0f, 1.0f };
+	DR_CHECK_EQUAL(table.Add(red), 3u);
+	DR_CHECK(table.IsDirty());
+}
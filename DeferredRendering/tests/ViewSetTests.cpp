@@ -0,0 +1,132 @@
+#include "Test.h"
+
+#include "Utils/ViewSet.h"
+
+using namespace DirectX;
+using namespace DRUtils;
+
+// the same numbers on every platform
+static float Random(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1u << 24);
+}
+
+static Camera RandomCamera(uint32_t& state)
+{
+	CameraDesc desc;
+	desc.fov = XMConvertToRadians(30.0f + 60.0f * Random(state));
+	desc.aspect = 1.0f + Random(state);
+	desc.nearPlane = 0.1f + Random(state);
+	desc.farPlane = 20.0f + 80.0f * Random(state);
+	desc.yaw = XM_2PI * Random(state);
+	desc.pitch = Random(state) - 0.5f;
+	desc.position = { Random(state) * 40.0f - 20.0f, Random(state) * 10.0f - 5.0f, Random(state) * 40.0f - 20.0f };
+	return Camera(desc);
+}
+
+// one view at a time, one plane at a time, the sums nested like the simd version
+static uint64_t ScalarMask(const std::vector<Camera>& cameras, const XMFLOAT4& sphere)
+{
+	uint64_t mask = 0;
+	for (uint32_t view = 0; view < (uint32_t)cameras.size(); view++)
+	{
+		XMFLOAT4 planes[6];
+		cameras[view].GetFrustumPlanes(planes);
+		bool inside = true;
+		for (const XMFLOAT4& plane : planes)
+			inside = inside && sphere.x * plane.x + (sphere.y * plane.y + (sphere.z * plane.z + plane.w)) > -sphere.w;
+		if (inside)
+			mask |= 1ull << view;
+	}
+	return mask;
+}
+
+DR_TEST(ViewSetMasksMatchAPerViewLoop)
+{
+	uint32_t state = 99;
+	std::vector<XMFLOAT4> spheres;
+	for (uint32_t i = 0; i < 400; i++)
+		spheres.push_back({ Random(state) * 80.0f - 40.0f, Random(state) * 20.0f - 10.0f, Random(state) * 80.0f - 40.0f, Random(state) * 3.0f });
+
+	for (uint32_t viewCount : { 0u, 1u, 5u, 64u })
+	{
+		ViewSet views;
+		std::vector<Camera> cameras;
+		for (uint32_t view = 0; view < viewCount; view++)
+		{
+			cameras.push_back(RandomCamera(state));
+			views.SetCamera(view, cameras[view]);
+		}
+		views.SetViewCount(viewCount);
+		DR_CHECK_EQUAL(views.GetViewCount(), viewCount);
+
+		std::vector<uint64_t> masks(spheres.size(), ~0ull);
+		views.Cull(spheres.data(), (uint32_t)spheres.size(), masks.data());
+
+		uint32_t mismatches = 0;
+		size_t hits = 0;
+		for (size_t i = 0; i < spheres.size(); i++)
+		{
+			mismatches += masks[i] != ScalarMask(cameras, spheres[i]) ? 1 : 0;
+			for (uint32_t view = 0; view < viewCount; view++)
+				hits += (masks[i] >> view) & 1;
+		}
+		DR_CHECK_EQUAL(mismatches, 0u);
+		// the spheres hit some views and miss others
+		if (viewCount > 0)
+			DR_CHECK(hits > 0 && hits < spheres.size() * viewCount);
+
+		// the rebuilt views of a second Cull
+		if (viewCount > 1)
+		{
+			cameras[1] = RandomCamera(state);
+			views.SetCamera(1, cameras[1]);
+			views.Cull(spheres.data(), (uint32_t)spheres.size(), masks.data());
+			mismatches = 0;
+			for (size_t i = 0; i < spheres.size(); i++)
+				mismatches += masks[i] != ScalarMask(cameras, spheres[i]) ? 1 : 0;
+			DR_CHECK_EQUAL(mismatches, 0u);
+		}
+	}
+}
+
+DR_TEST(ViewSetNearPlaneCullingCanBeTurnedOff)
+{
+	// a shadow view looking down +z from the origin, 20 wide, 50 deep, and a camera in the same spot
+	ViewSet views;
+	views.SetViewProjection(0, XMMatrixOrthographicLH(20.0f, 20.0f, 0.0f, 50.0f));
+	CameraDesc desc;
+	desc.fov = XMConvertToRadians(60.0f);
+	desc.aspect = 1.0f;
+	desc.farPlane = 50.0f;
+	views.SetCamera(1, Camera(desc));
+	views.SetViewCount(2);
+
+	const XMFLOAT4 spheres[] =
+	{
+		{ 0.0f, 0.0f, 10.0f, 1.0f },  // inside both
+		{ 0.0f, 0.0f, -5.0f, 1.0f },  // in front of the near plane, inside the ortho box's sides
+		{ 0.0f, 0.0f, 60.0f, 1.0f },  // past the far plane
+		{ 15.0f, 0.0f, -5.0f, 1.0f }, // in front and off to the side
+	};
+	uint64_t masks[4];
+
+	views.Cull(spheres, 4, masks);
+	DR_CHECK_EQUAL(masks[0], (uint64_t)3);
+	DR_CHECK_EQUAL(masks[1], (uint64_t)0);
+	DR_CHECK_EQUAL(masks[2], (uint64_t)0);
+	DR_CHECK_EQUAL(masks[3], (uint64_t)0);
+
+	// casters in front of the shadow view still count, the camera view is left alone
+	views.SetNearPlaneCulling(0, false);
+	views.Cull(spheres, 4, masks);
+	DR_CHECK_EQUAL(masks[0], (uint64_t)3);
+	DR_CHECK_EQUAL(masks[1], (uint64_t)1);
+	DR_CHECK_EQUAL(masks[2], (uint64_t)0);
+	DR_CHECK_EQUAL(masks[3], (uint64_t)0);
+
+	views.SetNearPlaneCulling(0, true);
+	views.Cull(spheres, 4, masks);
+	DR_CHECK_EQUAL(masks[1], (uint64_t)0);
+}
@@ -54,11 +54,11 @@ project "DeferredRendering"
         systemversion "latest"
 
     filter "configurations:Debug"
-        defines "GDX11_DEBUG"
+        defines { "GDX11_DEBUG", "GDX11_PROFILE" }
         runtime "Debug"
         symbols "on"
 
     filter "configurations:Release"
-        defines "GDX11_RELEASE"
+        defines { "GDX11_RELEASE", "GDX11_PROFILE" }
         runtime "Release"
         optimize "on"
\ No newline at end of file